@@ -1,6 +1,8 @@
 #pragma once
 #include "esp_err.h"
 #include "stdbool.h"
+#include "stdint.h"
+#include "esp_http_server.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,19 +16,39 @@ typedef enum {
     CAP_STATE_WAIT_LOGIN,
     CAP_STATE_VERIFY,
     CAP_STATE_OPERATIONAL,
-    CAP_STATE_RECAPTIVE
+    CAP_STATE_RECAPTIVE,
+    CAP_STATE_RECOVERING,       // enlace perdido en OPERATIONAL: reintentos con backoff
+    CAP_STATE_COUNT
 } captive_state_t;
 
+// Estado del enlace para quien usa la red (main, Firebase): fuera de ONLINE
+// conviene aplazar el trabajo de red en vez de esperar timeouts
+typedef enum {
+    CAPTIVE_LINK_DOWN = 0,      // sin IP
+    CAPTIVE_LINK_UP,            // con IP, internet sin confirmar
+    CAPTIVE_LINK_ONLINE         // con IP e internet confirmado por el sondeo
+} captive_link_t;
+
 typedef struct {
     const char *ap_ssid;
     const char *ap_pass;
-    const char *connectivity_url;
-    int check_interval_ms;
+    const char *connectivity_url;   // sonda HTTP (espera 204); "" la desactiva
+    const char *probe_host;         // host o URL para las sondas DNS y TCP; NULL las desactiva
+    int probe_timeout_ms;           // por sonda
+    int check_interval_ms;          // intervalo mínimo del sondeo
+    int probe_interval_max_ms;      // tope del intervalo mientras hay internet estable
     int verify_success_needed;
     int max_scan_aps;
+    int scan_max_age_ms;        // /scan pide un escaneo nuevo si la caché es más vieja
     int conn_max_attempts;
     int conn_retry_delay_ms;
     int startup_check_delay_ms;
+    int fast_connect_attempts;  // intentos al BSSID/canal guardado antes del escaneo completo (0 = nunca)
+    bool reuse_ip_lease;        // reutilizar la IP anterior en vez de DHCP (requiere reserva en el router)
+    int recover_backoff_min_ms; // espera tras el primer reintento fallido en RECOVERING
+    int recover_backoff_max_ms; // tope de la espera (se duplica en cada fallo)
+    int recover_budget_ms;      // sin enlace tras esto, vuelve al portal (0 = nunca)
+    int sta_max_sockets;        // conexiones del servidor STA (API local, streams); 0 = 1
 } captive_manager_cfg_t;
 
 esp_err_t captive_manager_init(const captive_manager_cfg_t *cfg);
@@ -35,17 +57,64 @@ esp_err_t captive_manager_start(void);
 captive_state_t captive_manager_get_state(void);
 const char* captive_manager_state_str(captive_state_t st);
 
+// Todo el estado lo maneja una única tarea ("captive_mgr"): estas llamadas solo
+// encolan el evento y vuelven, se pueden usar desde cualquier tarea o callback
 void captive_manager_notify_sta_got_ip(void);
 void captive_manager_notify_sta_disconnected(int reason_code);
 
 esp_err_t captive_manager_enter_recaptive(void);
 
+typedef struct {
+    uint32_t entries;           // veces que se entró al estado
+    uint64_t time_ms;           // tiempo acumulado, incluida la estancia actual
+} captive_state_metrics_t;
+
+typedef struct {
+    captive_state_t state;
+    uint64_t in_state_ms;       // en el estado actual
+    uint32_t transitions;
+    uint32_t events;            // procesados por alguna fila de la tabla
+    uint32_t events_ignored;    // sin fila para el estado en que llegaron
+    uint32_t events_dropped;    // cola llena
+    uint32_t queue_max;         // ocupación máxima vista de la cola
+    uint32_t latency_last_us;   // de encolar el evento a terminar su acción
+    uint32_t latency_max_us;
+    uint32_t latency_avg_us;    // media móvil (peso 1/8)
+    captive_state_metrics_t states[CAP_STATE_COUNT];
+} captive_manager_metrics_t;
+
+void captive_manager_get_metrics(captive_manager_metrics_t *out);
+
+// Foto de la conexión STA que captive_mgr publica al terminar cada evento; es
+// lo que leen los handlers HTTP y /metrics desde otras tareas
+typedef struct {
+    captive_state_t state;
+    bool sta_have_ip;
+    bool using_saved;
+    int verify_success;
+    int connect_attempts;
+    char ssid[33];              // red STA en uso o la que se está intentando
+} captive_manager_status_t;
+
+void captive_manager_get_status(captive_manager_status_t *out);
+
 void captive_manager_enable_nat(void);
 void captive_manager_disable_nat(void);
+// Último veredicto del sondeo en segundo plano (ver connectivity.h), sin bloquear
 bool connectivity_portal_open(void);
 
 bool captive_manager_using_saved(void);
 
+captive_link_t captive_manager_get_link(void);
+const char* captive_manager_link_str(captive_link_t link);
+// Bloquea la tarea hasta que el enlace esté ONLINE; timeout_ms < 0 espera sin límite
+bool captive_manager_wait_online(int timeout_ms);
+
+// Endpoints extra del servidor HTTP en STA (modo operativo, red local). Se
+// registran cada vez que ese servidor arranca; llamar antes de captive_manager_start()
+#define CAPTIVE_MANAGER_MAX_STA_HANDLERS 6
+esp_err_t captive_manager_add_sta_handler(const httpd_uri_t *uri);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+#include "stdbool.h"
+#include "stdint.h"
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sondeo de conectividad en segundo plano. Cada ronda lanza en paralelo las
+// sondas activas (una tarea por sonda), espera como mucho timeout_ms y publica
+// el resultado en el event loop por defecto: nadie se bloquea esperando red.
+
+ESP_EVENT_DECLARE_BASE(CONNECTIVITY_EVENT);
+
+typedef enum {
+    CONNECTIVITY_EVENT_RESULT = 0,  // tras cada ronda; datos: connectivity_result_t
+    CONNECTIVITY_EVENT_CHANGED,     // el veredicto cambió; datos: connectivity_result_t
+} connectivity_event_t;
+
+typedef enum {
+    CONN_PROBE_HTTP = 0,  // GET a la URL de verificación, sin redirecciones; espera 204
+    CONN_PROBE_DNS,       // consulta A al DNS de la interfaz, por UDP
+    CONN_PROBE_TCP,       // connect() al host de Firebase
+    CONN_PROBE_COUNT
+} connectivity_probe_t;
+
+typedef enum {
+    CONNECTIVITY_UNKNOWN = 0,  // aún no terminó ninguna ronda
+    CONNECTIVITY_OFFLINE,
+    CONNECTIVITY_PORTAL,       // HTTP contestó, pero no con 204: portal cautivo
+    CONNECTIVITY_ONLINE
+} connectivity_verdict_t;
+
+typedef struct {
+    connectivity_probe_t probe;
+    bool ran;       // false: desactivada, o seguía ocupada con la ronda anterior
+    bool ok;
+    int status;     // HTTP: código de estado; DNS/TCP: 0 o errno/rcode
+    int rtt_ms;     // -1 si falló
+} connectivity_probe_result_t;
+
+typedef struct {
+    connectivity_verdict_t verdict;
+    bool changed;
+    uint32_t round;
+    int next_interval_ms;   // -1 si el sondeo está detenido
+    connectivity_probe_result_t probes[CONN_PROBE_COUNT];
+} connectivity_result_t;
+
+// Acumulado por sonda desde connectivity_init()
+typedef struct {
+    uint32_t ok;
+    uint32_t failed;
+    int last_rtt_ms;        // -1 si la última falló
+    int min_rtt_ms;         // -1 hasta el primer éxito
+    int max_rtt_ms;
+    int avg_rtt_ms;         // media móvil (peso 1/8) de los éxitos
+    int64_t last_us;        // esp_timer de la última ejecución, -1 si nunca
+} connectivity_probe_stats_t;
+
+typedef struct {
+    const char *http_url;   // NULL o "" desactiva la sonda HTTP
+    const char *host;       // host o URL (se toma host y puerto) para DNS y TCP; NULL o "" las desactiva
+    esp_netif_t *netif;     // de donde se toma el servidor DNS
+    int timeout_ms;         // por sonda; la ronda espera como mucho esto
+    int interval_min_ms;    // intervalo mientras no hay internet o tras un cambio
+    int interval_max_ms;    // tope al que se duplica mientras sigue ONLINE
+} connectivity_cfg_t;
+
+esp_err_t connectivity_init(const connectivity_cfg_t *cfg);
+// Primera ronda tras first_delay_ms y después con intervalo adaptativo
+void connectivity_start(int first_delay_ms);
+void connectivity_stop(void);
+// Ronda inmediata (también con el sondeo detenido) y vuelta al intervalo mínimo
+void connectivity_check_now(void);
+
+connectivity_verdict_t connectivity_get_verdict(void);
+bool connectivity_get_stats(connectivity_probe_t probe, connectivity_probe_stats_t *out);
+const char *connectivity_probe_name(connectivity_probe_t probe);
+const char *connectivity_verdict_str(connectivity_verdict_t verdict);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+#include "stdbool.h"
+#include "stdint.h"
+#include "esp_err.h"
+#include "esp_wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Red vista en el último escaneo (una por SSID, la de mejor señal)
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+    wifi_auth_mode_t authmode;
+} wifi_scan_entry_t;
+
+// Reserva la tabla (max_aps redes) y escucha WIFI_EVENT_SCAN_DONE
+esp_err_t wifi_scan_init(int max_aps);
+// Lanza un escaneo en segundo plano si no hay uno en curso (pasa AP -> APSTA,
+// o a STA si el Wi-Fi aún no tiene modo)
+esp_err_t wifi_scan_request(void);
+bool wifi_scan_in_progress(void);
+// Copia hasta max redes desde la posición first (orden por RSSI); devuelve
+// cuántas. updated_us (opcional) recibe el esp_timer del escaneo que llenó la
+// tabla, -1 si aún no hay ninguno: si cambia entre llamadas, la tabla es otra.
+int wifi_scan_get(wifi_scan_entry_t *out, int first, int max, int64_t *updated_us);
+// Entrada del SSID en la última tabla, si se vio
+bool wifi_scan_find(const char *ssid, wifi_scan_entry_t *out);
+
+#ifdef __cplusplus
+}
+#endif
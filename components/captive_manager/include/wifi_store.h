@@ -1,15 +1,63 @@
 #pragma once
 #include "stdbool.h"
+#include "stdint.h"
 #include "esp_err.h"
+#include "sdkconfig.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define WIFI_STORE_MAX_NETWORKS CONFIG_CAPTIVE_MANAGER_MAX_NETWORKS
+
+// Red conocida. La lista vive en RAM y se reescribe en NVS solo al cambiar.
+typedef struct {
+    char ssid[33];
+    char pass[65];
+    uint8_t priority;   // mayor = preferida
+    uint8_t failures;   // conexiones fallidas seguidas (satura en 255)
+    uint32_t last_ok;   // orden del último éxito (mayor = más reciente), 0 = nunca.
+                        // No es una hora: al conectar aún no hay SNTP.
+} wifi_store_net_t;
+
+// Carga la lista (migrando el formato de una sola red si hace falta)
+esp_err_t wifi_store_init(void);
+
 bool wifi_store_has_credentials(void);
+int wifi_store_count(void);
+// Copia la entrada index (orden de alta); ESP_ERR_NOT_FOUND fuera de rango
+esp_err_t wifi_store_get(int index, wifi_store_net_t *out);
+// Alta o actualización (conserva prioridad si priority < 0 y pone fallos a 0).
+// Con la lista llena reemplaza la peor: menor prioridad, más fallos, más vieja.
+esp_err_t wifi_store_add(const char *ssid, const char *pass, int priority);
+esp_err_t wifi_store_remove(const char *ssid);
+// Resultado de una conexión: éxito pone fallos a 0 y la marca como la más reciente
+esp_err_t wifi_store_mark(const char *ssid, bool ok);
+
+// Compatibilidad: load da la preferida (prioridad, luego éxito más reciente),
+// save es wifi_store_add() sin prioridad, clear borra todas las redes
 esp_err_t wifi_store_load(char *ssid, size_t ssid_len, char *pass, size_t pass_len);
 esp_err_t wifi_store_save(const char *ssid, const char *pass);
 esp_err_t wifi_store_clear(void);
 
+// Último enlace bueno (de la red ssid), para reconectar sin escanear todos
+// los canales. Direcciones en orden de red (esp_ip4_addr_t).
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    bool has_ip;        // ip/netmask/gw/dns válidos (concesión DHCP anterior)
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} wifi_store_link_t;
+
+// ESP_ERR_NVS_NOT_FOUND si no hay enlace guardado
+esp_err_t wifi_store_load_link(wifi_store_link_t *link);
+// Solo escribe en flash si cambió respecto a lo guardado
+esp_err_t wifi_store_save_link(const wifi_store_link_t *link);
+esp_err_t wifi_store_clear_link(void);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
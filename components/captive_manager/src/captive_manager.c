@@ -1,5 +1,8 @@
 #include "captive_manager.h"
 #include "wifi_store.h"
+#include "wifi_scan.h"
+#include "connectivity.h"
+#include "metrics.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
@@ -12,7 +15,10 @@
 #include "cJSON.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "esp_http_client.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 
 #include "mdns.h"
 
@@ -24,9 +30,11 @@
 static const char *TAG = "captive_mgr";
 
 static captive_manager_cfg_t g_cfg;
-static captive_state_t g_state = CAP_STATE_IDLE;
+static volatile captive_state_t g_state = CAP_STATE_IDLE; // solo lo escribe la tarea captive_mgr
 static httpd_handle_t g_server = NULL;
 static httpd_handle_t g_sta_server = NULL; // servidor mínimo en STA
+static httpd_uri_t g_sta_extra[CAPTIVE_MANAGER_MAX_STA_HANDLERS]; // ver captive_manager_add_sta_handler()
+static int g_sta_extra_count = 0;
 static esp_netif_t *g_ap_netif = NULL;
 static esp_netif_t *g_sta_netif = NULL;
 
@@ -40,20 +48,85 @@ static bool g_connect_post_pending_save = false; // guardaremos al obtener IP
 static char g_pending_ssid[33];
 static char g_pending_pass[65];
 
-// Task para reiniciar tras responder HTTP
-static void restart_later_task(void *arg) {
-    // pequeña espera para permitir que el cliente reciba la respuesta
-    vTaskDelay(pdMS_TO_TICKS(800));
+// Redes guardadas: la que se está usando y las ya probadas en esta ronda
+static char g_sta_ssid[33];
+static uint32_t g_tried_mask = 0;
+
+// Reconexión rápida (BSSID/canal/IP del último enlace bueno)
+static wifi_store_link_t g_link;
+static bool g_fast_connect = false;     // config STA apunta al BSSID guardado
+static int  g_fast_attempts_left = 0;
+static bool g_cached_ip = false;        // DHCP detenido, IP anterior aplicada
+static int64_t g_connect_start_us = 0;
+
+// Reintentos de conexión (CONNECTING y RECOVERING) con un timer, sin bloquear
+// el event loop
+static esp_timer_handle_t g_retry_timer = NULL;
+static int  g_recover_attempts = 0;
+static int64_t g_recover_start_us = 0;
+
+// Estado del enlace publicado para main/Firebase
+#define LINK_ONLINE_BIT BIT0
+static EventGroupHandle_t g_link_bits = NULL;
+static volatile captive_link_t g_link_state = CAPTIVE_LINK_DOWN;
+
+// Eventos de la máquina de estados. WiFi, IP, timers, sondeo y HTTP solo
+// encolan; la tarea captive_mgr los consume en orden y es la única que toca
+// el estado, así que no hace falta proteger estas variables
+typedef enum {
+    CM_EV_START = 0,
+    CM_EV_STA_GOT_IP,
+    CM_EV_STA_DISCONNECTED,     // arg: reason
+    CM_EV_SCAN_DONE,
+    CM_EV_RETRY_TIMER,
+    CM_EV_CONNECTIVITY,         // arg: connectivity_verdict_t
+    CM_EV_RECAPTIVE,
+} cm_event_type_t;
+
+typedef struct {
+    cm_event_type_t type;
+    int arg;
+    int64_t posted_us;
+} cm_event_t;
+
+#define CM_QUEUE_LEN   16
+#define CM_TASK_STACK  4096
+
+static QueueHandle_t g_queue = NULL;
+
+// Métricas (las escribe captive_mgr; se leen desde HTTP o main)
+static portMUX_TYPE g_metrics_mux = portMUX_INITIALIZER_UNLOCKED;
+static captive_manager_metrics_t g_metrics;
+static captive_manager_status_t g_status; // ver publish_status()
+static int64_t g_state_since_us = 0;
+
+// Exportadas en /metrics (ver register_metrics)
+static metric_t *g_m_disconnects, *g_m_reconnects, *g_m_rssi, *g_m_state;
+static metric_t *g_m_queued, *g_m_queue_max, *g_m_dropped;
+
+// Reinicio diferido tras responder HTTP (deja que el cliente reciba la respuesta)
+static esp_timer_handle_t g_restart_timer = NULL;
+
+static void restart_timer_cb(void *arg) {
     esp_restart();
 }
 
+static void restart_later(void) {
+    esp_timer_start_once(g_restart_timer, 800 * 1000);
+}
+
 // Forward declarations
 static void set_state(captive_state_t st);
 static esp_err_t start_ap(void);
 static esp_err_t start_http(void);
 static void scan_start(void);
-static void periodic_check_task(void *arg);
+static void on_connectivity_result(void *arg, esp_event_base_t base, int32_t id, void *data);
+static void start_portal_nat(void);
+static void enter_recaptive(void);
+static void captive_task(void *arg);
 static void connect_sta(const char *ssid, const char *pass, bool from_saved);
+static void sta_config_for(wifi_config_t *sta_cfg, const char *ssid, const char *pass);
+static void fast_connect_fallback(void);
 static void shutdown_ap(void);
 // static void maybe_start_captive_after_saved_ip(void); // eliminada por no usarse
 // HTTP STA-min server controls
@@ -72,6 +145,16 @@ const char* captive_manager_state_str(captive_state_t st) {
         case CAP_STATE_VERIFY: return "VERIFY";
         case CAP_STATE_OPERATIONAL: return "OPERATIONAL";
         case CAP_STATE_RECAPTIVE: return "RECAPTIVE";
+        case CAP_STATE_RECOVERING: return "RECOVERING";
+        default: return "UNKNOWN";
+    }
+}
+
+const char* captive_manager_link_str(captive_link_t link) {
+    switch(link){
+        case CAPTIVE_LINK_DOWN: return "DOWN";
+        case CAPTIVE_LINK_UP: return "UP";
+        case CAPTIVE_LINK_ONLINE: return "ONLINE";
         default: return "UNKNOWN";
     }
 }
@@ -80,16 +163,177 @@ captive_state_t captive_manager_get_state(void){
     return g_state;
 }
 
-// Implementación faltante: cambia el estado y registra transición
+// Cambia el estado y registra la transición (solo desde captive_mgr)
 static void set_state(captive_state_t st) {
     if (g_state != st) {
-        ESP_LOGI(TAG, "STATE: %s -> %s", captive_manager_state_str(g_state), captive_manager_state_str(st));
+        int64_t now_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "STATE: %s -> %s (%lld ms en %s)", captive_manager_state_str(g_state),
+                 captive_manager_state_str(st), (long long)((now_us - g_state_since_us) / 1000),
+                 captive_manager_state_str(g_state));
+        portENTER_CRITICAL(&g_metrics_mux);
+        g_metrics.states[g_state].time_ms += (now_us - g_state_since_us) / 1000;
+        g_metrics.states[st].entries++;
+        g_metrics.transitions++;
+        g_state_since_us = now_us;
         g_state = st;
+        portEXIT_CRITICAL(&g_metrics_mux);
+    }
+}
+
+void captive_manager_get_metrics(captive_manager_metrics_t *out) {
+    if (!out) return;
+    portENTER_CRITICAL(&g_metrics_mux);
+    *out = g_metrics;
+    out->state = g_state;
+    int64_t since_us = g_state_since_us;
+    portEXIT_CRITICAL(&g_metrics_mux);
+    out->in_state_ms = (esp_timer_get_time() - since_us) / 1000;
+    out->states[out->state].time_ms += out->in_state_ms;
+}
+
+// Copia lo que escribe captive_mgr para que otras tareas no lean los globals
+// a medias (el SSID es un arreglo). Solo desde captive_mgr.
+static void publish_status(void) {
+    captive_manager_status_t st = {
+        .sta_have_ip = g_sta_have_ip,
+        .using_saved = g_using_saved,
+        .verify_success = g_verify_success,
+        .connect_attempts = g_connect_attempts,
+    };
+    memcpy(st.ssid, g_sta_ssid, sizeof(st.ssid));
+    portENTER_CRITICAL(&g_metrics_mux);
+    g_status = st;
+    portEXIT_CRITICAL(&g_metrics_mux);
+}
+
+void captive_manager_get_status(captive_manager_status_t *out) {
+    if (!out) return;
+    portENTER_CRITICAL(&g_metrics_mux);
+    *out = g_status;
+    out->state = g_state;
+    portEXIT_CRITICAL(&g_metrics_mux);
+}
+
+// /metrics: lo que se lee al momento de cada consulta (tarea de httpd)
+static void collect_metrics(void) {
+    captive_manager_metrics_t m;
+    captive_manager_get_metrics(&m);
+    captive_manager_status_t st;
+    captive_manager_get_status(&st);
+    metrics_set(g_m_state, m.state);
+    metrics_set(g_m_queued, g_queue ? (int32_t)uxQueueMessagesWaiting(g_queue) : 0);
+    metrics_set(g_m_queue_max, m.queue_max);
+    metrics_set(g_m_dropped, m.events_dropped);
+    wifi_ap_record_t ap;
+    metrics_set(g_m_rssi, st.sta_have_ip && esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0);
+}
+
+static void register_metrics(void) {
+    g_m_disconnects = metrics_counter("wifi_disconnects_total", "Desconexiones del STA", NULL);
+    g_m_reconnects = metrics_counter("wifi_reconnects_total", "Enlaces recuperados sin volver al portal", NULL);
+    g_m_rssi = metrics_gauge("wifi_rssi_dbm", "RSSI del AP actual (0 = sin enlace)", NULL);
+    g_m_state = metrics_gauge("captive_state", "Estado del captive manager (captive_state_t)", NULL);
+    g_m_queued = metrics_gauge("captive_events_queued", "Eventos en la cola de captive_mgr", NULL);
+    g_m_queue_max = metrics_gauge("captive_events_queue_max", "Máximo de eventos en cola", NULL);
+    g_m_dropped = metrics_counter("captive_events_dropped_total", "Eventos descartados por cola llena", NULL);
+    metrics_add_collector(collect_metrics);
+    metrics_watch_task("captive_mgr");
+    #if !defined(FORCE_AP_NAT_MODE)
+        metrics_watch_task("conn_probe");
+        metrics_watch_task("conn_http");
+    #endif
+}
+
+static void post_event(cm_event_type_t type, int arg) {
+    cm_event_t ev = { .type = type, .arg = arg, .posted_us = esp_timer_get_time() };
+    if (!g_queue || xQueueSend(g_queue, &ev, 0) != pdTRUE) {
+        ESP_LOGE(TAG, "Cola llena: evento %d descartado", (int)type);
+        portENTER_CRITICAL(&g_metrics_mux);
+        g_metrics.events_dropped++;
+        portEXIT_CRITICAL(&g_metrics_mux);
     }
 }
 
 bool captive_manager_using_saved(void) {
-    return g_using_saved;
+    captive_manager_status_t st;
+    captive_manager_get_status(&st);
+    return st.using_saved;
+}
+
+static void set_link(captive_link_t link) {
+    if (g_link_state == link) return;
+    ESP_LOGI(TAG, "LINK: %s -> %s", captive_manager_link_str(g_link_state), captive_manager_link_str(link));
+    g_link_state = link;
+    if (link == CAPTIVE_LINK_ONLINE) {
+        xEventGroupSetBits(g_link_bits, LINK_ONLINE_BIT);
+    } else {
+        xEventGroupClearBits(g_link_bits, LINK_ONLINE_BIT);
+    }
+}
+
+captive_link_t captive_manager_get_link(void) {
+    return g_link_state;
+}
+
+bool captive_manager_wait_online(int timeout_ms) {
+    if (!g_link_bits) return false;
+    TickType_t ticks = timeout_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return xEventGroupWaitBits(g_link_bits, LINK_ONLINE_BIT, pdFALSE, pdTRUE, ticks) & LINK_ONLINE_BIT;
+}
+
+static void retry_timer_cb(void *arg) {
+    post_event(CM_EV_RETRY_TIMER, 0);
+}
+
+static void on_scan_done(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    // wifi_scan registró su handler antes: la caché ya está actualizada
+    post_event(CM_EV_SCAN_DONE, 0);
+}
+
+struct net_candidate {
+    wifi_store_net_t net;
+    bool visible;
+    int rssi;
+    int index;
+};
+
+// Orden de preferencia: visible en el último escaneo, sin agotar reintentos,
+// prioridad, señal y éxito más reciente
+static bool candidate_better(const struct net_candidate *a, const struct net_candidate *b) {
+    if (a->visible != b->visible) return a->visible;
+    bool a_ok = a->net.failures < g_cfg.conn_max_attempts;
+    bool b_ok = b->net.failures < g_cfg.conn_max_attempts;
+    if (a_ok != b_ok) return a_ok;
+    if (a->net.priority != b->net.priority) return a->net.priority > b->net.priority;
+    if (a->rssi != b->rssi) return a->rssi > b->rssi;
+    return a->net.last_ok > b->net.last_ok;
+}
+
+// Mejor red guardada aún no probada en esta ronda (g_tried_mask); la marca como probada
+static bool pick_known_network(wifi_store_net_t *out) {
+    struct net_candidate best = { .index = -1 }, c;
+    for (int i = 0; wifi_store_get(i, &c.net) == ESP_OK; i++) {
+        if (g_tried_mask & (1u << i)) continue;
+        wifi_scan_entry_t seen;
+        c.visible = wifi_scan_find(c.net.ssid, &seen);
+        c.rssi = c.visible ? seen.rssi : -127;
+        c.index = i;
+        if (best.index < 0 || candidate_better(&c, &best)) best = c;
+    }
+    if (best.index < 0) return false;
+    g_tried_mask |= 1u << best.index;
+    *out = best.net;
+    ESP_LOGI(TAG, "Red elegida: %s (prioridad=%d fallos=%d %s rssi=%d)", best.net.ssid,
+             best.net.priority, best.net.failures, best.visible ? "visible" : "no vista", best.rssi);
+    return true;
+}
+
+// PREP + SCAN_DONE: arranque con varias redes guardadas, ya con la caché de escaneo
+static void act_boot_pick(const cm_event_t *ev) {
+    wifi_store_net_t net;
+    g_tried_mask = 0;
+    if (pick_known_network(&net)) connect_sta(net.ssid, net.pass, true);
+    else enter_recaptive();
 }
 
 // Public API
@@ -103,6 +347,7 @@ esp_err_t captive_manager_init(const captive_manager_cfg_t *cfg) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         ESP_ERROR_CHECK(nvs_flash_init());
     }
+    ESP_ERROR_CHECK(wifi_store_init());
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -115,12 +360,45 @@ esp_err_t captive_manager_init(const captive_manager_cfg_t *cfg) {
     ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_NULL));
     ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_ERROR_CHECK(wifi_scan_init(g_cfg.max_scan_aps > 0 ? g_cfg.max_scan_aps : 20));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &on_scan_done, NULL));
+
+    g_link_bits = xEventGroupCreate();
+    if (!g_link_bits) return ESP_ERR_NO_MEM;
+    const esp_timer_create_args_t retry_args = { .callback = retry_timer_cb, .name = "cap_retry" };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_args, &g_retry_timer));
+    const esp_timer_create_args_t restart_args = { .callback = restart_timer_cb, .name = "cap_restart" };
+    ESP_ERROR_CHECK(esp_timer_create(&restart_args, &g_restart_timer));
+
+    g_state_since_us = esp_timer_get_time();
+    g_metrics.states[CAP_STATE_IDLE].entries = 1;
+    g_queue = xQueueCreate(CM_QUEUE_LEN, sizeof(cm_event_t));
+    if (!g_queue) return ESP_ERR_NO_MEM;
+    register_metrics();
+    if (xTaskCreate(captive_task, "captive_mgr", CM_TASK_STACK, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    #if !defined(FORCE_AP_NAT_MODE)
+        // Sondeo en segundo plano: los resultados llegan como CONNECTIVITY_EVENT
+        connectivity_cfg_t ccfg = {
+            .http_url = g_cfg.connectivity_url,
+            .host = g_cfg.probe_host,
+            .netif = g_sta_netif,
+            .timeout_ms = g_cfg.probe_timeout_ms,
+            .interval_min_ms = g_cfg.check_interval_ms,
+            .interval_max_ms = g_cfg.probe_interval_max_ms,
+        };
+        ESP_ERROR_CHECK(connectivity_init(&ccfg));
+        ESP_ERROR_CHECK(esp_event_handler_register(CONNECTIVITY_EVENT, CONNECTIVITY_EVENT_RESULT,
+                                                   &on_connectivity_result, NULL));
+    #endif
 
-    set_state(CAP_STATE_IDLE);
     return ESP_OK;
 }
 
-static void start_with_saved_or_captive(void) {
+// IDLE + START
+static void act_start(const cm_event_t *ev) {
     #if defined(FORCE_AP_NAT_MODE)
         // Intentar conectar STA con credenciales guardadas si existen
         if (wifi_store_has_credentials()) {
@@ -142,11 +420,16 @@ static void start_with_saved_or_captive(void) {
         scan_start();
         
     #else
-        if (wifi_store_has_credentials()) {
-            char ssid[33], pass[65];
-            if (wifi_store_load(ssid, sizeof(ssid), pass, sizeof(pass)) == ESP_OK) {
-                ESP_LOGI(TAG,"Credenciales guardadas encontradas: SSID=%s (len pass=%d)", ssid, (int)strlen(pass));
-                connect_sta(ssid, pass, true);
+        int count = wifi_store_count();
+        if (count > 0) {
+            ESP_LOGI(TAG,"Credenciales guardadas encontradas: %d redes", count);
+            g_tried_mask = 0;
+            set_state(CAP_STATE_PREP);
+            // Con una sola red no hay nada que elegir: directo (y con reconexión rápida)
+            if (count > 1 && wifi_scan_request() == ESP_OK) return; // sigue en act_boot_pick()
+            wifi_store_net_t net;
+            if (pick_known_network(&net)) {
+                connect_sta(net.ssid, net.pass, true);
                 return;
             }
         }
@@ -161,12 +444,10 @@ static void start_with_saved_or_captive(void) {
 
 esp_err_t captive_manager_start(void) {
     if (g_state != CAP_STATE_IDLE) return ESP_ERR_INVALID_STATE;
-    start_with_saved_or_captive();
-    // Verificación periódica de internet: solo en modo normal
+    post_event(CM_EV_START, 0);
+    // La verificación de internet la dispara GOT_IP (ver act_first_check)
     #if defined(FORCE_AP_NAT_MODE)
-        ESP_LOGI(TAG, "[PRUEBA] periodic_check_task desactivada por modo AP+NAT forzado");
-    #else
-        xTaskCreate(periodic_check_task, "cap_chk", 2048, NULL, 5, NULL);
+        ESP_LOGI(TAG, "[PRUEBA] sondeo de conectividad desactivado por modo AP+NAT forzado");
     #endif
     return ESP_OK;
 }
@@ -191,11 +472,105 @@ static esp_err_t start_ap(void) {
     return ESP_OK;
 }
 
+// Aplica como estática la IP de la concesión anterior (sin esperar DHCP)
+static void apply_cached_ip(void) {
+    if (!g_sta_netif) return;
+    esp_netif_ip_info_t ip = {0};
+    ip.ip.addr = g_link.ip;
+    ip.netmask.addr = g_link.netmask;
+    ip.gw.addr = g_link.gw;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcpc_stop(g_sta_netif));
+    if (esp_netif_set_ip_info(g_sta_netif, &ip) != ESP_OK) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcpc_start(g_sta_netif));
+        return;
+    }
+    esp_netif_dns_info_t dns = {0};
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    dns.ip.u_addr.ip4.addr = g_link.dns;
+    esp_netif_set_dns_info(g_sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+    g_cached_ip = true;
+    ESP_LOGI(TAG, "Reutilizando IP " IPSTR " (sin DHCP)", IP2STR(&ip.ip));
+}
+
+// Abandona la reconexión rápida: escaneo de todos los canales y DHCP
+static void fast_connect_fallback(void) {
+    wifi_config_t sta_cfg;
+    if (esp_wifi_get_config(WIFI_IF_STA, &sta_cfg) == ESP_OK) {
+        sta_cfg.sta.bssid_set = false;
+        sta_cfg.sta.channel = 0;
+        sta_cfg.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+    }
+    if (g_cached_ip) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcpc_start(g_sta_netif));
+        g_cached_ip = false;
+    }
+    g_fast_connect = false;
+    g_fast_attempts_left = 0;
+}
+
+// Toma BSSID, canal y concesión actuales (para RECOVERING) y, si persist, los
+// guarda para el próximo arranque
+static void remember_link(bool persist) {
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) return;
+    wifi_store_link_t link = {0};
+    snprintf(link.ssid, sizeof(link.ssid), "%s", g_sta_ssid);
+    memcpy(link.bssid, ap.bssid, sizeof(link.bssid));
+    link.channel = ap.primary;
+    esp_netif_ip_info_t ip;
+    esp_netif_dns_info_t dns;
+    if (g_sta_netif && esp_netif_get_ip_info(g_sta_netif, &ip) == ESP_OK &&
+        esp_netif_get_dns_info(g_sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+        link.has_ip = ip.ip.addr != 0;
+        link.ip = ip.ip.addr;
+        link.netmask = ip.netmask.addr;
+        link.gw = ip.gw.addr;
+        link.dns = dns.ip.u_addr.ip4.addr;
+    }
+    g_link = link;
+    if (!persist) return;
+    esp_err_t err = wifi_store_save_link(&link);
+    if (err != ESP_OK) ESP_LOGW(TAG, "No se pudo guardar el enlace: %s", esp_err_to_name(err));
+}
+
+// Apunta la config STA al BSSID/canal de g_link (sin escaneo completo)
+static void fast_connect_target(wifi_config_t *sta_cfg) {
+    memcpy(sta_cfg->sta.bssid, g_link.bssid, sizeof(sta_cfg->sta.bssid));
+    sta_cfg->sta.bssid_set = true;
+    sta_cfg->sta.channel = g_link.channel;
+    sta_cfg->sta.scan_method = WIFI_FAST_SCAN;
+    g_fast_connect = true;
+    g_fast_attempts_left = g_cfg.fast_connect_attempts;
+    ESP_LOGI(TAG, "Reconexión rápida: BSSID %02x:%02x:%02x:%02x:%02x:%02x canal %d",
+             g_link.bssid[0], g_link.bssid[1], g_link.bssid[2],
+             g_link.bssid[3], g_link.bssid[4], g_link.bssid[5], g_link.channel);
+}
+
+static void sta_config_for(wifi_config_t *sta_cfg, const char *ssid, const char *pass) {
+    snprintf((char*)sta_cfg->sta.ssid, sizeof(sta_cfg->sta.ssid), "%s", ssid);
+    snprintf((char*)sta_cfg->sta.password, sizeof(sta_cfg->sta.password), "%s", pass?pass:"");
+    sta_cfg->sta.threshold.authmode = WIFI_AUTH_OPEN;
+    sta_cfg->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    sta_cfg->sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    snprintf(g_sta_ssid, sizeof(g_sta_ssid), "%s", ssid);
+}
+
 static void connect_sta(const char *ssid, const char *pass, bool from_saved) {
     wifi_config_t sta_cfg = {0};
-    snprintf((char*)sta_cfg.sta.ssid, sizeof(sta_cfg.sta.ssid), "%s", ssid);
-    snprintf((char*)sta_cfg.sta.password, sizeof(sta_cfg.sta.password), "%s", pass?pass:"");
-    sta_cfg.sta.threshold.authmode = WIFI_AUTH_OPEN;
+    sta_config_for(&sta_cfg, ssid, pass);
+
+    esp_timer_stop(g_retry_timer);  // un reintento pendiente iría a la red anterior
+
+    // Con credenciales guardadas: primero directo al último AP bueno en su canal,
+    // si el enlace guardado es de esta misma red
+    g_fast_connect = false;
+    g_fast_attempts_left = 0;
+    if (from_saved && g_cfg.fast_connect_attempts > 0 && wifi_store_load_link(&g_link) == ESP_OK &&
+        strcmp(g_link.ssid, g_sta_ssid) == 0) {
+        fast_connect_target(&sta_cfg);
+        if (g_cfg.reuse_ip_lease && g_link.has_ip) apply_cached_ip();
+    }
 
     // Mantener AP activo para modo router: usar APSTA
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
@@ -207,87 +582,195 @@ static void connect_sta(const char *ssid, const char *pass, bool from_saved) {
     g_connect_attempts = 0;
     g_connect_post_pending_save = !from_saved; // si es nueva, guardaremos al tener IP
     ESP_LOGI(TAG,"(STA) Connecting to SSID=%s saved=%d", sta_cfg.sta.ssid, from_saved);
+    g_connect_start_us = esp_timer_get_time();
     esp_wifi_connect();
     start_mdns_service(); // mDNS también en modo STA
 }
 
-void captive_manager_notify_sta_got_ip(void) {
+// Portal del upstream sin login: NAT y DNS del STA para los clientes del AP
+static void start_portal_nat(void) {
+    if (g_sta_netif) esp_netif_set_default_netif(g_sta_netif);
+    if (g_ap_netif && g_sta_netif) {
+        uint8_t dhcps_offer_option = 0x02;
+        esp_netif_dns_info_t dns;
+        if (esp_netif_get_dns_info(g_sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+            ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcps_stop(g_ap_netif));
+            ESP_ERROR_CHECK(esp_netif_dhcps_option(g_ap_netif, ESP_NETIF_OP_SET, ESP_NETIF_DOMAIN_NAME_SERVER,
+                                                   &dhcps_offer_option, sizeof(dhcps_offer_option)));
+            ESP_ERROR_CHECK(esp_netif_set_dns_info(g_ap_netif, ESP_NETIF_DNS_MAIN, &dns));
+            ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcps_start(g_ap_netif));
+        }
+    }
+    captive_manager_enable_nat();
+}
+
+// IP obtenida: guarda la red (si era nueva), su resultado y el enlace
+static void sta_up(void) {
     g_sta_have_ip = true;
-    ESP_LOGI(TAG,"STA GOT IP (saved=%d)", g_using_saved);
+    int64_t now_us = esp_timer_get_time();
+    ESP_LOGI(TAG,"STA GOT IP (saved=%d) ruta=%s conexión=%lld ms arranque->IP=%lld ms",
+             g_using_saved, g_fast_connect ? "rápida" : "escaneo completo",
+             (long long)((now_us - g_connect_start_us) / 1000), (long long)(now_us / 1000));
     if (g_connect_post_pending_save) {
         wifi_store_save(g_pending_ssid, g_pending_pass);
         g_connect_post_pending_save = false;
     }
+    // Solo se guarda el enlace de redes que están en la lista
+    remember_link(wifi_store_mark(g_sta_ssid, true) == ESP_OK);
+    set_link(CAPTIVE_LINK_UP);
+}
+
+static void sta_down(const cm_event_t *ev) {
+    ESP_LOGW(TAG,"STA disconnected (reason=%d) state=%s saved=%d attempts=%d",
+             ev->arg, captive_manager_state_str(g_state), g_using_saved, g_connect_attempts);
+    g_sta_have_ip = false;
+    metrics_inc(g_m_disconnects);
+    connectivity_stop();
+    set_link(CAPTIVE_LINK_DOWN);
+}
 
+// * + GOT_IP
+static void act_got_ip(const cm_event_t *ev) {
+    sta_up();
     #if defined(FORCE_AP_NAT_MODE)
         // Modo forzado: siempre habilita NAT y APSTA, sin comprobación de internet
-        if (g_sta_netif) esp_netif_set_default_netif(g_sta_netif);
-        if (g_ap_netif && g_sta_netif) {
-            uint8_t dhcps_offer_option = 0x02;
-            esp_netif_dns_info_t dns;
-            if (esp_netif_get_dns_info(g_sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
-                ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcps_stop(g_ap_netif));
-                ESP_ERROR_CHECK(esp_netif_dhcps_option(g_ap_netif, ESP_NETIF_OP_SET, ESP_NETIF_DOMAIN_NAME_SERVER,
-                                                       &dhcps_offer_option, sizeof(dhcps_offer_option)));
-                ESP_ERROR_CHECK(esp_netif_set_dns_info(g_ap_netif, ESP_NETIF_DNS_MAIN, &dns));
-                ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcps_start(g_ap_netif));
-            }
-        }
-        captive_manager_enable_nat();
+        start_portal_nat();
         set_state(CAP_STATE_WAIT_LOGIN);
     #else
-        // Modo normal: decide según conectividad
-        // Pequeña espera opcional para estabilizar la conexión antes de comprobar
-        vTaskDelay(pdMS_TO_TICKS(g_cfg.startup_check_delay_ms));
-        if (connectivity_portal_open()) {
-            // Hay internet: apaga AP, entra en modo STA, deja endpoint /wifi/clear y mDNS
-            set_state(CAP_STATE_VERIFY);
-            g_verify_success = 0;
-        } else {
-            // No hay internet: habilita NAT y APSTA
-            if (g_sta_netif) esp_netif_set_default_netif(g_sta_netif);
-            if (g_ap_netif && g_sta_netif) {
-                uint8_t dhcps_offer_option = 0x02;
-                esp_netif_dns_info_t dns;
-                if (esp_netif_get_dns_info(g_sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
-                    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcps_stop(g_ap_netif));
-                    ESP_ERROR_CHECK(esp_netif_dhcps_option(g_ap_netif, ESP_NETIF_OP_SET, ESP_NETIF_DOMAIN_NAME_SERVER,
-                                                           &dhcps_offer_option, sizeof(dhcps_offer_option)));
-                    ESP_ERROR_CHECK(esp_netif_set_dns_info(g_ap_netif, ESP_NETIF_DNS_MAIN, &dns));
-                    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcps_start(g_ap_netif));
-                }
-            }
-            captive_manager_enable_nat();
-            set_state(CAP_STATE_WAIT_LOGIN);
-        }
+        // Modo normal: decide según conectividad. El sondeo corre en su propia
+        // tarea; el primer resultado llega a act_first_check() (aún en CONNECTING)
+        connectivity_start(g_cfg.startup_check_delay_ms);
     #endif
 }
 
-void captive_manager_notify_sta_disconnected(int reason_code) {
-    ESP_LOGW(TAG,"STA disconnected (reason=%d) state=%s saved=%d attempts=%d",
-             reason_code, captive_manager_state_str(g_state), g_using_saved, g_connect_attempts);
-    g_sta_have_ip = false;
+// RECOVERING + GOT_IP: el AP ya estaba apagado, de vuelta a OPERATIONAL; el
+// sondeo dirá cuándo hay internet (LINK_ONLINE)
+static void act_recovered(const cm_event_t *ev) {
+    sta_up();
+    esp_timer_stop(g_retry_timer);
+    metrics_inc(g_m_reconnects);
+    ESP_LOGI(TAG, "Enlace recuperado tras %d reintentos en %lld ms", g_recover_attempts,
+             (long long)((esp_timer_get_time() - g_recover_start_us) / 1000));
+    set_state(CAP_STATE_OPERATIONAL);
+    connectivity_start(0);
+}
 
-    if (g_state == CAP_STATE_CONNECTING && g_using_saved) {
-        g_connect_attempts++;
-        if (g_connect_attempts < g_cfg.conn_max_attempts) {
-            vTaskDelay(pdMS_TO_TICKS(g_cfg.conn_retry_delay_ms));
+// * + STA_DISCONNECTED
+static void act_sta_down(const cm_event_t *ev) {
+    sta_down(ev);
+}
+
+// CONNECTING + STA_DISCONNECTED
+static void act_connect_failed(const cm_event_t *ev) {
+    sta_down(ev);
+    if (!g_using_saved) return;
+    if (g_fast_connect) {
+        // La reconexión rápida no cuenta como intento: al agotarla, escaneo completo
+        if (--g_fast_attempts_left > 0) {
             esp_wifi_connect();
-        } else {
-            ESP_LOGE(TAG,"Max reintentos alcanzado, limpiando credenciales y entrando a modo portal");
-            wifi_store_clear();
-            captive_manager_enter_recaptive();
+            return;
         }
-    } else if (g_state == CAP_STATE_OPERATIONAL) {
-        // Podrías decidir volver a recaptive; por ahora solo log
-        ESP_LOGW(TAG,"Desconexión en modo operativo (no se implementó recuperación automática)");
+        ESP_LOGW(TAG,"Reconexión rápida fallida tras %lld ms; escaneo completo",
+                 (long long)((esp_timer_get_time() - g_connect_start_us) / 1000));
+        fast_connect_fallback();
+        esp_wifi_connect();
+        return;
+    }
+    g_connect_attempts++;
+    if (g_connect_attempts < g_cfg.conn_max_attempts) {
+        esp_timer_start_once(g_retry_timer, (uint64_t)g_cfg.conn_retry_delay_ms * 1000);
+        return;
+    }
+    wifi_store_mark(g_sta_ssid, false);
+    wifi_store_net_t net;
+    if (pick_known_network(&net)) {
+        ESP_LOGW(TAG,"%s no conecta tras %d intentos; probando %s",
+                 g_sta_ssid, g_connect_attempts, net.ssid);
+        connect_sta(net.ssid, net.pass, true);
+    } else {
+        // Las credenciales se conservan: se vuelven a probar en el próximo arranque
+        ESP_LOGE(TAG,"Ninguna red guardada conecta; entrando a modo portal");
+        enter_recaptive();
     }
 }
 
-esp_err_t captive_manager_enter_recaptive(void) {
+// CONNECTING + RETRY_TIMER
+static void act_connect_retry(const cm_event_t *ev) {
+    esp_wifi_connect();
+}
+
+// OPERATIONAL + STA_DISCONNECTED: un intento inmediato al mismo AP y canal,
+// después escaneo completo con esperas que se duplican hasta el tope y, agotado
+// el presupuesto, vuelta al portal (las credenciales se conservan)
+static void act_link_lost(const cm_event_t *ev) {
+    sta_down(ev);
+    int64_t now_us = esp_timer_get_time();
+    set_state(CAP_STATE_RECOVERING);
+    g_recover_attempts = 0;
+    g_recover_start_us = now_us;
+    wifi_config_t sta_cfg;
+    if (g_cfg.fast_connect_attempts > 0 && g_link.channel &&
+        strcmp(g_link.ssid, g_sta_ssid) == 0 && esp_wifi_get_config(WIFI_IF_STA, &sta_cfg) == ESP_OK) {
+        fast_connect_target(&sta_cfg);
+        esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+    }
+    g_connect_start_us = now_us;
+    esp_wifi_connect();
+}
+
+// RECOVERING + STA_DISCONNECTED
+static void act_recover_failed(const cm_event_t *ev) {
+    sta_down(ev);
+    int64_t now_us = esp_timer_get_time();
+    g_recover_attempts++;
+    if (g_recover_attempts == 1) wifi_store_mark(g_sta_ssid, false);
+    if (g_fast_connect && --g_fast_attempts_left <= 0) fast_connect_fallback();
+    int64_t elapsed_ms = (now_us - g_recover_start_us) / 1000;
+    if (g_cfg.recover_budget_ms > 0 && elapsed_ms >= g_cfg.recover_budget_ms) {
+        ESP_LOGE(TAG,"Sin enlace tras %d reintentos (%lld ms); volviendo al portal",
+                 g_recover_attempts, (long long)elapsed_ms);
+        enter_recaptive();
+        return;
+    }
+    int delay_ms = g_cfg.recover_backoff_min_ms;
+    for (int i = 1; i < g_recover_attempts && delay_ms < g_cfg.recover_backoff_max_ms; i++) delay_ms *= 2;
+    if (delay_ms > g_cfg.recover_backoff_max_ms) delay_ms = g_cfg.recover_backoff_max_ms;
+    // ±25% para que varios equipos no reintenten al unísono tras un corte
+    delay_ms += (int)(esp_random() % (uint32_t)(delay_ms / 2 + 1)) - delay_ms / 4;
+    ESP_LOGW(TAG,"Recuperación: reintento %d en %d ms", g_recover_attempts + 1, delay_ms);
+    g_connect_start_us = now_us + (int64_t)delay_ms * 1000;
+    esp_timer_start_once(g_retry_timer, (uint64_t)delay_ms * 1000);
+}
+
+// RECOVERING + RETRY_TIMER
+static void act_recover_retry(const cm_event_t *ev) {
+    // Con varias redes guardadas se escanea antes: puede que la mejor ya sea otra
+    if (wifi_store_count() > 1 && wifi_scan_request() == ESP_OK) return; // sigue en act_recover_pick()
+    esp_wifi_connect();
+}
+
+// RECOVERING + SCAN_DONE
+static void act_recover_pick(const cm_event_t *ev) {
+    wifi_store_net_t net;
+    g_tried_mask = 0;
+    if (pick_known_network(&net) && strcmp(net.ssid, g_sta_ssid) != 0) {
+        ESP_LOGI(TAG, "Recuperación: cambiando de %s a %s", g_sta_ssid, net.ssid);
+        fast_connect_fallback();
+        wifi_config_t sta_cfg = {0};
+        sta_config_for(&sta_cfg, net.ssid, net.pass);
+        esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+    }
+    g_connect_start_us = esp_timer_get_time();
+    esp_wifi_connect();
+}
+
+static void enter_recaptive(void) {
     ESP_LOGW(TAG,"Entering recaptive mode");
     // Apagar servidor mínimo STA si estuviese activo
     stop_http_sta_minimal();
+    connectivity_stop();
+    esp_timer_stop(g_retry_timer);
+    set_link(CAPTIVE_LINK_DOWN);
     captive_manager_disable_nat();
     ESP_ERROR_CHECK(esp_wifi_disconnect());
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
@@ -298,76 +781,62 @@ esp_err_t captive_manager_enter_recaptive(void) {
     g_using_saved = false;
     set_state(CAP_STATE_SCAN);
     scan_start();
+}
+
+// * + RECAPTIVE
+static void act_recaptive(const cm_event_t *ev) {
+    enter_recaptive();
+}
+
+void captive_manager_notify_sta_got_ip(void) {
+    post_event(CM_EV_STA_GOT_IP, 0);
+}
+
+void captive_manager_notify_sta_disconnected(int reason_code) {
+    post_event(CM_EV_STA_DISCONNECTED, reason_code);
+}
+
+esp_err_t captive_manager_enter_recaptive(void) {
+    post_event(CM_EV_RECAPTIVE, 0);
     return ESP_OK;
 }
 
-// Scanning
+// Scanning: en segundo plano, /scan responde desde la caché de wifi_scan
 static void scan_start(void) {
-    wifi_scan_config_t sc = {
-        .show_hidden = false,
-        .scan_type = WIFI_SCAN_TYPE_ACTIVE
-    };
-    esp_wifi_scan_start(&sc, false);
+    wifi_scan_request();
 }
 
 // perform_scan_sync_and_respond eliminado: no se usa (reemplazado por scan_get)
 
-// HTTP Handlers (UI mejorada con selección y auto-disable pass)
-static esp_err_t root_get(httpd_req_t *r) {
+// HTTP Handlers
+// Portal embebido: web/index.html minificado y en gzip al compilar (ver CMakeLists.txt)
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[]   asm("_binary_index_html_gz_end");
+static char g_index_etag[12]; // "xxxxxxxx" con comillas, del contenido
+
+static void index_etag_init(void) {
+    if (g_index_etag[0]) return;
+    uint32_t h = 2166136261u; // FNV-1a
+    for (const uint8_t *p = index_html_gz_start; p < index_html_gz_end; p++) h = (h ^ *p) * 16777619u;
+    snprintf(g_index_etag, sizeof(g_index_etag), "\"%08lx\"", (unsigned long)h);
+    ESP_LOGI(TAG, "Portal embebido: %d B gzip, ETag %s",
+             (int)(index_html_gz_end - index_html_gz_start), g_index_etag);
+}
 
-    // Realizar escaneo de redes Wi-Fi
-    // HTML con <select> vacío y JS para renderizar redes
-    const char *page =
-        "<!DOCTYPE html><html><head><title>WF_MNGR_AMBT</title><meta name=\"viewport\" content=\"width=device-width,initial-scale=1\">"
-        "<style>body{text-align:center;margin:0}.card{background:#fff;box-shadow:2px 2px 12px rgba(0,0,0,.2);padding:20px;max-width:400px;margin:auto;border-radius:8px}"
-        "select,input{width:80%%;padding:12px;margin:10px 0;border:1px solid #ccc;border-radius:4px}input[type=submit]{background:#034078;color:#fff;padding:15px;border:none;border-radius:4px;cursor:pointer}"
-        "input[type=submit]:hover{background:#1282A2}label{display:block;margin-top:10px}</style></head><body>"
-        "<div style=\"background:#0A1128;padding:10px\"><h1 style=\"color:white;font-size:25px\">Wi-Fi Manager Ambiente</h1></div>"
-        "<div class=\"card\"><form id=\"wifiForm\"><label for=\"ssid\">SSID</label><select id=\"ssid\" name=\"ssid\" required></select>"
-        "<label for=\"pass\">Pass</label><input type=\"password\" id=\"pass\" name=\"pass\"><input type=\"submit\" value=\"Guardar\"></form></div>"
-        "<script>"
-        "function loadNetworks() {"
-        "fetch('/scan').then(r=>r.json()).then(j=> {"
-        "let s=document.getElementById('ssid'); s.innerHTML='';"
-        "j.networks.forEach(n=> {"
-        "let opt=document.createElement('option');"
-        "opt.value=n.ssid; opt.text=n.ssid + (n.open==1 ? ' (Abierta)' : ''); opt.setAttribute('data-open', n.open ? '1' : '0');"
-        "s.appendChild(opt);"
-        "});"
-        "s.dispatchEvent(new Event('change'));"
-        "});"
-        "}"
-        "const s=document.getElementById('ssid'),p=document.getElementById('pass');"
-        "function updatePassField() {"
-        "  const o=s.options[s.selectedIndex];"
-        "  if(o && o.getAttribute('data-open')==='1') {"
-        "    p.disabled=true; p.value='';"
-        "  } else {"
-        "    p.disabled=false;"
-        "  }"
-        "}"
-        "s.addEventListener('change',updatePassField);"
-        "window.onload=()=>{loadNetworks();updatePassField();};"
-        // Nuevo: enviar datos como JSON vía fetch
-        "document.getElementById('wifiForm').onsubmit=function(e){"
-        "  e.preventDefault();"
-        "  const ssid=s.value, pass=p.value;"
-        "  fetch('/save', {"
-        "    method:'POST',"
-        "    headers:{'Content-Type':'application/json'},"
-        "    body:JSON.stringify({ssid:ssid,pass:pass})"
-        "  }).then(r=>r.text()).then(txt=>{"
-        "    if (txt.trim()==='OK') {"
-        "      alert('Datos enviados correctamente, El dispositivo intentara conectarse.');"
-        "    } else {"
-        "      alert('Respuesta inesperada: '+txt);"
-        "    }"
-        "  }).catch(()=>alert('Error al enviar datos'));"
-        "};"
-        "</script></body></html>";
+static esp_err_t root_get(httpd_req_t *r) {
+    // no-cache: el navegador revalida siempre (un 304 sin cuerpo) y tras
+    // actualizar el firmware recibe la página nueva
+    httpd_resp_set_hdr(r, "ETag", g_index_etag);
+    httpd_resp_set_hdr(r, "Cache-Control", "no-cache");
+    char inm[sizeof(g_index_etag) + 4];
+    if (httpd_req_get_hdr_value_str(r, "If-None-Match", inm, sizeof(inm)) == ESP_OK &&
+        strcmp(inm, g_index_etag) == 0) {
+        httpd_resp_set_status(r, "304 Not Modified");
+        return httpd_resp_send(r, NULL, 0);
+    }
     httpd_resp_set_type(r, "text/html");
-    httpd_resp_send(r, page, strlen(page));
-    return ESP_OK;
+    httpd_resp_set_hdr(r, "Content-Encoding", "gzip");
+    return httpd_resp_send(r, (const char *)index_html_gz_start, index_html_gz_end - index_html_gz_start);
 }
 
 // Handler global para /save
@@ -392,49 +861,60 @@ static esp_err_t save_post(httpd_req_t *r) {
     httpd_resp_sendstr(r, "OK");
 
     // Lanzar reinicio diferido
-    xTaskCreate(restart_later_task, "rst_later", 2048, NULL, 5, NULL);
+    restart_later();
 
     cJSON_Delete(root);
     return ESP_OK;
 }
 
+// Copia ssid escapando lo que rompería el JSON
+static void json_escape(char *dst, size_t dst_len, const char *src) {
+    size_t o = 0;
+    for (; *src && o + 7 < dst_len; src++) {
+        unsigned char c = (unsigned char)*src;
+        if (c == '"' || c == '\\') {
+            dst[o++] = '\\';
+            dst[o++] = (char)c;
+        } else if (c < 0x20) {
+            o += snprintf(dst + o, dst_len - o, "\\u%04x", c);
+        } else {
+            dst[o++] = (char)c;
+        }
+    }
+    dst[o] = 0;
+}
+
 static esp_err_t scan_get(httpd_req_t *r) {
-    // Escaneo de hasta 10 redes y respuesta en JSON
-    // Guardar modo actual
-    wifi_mode_t old_mode;
-    esp_wifi_get_mode(&old_mode);
-    if (old_mode != WIFI_MODE_APSTA) {
-        esp_wifi_set_mode(WIFI_MODE_APSTA);
-    }
-    wifi_scan_config_t sc = { .show_hidden = false };
-    esp_wifi_scan_start(&sc, true);
-    uint16_t ap_num = 0;
-    esp_wifi_scan_get_ap_num(&ap_num);
-    ESP_LOGI("SCAN", "Redes detectadas: %d", ap_num);
-    if (ap_num > 20) ap_num = 20;
-    wifi_ap_record_t *list = calloc(ap_num, sizeof(wifi_ap_record_t));
-    if (!list) {
-        ESP_LOGE("SCAN", "OOM al reservar array");
-        httpd_resp_send_err(r, HTTPD_500_INTERNAL_SERVER_ERROR, "OOM");
-        // Restaurar modo original si fue cambiado
-        if (old_mode != WIFI_MODE_APSTA) esp_wifi_set_mode(old_mode);
-        return ESP_FAIL;
-    }
-    esp_wifi_scan_get_ap_records(&ap_num, list);
+    // Responde al momento desde la caché; si está vacía o vieja, pide otro escaneo
+    int64_t updated_us;
+    wifi_scan_get(NULL, 0, 0, &updated_us);
+    int64_t age_ms = updated_us < 0 ? -1 : (esp_timer_get_time() - updated_us) / 1000;
+    if (age_ms < 0 || age_ms > g_cfg.scan_max_age_ms) wifi_scan_request();
+
     httpd_resp_set_type(r, "application/json");
+    httpd_resp_set_hdr(r, "Cache-Control", "no-store");
     httpd_resp_send_chunk(r, "{\"networks\":[", -1);
-    for (int i = 0; i < ap_num; i++) {
-        char buf[96];
-        int open = (list[i].authmode == WIFI_AUTH_OPEN) ? 1 : 0;
-        snprintf(buf, sizeof(buf), "{\"ssid\":\"%s\",\"open\":%d}", (char*)list[i].ssid, open);
-        httpd_resp_send_chunk(r, buf, -1);
-        if (i < ap_num - 1) httpd_resp_send_chunk(r, ",", -1);
-    }
-    httpd_resp_send_chunk(r, "]}", -1);
+    wifi_scan_entry_t chunk[4];
+    int sent = 0;
+    for (;;) {
+        int64_t stamp;
+        int n = wifi_scan_get(chunk, sent, sizeof(chunk) / sizeof(chunk[0]), &stamp);
+        if (n <= 0 || stamp != updated_us) break; // terminó o llegó un escaneo nuevo
+        for (int i = 0; i < n; i++) {
+            char ssid[33 * 6];
+            char buf[sizeof(ssid) + 64];
+            json_escape(ssid, sizeof(ssid), chunk[i].ssid);
+            snprintf(buf, sizeof(buf), "%s{\"ssid\":\"%s\",\"open\":%d,\"rssi\":%d}",
+                     sent + i ? "," : "", ssid, chunk[i].authmode == WIFI_AUTH_OPEN ? 1 : 0, chunk[i].rssi);
+            httpd_resp_send_chunk(r, buf, -1);
+        }
+        sent += n;
+    }
+    char tail[64];
+    snprintf(tail, sizeof(tail), "],\"age_ms\":%lld,\"scanning\":%s}",
+             (long long)age_ms, wifi_scan_in_progress() ? "true" : "false");
+    httpd_resp_send_chunk(r, tail, -1);
     httpd_resp_send_chunk(r, NULL, 0);
-    free(list);
-    // Restaurar modo original si fue cambiado
-    if (old_mode != WIFI_MODE_APSTA) esp_wifi_set_mode(old_mode);
     return ESP_OK;
 }
 
@@ -455,19 +935,28 @@ static esp_err_t connect_post(httpd_req_t *r) {
     wifi_store_save(ssid, pass);
     start_mdns_service(); // mDNS tras cambio de modo
     httpd_resp_sendstr(r, "OK");
-    xTaskCreate(restart_later_task, "rst_later", 2048, NULL, 5, NULL);
+    restart_later();
 
     cJSON_Delete(root);
     return ESP_OK;
 }
 
 static esp_err_t status_get(httpd_req_t *r) {
+    captive_manager_status_t st;
+    captive_manager_get_status(&st);
     cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root,"state", captive_manager_state_str(g_state));
-    cJSON_AddBoolToObject(root,"sta_ip", g_sta_have_ip);
-    cJSON_AddBoolToObject(root,"using_saved", g_using_saved);
-    cJSON_AddNumberToObject(root,"verify_success", g_verify_success);
-    cJSON_AddNumberToObject(root,"conn_attempts", g_connect_attempts);
+    cJSON_AddStringToObject(root,"state", captive_manager_state_str(st.state));
+    cJSON_AddBoolToObject(root,"sta_ip", st.sta_have_ip);
+    cJSON_AddBoolToObject(root,"using_saved", st.using_saved);
+    cJSON_AddNumberToObject(root,"verify_success", st.verify_success);
+    cJSON_AddNumberToObject(root,"conn_attempts", st.connect_attempts);
+    captive_manager_metrics_t m;
+    captive_manager_get_metrics(&m);
+    cJSON_AddNumberToObject(root,"in_state_ms", (double)m.in_state_ms);
+    cJSON_AddNumberToObject(root,"transitions", m.transitions);
+    cJSON_AddNumberToObject(root,"latency_avg_us", m.latency_avg_us);
+    cJSON_AddNumberToObject(root,"latency_max_us", m.latency_max_us);
+    cJSON_AddNumberToObject(root,"events_dropped", m.events_dropped);
     char *out = cJSON_PrintUnformatted(root);
     httpd_resp_set_type(r,"application/json");
     httpd_resp_sendstr(r,out);
@@ -490,7 +979,86 @@ static esp_err_t wifi_clear_delete(httpd_req_t *r) {
     }
 
     // Reiniciar poco después (respuesta ya enviada)
-    xTaskCreate(restart_later_task, "rst_later", 2048, NULL, 5, NULL);
+    restart_later();
+    return ESP_OK;
+}
+
+// Lee el cuerpo JSON de la petición; NULL (y respuesta 400 enviada) si no se puede
+static cJSON *recv_json(httpd_req_t *r) {
+    char buf[256];
+    int len = httpd_req_recv(r, buf, sizeof(buf)-1);
+    if (len <= 0) {
+        httpd_resp_send_err(r, HTTPD_400_BAD_REQUEST, "empty");
+        return NULL;
+    }
+    buf[len]=0;
+    cJSON *root = cJSON_Parse(buf);
+    if (!root) httpd_resp_send_err(r, HTTPD_400_BAD_REQUEST, "json");
+    return root;
+}
+
+// Redes guardadas (sin contraseñas) con su señal en el último escaneo
+static esp_err_t networks_get(httpd_req_t *r) {
+    captive_manager_status_t st;
+    captive_manager_get_status(&st);
+    cJSON *root = cJSON_CreateObject();
+    cJSON *arr = cJSON_AddArrayToObject(root, "networks");
+    wifi_store_net_t net;
+    for (int i = 0; wifi_store_get(i, &net) == ESP_OK; i++) {
+        cJSON *o = cJSON_CreateObject();
+        wifi_scan_entry_t seen;
+        bool visible = wifi_scan_find(net.ssid, &seen);
+        cJSON_AddStringToObject(o, "ssid", net.ssid);
+        cJSON_AddNumberToObject(o, "priority", net.priority);
+        cJSON_AddNumberToObject(o, "failures", net.failures);
+        cJSON_AddNumberToObject(o, "last_ok", net.last_ok);
+        cJSON_AddBoolToObject(o, "visible", visible);
+        if (visible) cJSON_AddNumberToObject(o, "rssi", seen.rssi);
+        cJSON_AddBoolToObject(o, "active", st.sta_have_ip && strcmp(net.ssid, st.ssid) == 0);
+        cJSON_AddItemToArray(arr, o);
+    }
+    cJSON_AddNumberToObject(root, "max", WIFI_STORE_MAX_NETWORKS);
+    memset(&net, 0, sizeof(net)); // no dejar la contraseña en el stack
+    char *out = cJSON_PrintUnformatted(root);
+    httpd_resp_set_type(r, "application/json");
+    httpd_resp_set_hdr(r, "Cache-Control", "no-store");
+    httpd_resp_sendstr(r, out);
+    free(out);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+// Alta o cambio de prioridad sin reiniciar: {"ssid":..,"pass":..,"priority":n}
+static esp_err_t networks_post(httpd_req_t *r) {
+    cJSON *root = recv_json(r);
+    if (!root) return ESP_OK;
+    cJSON *js = cJSON_GetObjectItem(root,"ssid");
+    cJSON *jp = cJSON_GetObjectItem(root,"pass");
+    cJSON *jprio = cJSON_GetObjectItem(root,"priority");
+    if (!cJSON_IsString(js)) {
+        cJSON_Delete(root);
+        return httpd_resp_send_err(r, HTTPD_400_BAD_REQUEST, "ssid?");
+    }
+    int prio = cJSON_IsNumber(jprio) ? jprio->valueint : -1;
+    if (prio > 255) prio = 255;
+    esp_err_t err = wifi_store_add(js->valuestring, cJSON_IsString(jp) ? jp->valuestring : "", prio);
+    cJSON_Delete(root);
+    if (err == ESP_ERR_INVALID_ARG) return httpd_resp_send_err(r, HTTPD_400_BAD_REQUEST, "ssid?");
+    if (err != ESP_OK) return httpd_resp_send_err(r, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+    httpd_resp_sendstr(r, "OK");
+    return ESP_OK;
+}
+
+static esp_err_t networks_delete(httpd_req_t *r) {
+    cJSON *root = recv_json(r);
+    if (!root) return ESP_OK;
+    cJSON *js = cJSON_GetObjectItem(root,"ssid");
+    esp_err_t err = cJSON_IsString(js) ? wifi_store_remove(js->valuestring) : ESP_ERR_INVALID_ARG;
+    cJSON_Delete(root);
+    if (err == ESP_ERR_INVALID_ARG) return httpd_resp_send_err(r, HTTPD_400_BAD_REQUEST, "ssid?");
+    if (err == ESP_ERR_NOT_FOUND) return httpd_resp_send_err(r, HTTPD_404_NOT_FOUND, "ssid");
+    if (err != ESP_OK) return httpd_resp_send_err(r, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+    httpd_resp_sendstr(r, "OK");
     return ESP_OK;
 }
 
@@ -508,13 +1076,19 @@ static httpd_uri_t uri_connect   = { .uri="/connect",     .method=HTTP_POST,   .
 static httpd_uri_t uri_save      = { .uri="/save",        .method=HTTP_POST,   .handler=save_post };
 static httpd_uri_t uri_status    = { .uri="/status",      .method=HTTP_GET,    .handler=status_get };
 static httpd_uri_t uri_wifi_clr  = { .uri="/wifi/clear",  .method=HTTP_DELETE, .handler=wifi_clear_delete };
+static httpd_uri_t uri_metrics   = { .uri="/metrics",     .method=HTTP_GET,    .handler=metrics_http_get };
 static httpd_uri_t uri_wifi_clr_get = { .uri="/wifi/clear", .method=HTTP_GET,    .handler=wifi_clear_get };
+static httpd_uri_t uri_nets_get  = { .uri="/wifi/networks", .method=HTTP_GET,    .handler=networks_get };
+static httpd_uri_t uri_nets_post = { .uri="/wifi/networks", .method=HTTP_POST,   .handler=networks_post };
+static httpd_uri_t uri_nets_del  = { .uri="/wifi/networks", .method=HTTP_DELETE, .handler=networks_delete };
 
 static esp_err_t start_http(void) {
     httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
     cfg.max_open_sockets = 2; // Limitar a 2 conexiones simultáneas
     cfg.stack_size = 8192; // Aumentar stack para httpd y evitar overflow
     cfg.lru_purge_enable = true;
+    cfg.max_uri_handlers = 12;
+    index_etag_init();
     if (httpd_start(&g_server, &cfg) == ESP_OK) {
     httpd_register_uri_handler(g_server,&uri_root);
     httpd_register_uri_handler(g_server,&uri_scan);
@@ -523,12 +1097,23 @@ static esp_err_t start_http(void) {
     httpd_register_uri_handler(g_server,&uri_status);
     httpd_register_uri_handler(g_server,&uri_wifi_clr);
     httpd_register_uri_handler(g_server,&uri_wifi_clr_get);
+    httpd_register_uri_handler(g_server,&uri_nets_get);
+    httpd_register_uri_handler(g_server,&uri_nets_post);
+    httpd_register_uri_handler(g_server,&uri_nets_del);
         return ESP_OK;
     }
     return ESP_FAIL;
 }
 
-// Servidor mínimo en STA solo para /wifi/clear
+esp_err_t captive_manager_add_sta_handler(const httpd_uri_t *uri) {
+    if (!uri) return ESP_ERR_INVALID_ARG;
+    if (g_sta_extra_count >= CAPTIVE_MANAGER_MAX_STA_HANDLERS) return ESP_ERR_NO_MEM;
+    g_sta_extra[g_sta_extra_count++] = *uri;
+    return ESP_OK;
+}
+
+// Servidor mínimo en STA: /wifi/clear, gestión de redes guardadas y los
+// endpoints añadidos con captive_manager_add_sta_handler()
 static esp_err_t start_http_sta_minimal(void) {
     ESP_LOGI(TAG, "Intentando iniciar STA-min HTTP server...");
     if (g_sta_server) {
@@ -536,13 +1121,21 @@ static esp_err_t start_http_sta_minimal(void) {
         return ESP_OK;
     }
     httpd_config_t cfg = HTTPD_DEFAULT_CONFIG();
-    cfg.max_open_sockets = 1;
+    cfg.max_open_sockets = g_cfg.sta_max_sockets > 0 ? g_cfg.sta_max_sockets : 1;
     cfg.stack_size = 4096;
     cfg.lru_purge_enable = true;
+    cfg.max_uri_handlers = 6 + CAPTIVE_MANAGER_MAX_STA_HANDLERS;
     if (httpd_start(&g_sta_server, &cfg) == ESP_OK) {
         httpd_register_uri_handler(g_sta_server, &uri_wifi_clr);
+        httpd_register_uri_handler(g_sta_server, &uri_metrics);
         httpd_register_uri_handler(g_sta_server, &uri_wifi_clr_get);
-        ESP_LOGI(TAG, "STA-min HTTP server started (/wifi/clear)");
+        httpd_register_uri_handler(g_sta_server, &uri_nets_get);
+        httpd_register_uri_handler(g_sta_server, &uri_nets_post);
+        httpd_register_uri_handler(g_sta_server, &uri_nets_del);
+        for (int i = 0; i < g_sta_extra_count; i++) {
+            httpd_register_uri_handler(g_sta_server, &g_sta_extra[i]);
+        }
+        ESP_LOGI(TAG, "STA-min HTTP server started (/wifi/clear, /wifi/networks, /metrics)");
         return ESP_OK;
     }
     ESP_LOGE(TAG, "STA-min HTTP server NO se pudo iniciar");
@@ -571,32 +1164,122 @@ static void shutdown_ap(void) {
     start_http_sta_minimal();
 }
 
-// Periodic task
+// Resultados del sondeo de conectividad (event loop por defecto)
 #if !defined(FORCE_AP_NAT_MODE)
-static void periodic_check_task(void *arg) {
-    for (;;) {
-        vTaskDelay(pdMS_TO_TICKS(g_cfg.check_interval_ms));
-        if (g_state == CAP_STATE_WAIT_LOGIN || g_state == CAP_STATE_VERIFY) {
-            bool open = connectivity_portal_open();
-            if (open) {
-                if (g_state == CAP_STATE_WAIT_LOGIN) {
-                    set_state(CAP_STATE_VERIFY);
-                    g_verify_success = 0;
-                }
-                g_verify_success++;
-                if (g_verify_success >= g_cfg.verify_success_needed) {
-                    shutdown_ap();
-                    set_state(CAP_STATE_OPERATIONAL);
-                    // shutdown_ap() ya intenta iniciar STA-min, pero por seguridad
-                    start_http_sta_minimal();
-                }
-            } else {
-                g_verify_success = 0;
-            }
+static void on_connectivity_result(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    const connectivity_result_t *res = (const connectivity_result_t *)data;
+    post_event(CM_EV_CONNECTIVITY, res->verdict);
+}
+#endif
+
+// CONNECTING + CONNECTIVITY: primer resultado tras GOT_IP, decide VERIFY o portal con NAT
+static void act_first_check(const cm_event_t *ev) {
+    if (!g_sta_have_ip) return; // resultado de una conexión anterior
+    if (ev->arg == CONNECTIVITY_ONLINE) {
+        // Hay internet: VERIFY confirma con éxitos seguidos antes de apagar el AP
+        set_state(CAP_STATE_VERIFY);
+        g_verify_success = 0;
+    } else {
+        // No hay internet (o hay portal): habilita NAT y APSTA
+        start_portal_nat();
+        set_state(CAP_STATE_WAIT_LOGIN);
+    }
+}
+
+// WAIT_LOGIN / VERIFY + CONNECTIVITY
+static void act_verify(const cm_event_t *ev) {
+    if (ev->arg != CONNECTIVITY_ONLINE) {
+        g_verify_success = 0;
+        return;
+    }
+    if (g_state == CAP_STATE_WAIT_LOGIN) {
+        set_state(CAP_STATE_VERIFY);
+        g_verify_success = 0;
+    }
+    g_verify_success++;
+    if (g_verify_success >= g_cfg.verify_success_needed) {
+        shutdown_ap();
+        set_state(CAP_STATE_OPERATIONAL);
+        set_link(CAPTIVE_LINK_ONLINE);
+        // shutdown_ap() ya intenta iniciar STA-min, pero por seguridad
+        start_http_sta_minimal();
+    }
+}
+
+// OPERATIONAL + CONNECTIVITY
+static void act_online_check(const cm_event_t *ev) {
+    set_link(ev->arg == CONNECTIVITY_ONLINE ? CAPTIVE_LINK_ONLINE : CAPTIVE_LINK_UP);
+}
+
+// Tabla de transiciones: gana la primera fila que coincide con estado y
+// evento; CAP_STATE_COUNT vale para cualquier estado. Un evento sin fila se
+// descarta (p. ej. un reintento que llega cuando ya hay IP)
+#define CM_ANY_STATE CAP_STATE_COUNT
+
+typedef struct {
+    captive_state_t state;
+    cm_event_type_t event;
+    void (*action)(const cm_event_t *ev);
+} cm_transition_t;
+
+static const cm_transition_t k_transitions[] = {
+    { CAP_STATE_IDLE,        CM_EV_START,            act_start },
+    { CAP_STATE_PREP,        CM_EV_SCAN_DONE,        act_boot_pick },
+    { CAP_STATE_CONNECTING,  CM_EV_STA_DISCONNECTED, act_connect_failed },
+    { CAP_STATE_CONNECTING,  CM_EV_RETRY_TIMER,      act_connect_retry },
+    { CAP_STATE_CONNECTING,  CM_EV_CONNECTIVITY,     act_first_check },
+    { CAP_STATE_WAIT_LOGIN,  CM_EV_CONNECTIVITY,     act_verify },
+    { CAP_STATE_VERIFY,      CM_EV_CONNECTIVITY,     act_verify },
+    { CAP_STATE_OPERATIONAL, CM_EV_CONNECTIVITY,     act_online_check },
+    { CAP_STATE_OPERATIONAL, CM_EV_STA_DISCONNECTED, act_link_lost },
+    { CAP_STATE_RECOVERING,  CM_EV_STA_GOT_IP,       act_recovered },
+    { CAP_STATE_RECOVERING,  CM_EV_STA_DISCONNECTED, act_recover_failed },
+    { CAP_STATE_RECOVERING,  CM_EV_RETRY_TIMER,      act_recover_retry },
+    { CAP_STATE_RECOVERING,  CM_EV_SCAN_DONE,        act_recover_pick },
+    { CM_ANY_STATE,          CM_EV_STA_GOT_IP,       act_got_ip },
+    { CM_ANY_STATE,          CM_EV_STA_DISCONNECTED, act_sta_down },
+    { CM_ANY_STATE,          CM_EV_RECAPTIVE,        act_recaptive },
+};
+
+static void dispatch(const cm_event_t *ev) {
+    const cm_transition_t *t = NULL;
+    for (size_t i = 0; i < sizeof(k_transitions) / sizeof(k_transitions[0]) && !t; i++) {
+        if (k_transitions[i].event == ev->type &&
+            (k_transitions[i].state == g_state || k_transitions[i].state == CM_ANY_STATE)) {
+            t = &k_transitions[i];
         }
     }
+    if (!t) {
+        ESP_LOGD(TAG, "Evento %d ignorado en %s", (int)ev->type, captive_manager_state_str(g_state));
+        portENTER_CRITICAL(&g_metrics_mux);
+        g_metrics.events_ignored++;
+        portEXIT_CRITICAL(&g_metrics_mux);
+        return;
+    }
+    t->action(ev);
+    publish_status();
+    uint32_t latency_us = (uint32_t)(esp_timer_get_time() - ev->posted_us);
+    portENTER_CRITICAL(&g_metrics_mux);
+    g_metrics.events++;
+    g_metrics.latency_last_us = latency_us;
+    if (latency_us > g_metrics.latency_max_us) g_metrics.latency_max_us = latency_us;
+    g_metrics.latency_avg_us = g_metrics.events == 1 ? latency_us
+        : g_metrics.latency_avg_us + ((int32_t)latency_us - (int32_t)g_metrics.latency_avg_us) / 8;
+    portEXIT_CRITICAL(&g_metrics_mux);
+}
+
+// Única tarea que cambia el estado: consume la cola en orden, sin sondeos
+static void captive_task(void *arg) {
+    cm_event_t ev;
+    for (;;) {
+        if (xQueueReceive(g_queue, &ev, portMAX_DELAY) != pdTRUE) continue;
+        uint32_t depth = uxQueueMessagesWaiting(g_queue) + 1;
+        portENTER_CRITICAL(&g_metrics_mux);
+        if (depth > g_metrics.queue_max) g_metrics.queue_max = depth;
+        portEXIT_CRITICAL(&g_metrics_mux);
+        dispatch(&ev);
+    }
 }
-#endif
 
 // mDNS service
 // Iniciar mDNS si está habilitado en sdkconfig
@@ -647,39 +1330,9 @@ void captive_manager_disable_nat(void) {
     }
 }
 
-// Stub de verificación de portal/conectividad. Ajusta según tu lógica real.
+// Último veredicto del sondeo en segundo plano; no bloquea ni genera tráfico
 bool connectivity_portal_open(void) {
-    // Verifica conectividad saliente intentando acceder a un endpoint conocido
-    // que devuelve HTTP 204 sin contenido cuando hay internet sin portal cautivo.
-    // Evitamos seguir redirecciones para detectar portales cautivos (3xx/200 con contenido).
-    esp_http_client_config_t cfg = {
-        .url = "http://connectivitycheck.gstatic.com/generate_204",
-        .timeout_ms = 2000,
-        .disable_auto_redirect = true,
-    };
-    esp_http_client_handle_t client = esp_http_client_init(&cfg);
-    if (!client) {
-        ESP_LOGW(TAG, "connectivity_check: init failed");
-        return false;
-    }
-    esp_err_t err = esp_http_client_open(client, 0);
-    if (err != ESP_OK) {
-        ESP_LOGI(TAG, "connectivity_check: open err=%s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
-        return false;
-    }
-    int64_t hdrs = esp_http_client_fetch_headers(client);
-    int status = esp_http_client_get_status_code(client);
-    // Cerrar y limpiar
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-
-    ESP_LOGI(TAG, "connectivity_check: http status=%d (hdrs=%lld)", status, (long long)hdrs);
-    // Considera 204 como OK, y 200 como parcialmente OK (algunas redes devuelven 200)
-    if (status == 204 || status == 200) {
-        return true;
-    }
-    return false;
+    return connectivity_get_verdict() == CONNECTIVITY_ONLINE;
 }
 
 // maybe_start_captive_after_saved_ip eliminado: no se usa
\ No newline at end of file
@@ -0,0 +1,419 @@
+#include "connectivity.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_http_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "connectivity";
+
+ESP_EVENT_DEFINE_BASE(CONNECTIVITY_EVENT);
+
+// Bits del event group: GO arranca la sonda, DONE avisa que dejó su resultado
+#define GO_BIT(p)   (1u << (p))
+#define DONE_BIT(p) (1u << ((p) + 8))
+
+// Órdenes a la tarea coordinadora (xTaskNotify, eSetBits)
+#define CMD_START (1u << 0)
+#define CMD_STOP  (1u << 1)
+#define CMD_NOW   (1u << 2)
+
+static connectivity_cfg_t g_cfg;
+static char g_host[64];
+static int  g_port = 443;
+static bool g_enabled[CONN_PROBE_COUNT];
+
+static TaskHandle_t g_prober = NULL;
+static EventGroupHandle_t g_bits = NULL;
+static SemaphoreHandle_t g_lock = NULL;    // protege g_stats
+
+// Cada sonda deja aquí su resultado antes de poner DONE; busy evita lanzar
+// otra vez una sonda que sigue colgada de la ronda anterior
+static connectivity_probe_result_t g_pending[CONN_PROBE_COUNT];
+static volatile bool g_busy[CONN_PROBE_COUNT];
+
+static connectivity_probe_stats_t g_stats[CONN_PROBE_COUNT];
+static volatile connectivity_verdict_t g_verdict = CONNECTIVITY_UNKNOWN;
+static volatile bool g_running = false;
+static volatile int g_first_delay_ms = 0;
+static int g_interval_ms = 0;
+static uint32_t g_round = 0;
+
+const char *connectivity_probe_name(connectivity_probe_t probe) {
+    switch (probe) {
+        case CONN_PROBE_HTTP: return "http";
+        case CONN_PROBE_DNS:  return "dns";
+        case CONN_PROBE_TCP:  return "tcp";
+        default: return "?";
+    }
+}
+
+const char *connectivity_verdict_str(connectivity_verdict_t verdict) {
+    switch (verdict) {
+        case CONNECTIVITY_UNKNOWN: return "UNKNOWN";
+        case CONNECTIVITY_OFFLINE: return "OFFLINE";
+        case CONNECTIVITY_PORTAL:  return "PORTAL";
+        case CONNECTIVITY_ONLINE:  return "ONLINE";
+        default: return "?";
+    }
+}
+
+static int elapsed_ms(int64_t since_us) {
+    return (int)((esp_timer_get_time() - since_us) / 1000);
+}
+
+// Acepta "host", "host:puerto" o una URL; el puerto por defecto sale del esquema
+static void parse_host(const char *url) {
+    const char *p = strstr(url, "://");
+    g_port = 443;
+    if (p) {
+        if (strncmp(url, "http://", 7) == 0) g_port = 80;
+        p += 3;
+    } else {
+        p = url;
+    }
+    size_t n = strcspn(p, ":/?#");
+    snprintf(g_host, sizeof(g_host), "%.*s", (int)n, p);
+    if (p[n] == ':') g_port = atoi(p + n + 1);
+}
+
+// Sondas ---------------------------------------------------------------------
+
+// 204 sin seguir redirecciones; un 200 vacío también vale (algunos proxies).
+// Cualquier otra respuesta es un portal que intercepta el tráfico.
+static void probe_http(connectivity_probe_result_t *r) {
+    esp_http_client_config_t cfg = {
+        .url = g_cfg.http_url,
+        .timeout_ms = g_cfg.timeout_ms,
+        .disable_auto_redirect = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client) return;
+    int64_t t0 = esp_timer_get_time();
+    if (esp_http_client_open(client, 0) == ESP_OK) {
+        int64_t len = esp_http_client_fetch_headers(client);
+        r->status = esp_http_client_get_status_code(client);
+        r->ok = r->status == 204 || (r->status == 200 && len == 0);
+        if (r->ok) r->rtt_ms = elapsed_ms(t0);
+        esp_http_client_close(client);
+    }
+    esp_http_client_cleanup(client);
+}
+
+// Consulta A directa al DNS de la interfaz: getaddrinfo() respondería desde
+// la caché de lwIP y no daría ni RTT ni timeout propios
+static void probe_dns(connectivity_probe_result_t *r) {
+    esp_netif_dns_info_t dns;
+    if (esp_netif_get_dns_info(g_cfg.netif, ESP_NETIF_DNS_MAIN, &dns) != ESP_OK ||
+        dns.ip.type != ESP_IPADDR_TYPE_V4 || dns.ip.u_addr.ip4.addr == 0) {
+        return;
+    }
+
+    uint8_t msg[300];
+    uint16_t id = (uint16_t)esp_random();
+    memset(msg, 0, 12);
+    msg[0] = id >> 8;
+    msg[1] = id & 0xff;
+    msg[2] = 0x01;  // RD
+    msg[5] = 1;     // QDCOUNT
+    size_t len = 12;
+    for (const char *label = g_host; *label;) {
+        size_t n = strcspn(label, ".");
+        if (n == 0 || n > 63 || len + n + 6 > sizeof(msg)) return;
+        msg[len++] = (uint8_t)n;
+        memcpy(msg + len, label, n);
+        len += n;
+        label += n;
+        if (*label == '.') label++;
+    }
+    msg[len++] = 0;
+    msg[len++] = 0; msg[len++] = 1;  // QTYPE A
+    msg[len++] = 0; msg[len++] = 1;  // QCLASS IN
+
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0) return;
+    struct timeval tv = { .tv_sec = g_cfg.timeout_ms / 1000, .tv_usec = (g_cfg.timeout_ms % 1000) * 1000 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in to = {
+        .sin_family = AF_INET,
+        .sin_port = htons(53),
+        .sin_addr.s_addr = dns.ip.u_addr.ip4.addr,
+    };
+    int64_t t0 = esp_timer_get_time();
+    if (sendto(s, msg, len, 0, (struct sockaddr *)&to, sizeof(to)) == (int)len) {
+        // Descarta respuestas ajenas (otro id) hasta el timeout
+        for (;;) {
+            int n = recvfrom(s, msg, sizeof(msg), 0, NULL, NULL);
+            if (n < 0) {
+                r->status = errno;
+                break;
+            }
+            if (n < 12 || msg[0] != (id >> 8) || msg[1] != (id & 0xff)) continue;
+            r->status = msg[3] & 0x0f;  // RCODE
+            r->ok = r->status == 0 && (msg[6] | msg[7]) != 0;
+            if (r->ok) r->rtt_ms = elapsed_ms(t0);
+            break;
+        }
+    }
+    close(s);
+}
+
+// connect() no bloqueante al host de Firebase; el RTT es solo el handshake
+static void probe_tcp(connectivity_probe_result_t *r) {
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    char port[8];
+    snprintf(port, sizeof(port), "%d", g_port);
+    int err = getaddrinfo(g_host, port, &hints, &res);
+    if (err != 0 || !res) {
+        r->status = err;
+        return;
+    }
+    int s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (s < 0) {
+        r->status = errno;
+        freeaddrinfo(res);
+        return;
+    }
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+    int64_t t0 = esp_timer_get_time();
+    if (connect(s, res->ai_addr, res->ai_addrlen) == 0) {
+        r->status = 0;
+        r->ok = true;
+    } else if (errno == EINPROGRESS) {
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(s, &wfds);
+        struct timeval tv = { .tv_sec = g_cfg.timeout_ms / 1000, .tv_usec = (g_cfg.timeout_ms % 1000) * 1000 };
+        if (select(s + 1, NULL, &wfds, NULL, &tv) > 0) {
+            int so_err = 0;
+            socklen_t so_len = sizeof(so_err);
+            getsockopt(s, SOL_SOCKET, SO_ERROR, &so_err, &so_len);
+            r->status = so_err;
+            r->ok = so_err == 0;
+        } else {
+            r->status = ETIMEDOUT;
+        }
+    } else {
+        r->status = errno;
+    }
+    if (r->ok) r->rtt_ms = elapsed_ms(t0);
+    close(s);
+    freeaddrinfo(res);
+}
+
+static void probe_worker_task(void *arg) {
+    connectivity_probe_t p = (connectivity_probe_t)(intptr_t)arg;
+    for (;;) {
+        xEventGroupWaitBits(g_bits, GO_BIT(p), pdTRUE, pdTRUE, portMAX_DELAY);
+        connectivity_probe_result_t r = { .probe = p, .ran = true, .status = -1, .rtt_ms = -1 };
+        switch (p) {
+            case CONN_PROBE_HTTP: probe_http(&r); break;
+            case CONN_PROBE_DNS:  probe_dns(&r);  break;
+            case CONN_PROBE_TCP:  probe_tcp(&r);  break;
+            default: break;
+        }
+        g_pending[p] = r;
+        g_busy[p] = false;
+        xEventGroupSetBits(g_bits, DONE_BIT(p));
+    }
+}
+
+// Ronda ----------------------------------------------------------------------
+
+static void update_stats(const connectivity_probe_result_t *r) {
+    connectivity_probe_stats_t *st = &g_stats[r->probe];
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    st->last_us = esp_timer_get_time();
+    st->last_rtt_ms = r->rtt_ms;
+    if (r->ok) {
+        st->ok++;
+        if (st->min_rtt_ms < 0 || r->rtt_ms < st->min_rtt_ms) st->min_rtt_ms = r->rtt_ms;
+        if (r->rtt_ms > st->max_rtt_ms) st->max_rtt_ms = r->rtt_ms;
+        st->avg_rtt_ms = st->ok == 1 ? r->rtt_ms : st->avg_rtt_ms + (r->rtt_ms - st->avg_rtt_ms) / 8;
+    } else {
+        st->failed++;
+    }
+    xSemaphoreGive(g_lock);
+}
+
+// HTTP manda: 204 es internet, otra respuesta es portal. Si HTTP no llegó a
+// contestar (o no está activa), basta con alcanzar Firebase por TCP.
+static connectivity_verdict_t decide(const connectivity_result_t *res) {
+    const connectivity_probe_result_t *http = &res->probes[CONN_PROBE_HTTP];
+    const connectivity_probe_result_t *dns = &res->probes[CONN_PROBE_DNS];
+    const connectivity_probe_result_t *tcp = &res->probes[CONN_PROBE_TCP];
+    if (http->ran && http->ok) return CONNECTIVITY_ONLINE;
+    if (http->ran && http->status > 0) return CONNECTIVITY_PORTAL;
+    if (tcp->ran) return tcp->ok ? CONNECTIVITY_ONLINE : CONNECTIVITY_OFFLINE;
+    if (http->ran) return CONNECTIVITY_OFFLINE;
+    if (dns->ran) return dns->ok ? CONNECTIVITY_ONLINE : CONNECTIVITY_OFFLINE;
+    return g_verdict;  // todas seguían ocupadas: no hay dato nuevo
+}
+
+static void run_round(void) {
+    connectivity_result_t res = { .round = ++g_round };
+    EventBits_t go = 0;
+    for (int p = 0; p < CONN_PROBE_COUNT; p++) {
+        res.probes[p] = (connectivity_probe_result_t){ .probe = p, .status = -1, .rtt_ms = -1 };
+        if (g_enabled[p] && !g_busy[p]) {
+            g_busy[p] = true;
+            go |= GO_BIT(p);
+        }
+    }
+    EventBits_t wait = go << 8;
+    EventBits_t done = 0;
+    if (go) {
+        xEventGroupClearBits(g_bits, wait);
+        xEventGroupSetBits(g_bits, go);
+        done = xEventGroupWaitBits(g_bits, wait, pdFALSE, pdTRUE, pdMS_TO_TICKS(g_cfg.timeout_ms + 500));
+        xEventGroupClearBits(g_bits, done & wait);
+    }
+    for (int p = 0; p < CONN_PROBE_COUNT; p++) {
+        if (!(go & GO_BIT(p))) continue;
+        if (done & DONE_BIT(p)) {
+            res.probes[p] = g_pending[p];
+        } else {
+            res.probes[p].ran = true;  // colgada: cuenta como fallo, sigue ocupada
+            res.probes[p].status = ETIMEDOUT;
+        }
+        update_stats(&res.probes[p]);
+    }
+
+    connectivity_verdict_t prev = g_verdict;
+    res.verdict = decide(&res);
+    res.changed = res.verdict != prev;
+    g_verdict = res.verdict;
+
+    // Mientras hay internet estable se espacia; sin él, o tras un cambio, se
+    // vuelve al mínimo para detectar cuanto antes el login en el portal
+    if (res.verdict == CONNECTIVITY_ONLINE && !res.changed) {
+        g_interval_ms *= 2;
+        if (g_interval_ms > g_cfg.interval_max_ms) g_interval_ms = g_cfg.interval_max_ms;
+    } else {
+        g_interval_ms = g_cfg.interval_min_ms;
+    }
+    res.next_interval_ms = g_running ? g_interval_ms : -1;
+
+    char line[160];
+    const connectivity_probe_result_t *h = &res.probes[CONN_PROBE_HTTP];
+    const connectivity_probe_result_t *d = &res.probes[CONN_PROBE_DNS];
+    const connectivity_probe_result_t *t = &res.probes[CONN_PROBE_TCP];
+    snprintf(line, sizeof(line), "ronda %u: %s http=%d/%dms dns=%d/%dms tcp=%d/%dms próxima=%dms",
+             (unsigned)res.round, connectivity_verdict_str(res.verdict),
+             h->status, h->rtt_ms, d->status, d->rtt_ms, t->status, t->rtt_ms,
+             res.next_interval_ms);
+    if (res.changed) {
+        ESP_LOGI(TAG, "%s", line);
+    } else {
+        ESP_LOGD(TAG, "%s", line);
+    }
+
+    esp_event_post(CONNECTIVITY_EVENT, CONNECTIVITY_EVENT_RESULT, &res, sizeof(res), pdMS_TO_TICKS(100));
+    if (res.changed) {
+        esp_event_post(CONNECTIVITY_EVENT, CONNECTIVITY_EVENT_CHANGED, &res, sizeof(res), pdMS_TO_TICKS(100));
+    }
+}
+
+static void prober_task(void *arg) {
+    int wait_ms = -1;  // -1: detenido, solo espera órdenes
+    for (;;) {
+        uint32_t cmd = 0;
+        TickType_t ticks = wait_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
+        if (xTaskNotifyWait(0, UINT32_MAX, &cmd, ticks) == pdTRUE) {
+            if (cmd & (CMD_START | CMD_STOP)) {
+                g_interval_ms = g_cfg.interval_min_ms;
+                wait_ms = g_running ? g_first_delay_ms : -1;
+            }
+            if (cmd & CMD_NOW) {
+                g_interval_ms = g_cfg.interval_min_ms;
+            } else if (wait_ms != 0) {
+                continue;
+            }
+        }
+        run_round();
+        wait_ms = g_running ? g_interval_ms : -1;
+    }
+}
+
+// API ------------------------------------------------------------------------
+
+esp_err_t connectivity_init(const connectivity_cfg_t *cfg) {
+    if (!cfg) return ESP_ERR_INVALID_ARG;
+    if (g_prober) return ESP_ERR_INVALID_STATE;
+    g_cfg = *cfg;
+    if (g_cfg.timeout_ms < 500) g_cfg.timeout_ms = 500;
+    if (g_cfg.interval_min_ms < 1000) g_cfg.interval_min_ms = 1000;
+    if (g_cfg.interval_max_ms < g_cfg.interval_min_ms) g_cfg.interval_max_ms = g_cfg.interval_min_ms;
+    g_interval_ms = g_cfg.interval_min_ms;
+
+    if (g_cfg.host && g_cfg.host[0]) parse_host(g_cfg.host);
+    g_enabled[CONN_PROBE_HTTP] = g_cfg.http_url && g_cfg.http_url[0];
+    g_enabled[CONN_PROBE_DNS] = g_host[0] && g_cfg.netif;
+    g_enabled[CONN_PROBE_TCP] = g_host[0] != 0;
+    for (int p = 0; p < CONN_PROBE_COUNT; p++) {
+        g_stats[p] = (connectivity_probe_stats_t){ .last_rtt_ms = -1, .min_rtt_ms = -1, .last_us = -1 };
+    }
+
+    g_lock = xSemaphoreCreateMutex();
+    g_bits = xEventGroupCreate();
+    if (!g_lock || !g_bits) return ESP_ERR_NO_MEM;
+
+    static const struct { const char *name; uint32_t stack; } workers[CONN_PROBE_COUNT] = {
+        [CONN_PROBE_HTTP] = { "conn_http", 4096 },
+        [CONN_PROBE_DNS]  = { "conn_dns",  2560 },
+        [CONN_PROBE_TCP]  = { "conn_tcp",  3072 },
+    };
+    for (int p = 0; p < CONN_PROBE_COUNT; p++) {
+        if (!g_enabled[p]) continue;
+        if (xTaskCreate(probe_worker_task, workers[p].name, workers[p].stack, (void *)(intptr_t)p, 5, NULL) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (xTaskCreate(prober_task, "conn_probe", 3072, NULL, 5, &g_prober) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "sondas: http=%d dns=%d tcp=%d host=%s:%d intervalo %d-%d ms",
+             g_enabled[CONN_PROBE_HTTP], g_enabled[CONN_PROBE_DNS], g_enabled[CONN_PROBE_TCP],
+             g_host[0] ? g_host : "-", g_port, g_cfg.interval_min_ms, g_cfg.interval_max_ms);
+    return ESP_OK;
+}
+
+void connectivity_start(int first_delay_ms) {
+    if (!g_prober) return;
+    g_first_delay_ms = first_delay_ms > 0 ? first_delay_ms : 0;
+    g_running = true;
+    xTaskNotify(g_prober, CMD_START, eSetBits);
+}
+
+void connectivity_stop(void) {
+    if (!g_prober) return;
+    g_running = false;
+    xTaskNotify(g_prober, CMD_STOP, eSetBits);
+}
+
+void connectivity_check_now(void) {
+    if (g_prober) xTaskNotify(g_prober, CMD_NOW, eSetBits);
+}
+
+connectivity_verdict_t connectivity_get_verdict(void) {
+    return g_verdict;
+}
+
+bool connectivity_get_stats(connectivity_probe_t probe, connectivity_probe_stats_t *out) {
+    if ((int)probe < 0 || (int)probe >= CONN_PROBE_COUNT || !out || !g_lock) return false;
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    *out = g_stats[probe];
+    xSemaphoreGive(g_lock);
+    return true;
+}
@@ -0,0 +1,159 @@
+#include "wifi_scan.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "wifi_scan";
+
+static wifi_scan_entry_t *g_table = NULL;  // ordenada por RSSI descendente
+static int g_count = 0;
+static int g_max = 0;
+static int64_t g_updated_us = -1;
+static bool g_scanning = false;
+static SemaphoreHandle_t g_lock = NULL;
+
+// Inserta o mejora la entrada del SSID; con la tabla llena reemplaza la más débil
+static void table_add(wifi_scan_entry_t *t, int *count, const wifi_ap_record_t *ap) {
+    const char *ssid = (const char *)ap->ssid;
+    if (ssid[0] == 0) return; // ocultas: no se pueden elegir en el portal
+    int slot = -1;
+    for (int i = 0; i < *count; i++) {
+        if (strcmp(t[i].ssid, ssid) == 0) {
+            if (ap->rssi <= t[i].rssi) return;
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        if (*count < g_max) {
+            slot = (*count)++;
+        } else {
+            int weakest = 0;
+            for (int i = 1; i < *count; i++) {
+                if (t[i].rssi < t[weakest].rssi) weakest = i;
+            }
+            if (ap->rssi <= t[weakest].rssi) return;
+            slot = weakest;
+        }
+    }
+    wifi_scan_entry_t *e = &t[slot];
+    snprintf(e->ssid, sizeof(e->ssid), "%s", ssid);
+    memcpy(e->bssid, ap->bssid, sizeof(e->bssid));
+    e->channel = ap->primary;
+    e->rssi = ap->rssi;
+    e->authmode = ap->authmode;
+}
+
+static void table_sort(wifi_scan_entry_t *t, int count) {
+    for (int i = 1; i < count; i++) {
+        wifi_scan_entry_t e = t[i];
+        int j = i - 1;
+        while (j >= 0 && t[j].rssi < e.rssi) {
+            t[j + 1] = t[j];
+            j--;
+        }
+        t[j + 1] = e;
+    }
+}
+
+static void on_scan_done(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    const wifi_event_sta_scan_done_t *done = (const wifi_event_sta_scan_done_t *)data;
+    // Se arma fuera del lock y se publica de una vez
+    wifi_scan_entry_t *fresh = calloc(g_max, sizeof(wifi_scan_entry_t));
+    int count = 0;
+    wifi_ap_record_t ap;
+    while (esp_wifi_scan_get_ap_record(&ap) == ESP_OK) {
+        if (fresh) table_add(fresh, &count, &ap);
+    }
+    esp_wifi_clear_ap_list(); // libera la lista del driver aunque no se haya leído toda
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    g_scanning = false;
+    if (fresh && done && done->status == 0) {
+        table_sort(fresh, count);
+        memcpy(g_table, fresh, count * sizeof(wifi_scan_entry_t));
+        g_count = count;
+        g_updated_us = esp_timer_get_time();
+    }
+    xSemaphoreGive(g_lock);
+    if (!fresh) ESP_LOGE(TAG, "OOM al procesar escaneo");
+    else ESP_LOGI(TAG, "Escaneo listo: %d redes (status=%d)", count, done ? (int)done->status : -1);
+    free(fresh);
+}
+
+esp_err_t wifi_scan_init(int max_aps) {
+    if (g_table) return ESP_OK;
+    if (max_aps <= 0) return ESP_ERR_INVALID_ARG;
+    g_lock = xSemaphoreCreateMutex();
+    g_table = calloc(max_aps, sizeof(wifi_scan_entry_t));
+    if (!g_lock || !g_table) return ESP_ERR_NO_MEM;
+    g_max = max_aps;
+    return esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &on_scan_done, NULL);
+}
+
+esp_err_t wifi_scan_request(void) {
+    if (!g_table) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    bool busy = g_scanning;
+    g_scanning = true;
+    xSemaphoreGive(g_lock);
+    if (busy) return ESP_OK;
+
+    // En modo AP no se puede escanear; APSTA se deja puesto para no alternar
+    wifi_mode_t mode;
+    if (esp_wifi_get_mode(&mode) == ESP_OK) {
+        if (mode == WIFI_MODE_AP) esp_wifi_set_mode(WIFI_MODE_APSTA);
+        else if (mode == WIFI_MODE_NULL) esp_wifi_set_mode(WIFI_MODE_STA);
+    }
+    wifi_scan_config_t sc = {
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time = { .active = { .min = 50, .max = 120 } },
+    };
+    esp_err_t err = esp_wifi_scan_start(&sc, false);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo iniciar escaneo: %s", esp_err_to_name(err));
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+        g_scanning = false;
+        xSemaphoreGive(g_lock);
+    }
+    return err;
+}
+
+bool wifi_scan_in_progress(void) {
+    return g_scanning;
+}
+
+int wifi_scan_get(wifi_scan_entry_t *out, int first, int max, int64_t *updated_us) {
+    if (!g_table) {
+        if (updated_us) *updated_us = -1;
+        return 0;
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    int n = 0;
+    if (first >= 0 && first < g_count) {
+        n = g_count - first < max ? g_count - first : max;
+        if (out) memcpy(out, g_table + first, n * sizeof(wifi_scan_entry_t));
+    }
+    if (updated_us) *updated_us = g_updated_us;
+    xSemaphoreGive(g_lock);
+    return n;
+}
+
+bool wifi_scan_find(const char *ssid, wifi_scan_entry_t *out) {
+    if (!g_table || !ssid) return false;
+    bool found = false;
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (int i = 0; i < g_count && !found; i++) {
+        if (strcmp(g_table[i].ssid, ssid) == 0) {
+            if (out) *out = g_table[i];
+            found = true;
+        }
+    }
+    xSemaphoreGive(g_lock);
+    return found;
+}
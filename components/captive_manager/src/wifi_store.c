@@ -1,59 +1,297 @@
 #include "wifi_store.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define WIFI_STORE_NS   "wifi_cfg"
-#define WIFI_KEY_SSID   "ssid"
+#define WIFI_KEY_SSID   "ssid"      // formato anterior: una sola red
 #define WIFI_KEY_PASS   "pass"
+#define WIFI_KEY_NETS   "nets"      // blob: wifi_store_net_t[count]
+#define WIFI_KEY_LINK   "link"
+
+static const char *TAG = "wifi_store";
+
+// Copia en RAM de la lista; la comparten el event loop y los handlers HTTP
+static wifi_store_net_t s_nets[WIFI_STORE_MAX_NETWORKS];
+static int s_count = 0;
+static SemaphoreHandle_t s_lock = NULL;
 
 static esp_err_t ensure_nvs_open(nvs_handle_t *h, nvs_open_mode mode) {
     return nvs_open(WIFI_STORE_NS, mode, h);
 }
 
-bool wifi_store_has_credentials(void) {
+// Llamar con s_lock tomado
+static esp_err_t nets_commit(void) {
     nvs_handle_t h;
-    if (ensure_nvs_open(&h, NVS_READONLY) != ESP_OK) return false;
-    size_t len=0;
-    esp_err_t err = nvs_get_str(h, WIFI_KEY_SSID, NULL, &len);
+    esp_err_t err = ensure_nvs_open(&h, NVS_READWRITE);
+    if (err != ESP_OK) return err;
+    if (s_count > 0) {
+        err = nvs_set_blob(h, WIFI_KEY_NETS, s_nets, s_count * sizeof(wifi_store_net_t));
+    } else {
+        nvs_erase_key(h, WIFI_KEY_NETS);
+    }
+    if (err == ESP_OK) err = nvs_commit(h);
     nvs_close(h);
-    return err == ESP_OK && len > 0;
+    if (err != ESP_OK) ESP_LOGE(TAG, "No se pudo guardar la lista de redes: %s", esp_err_to_name(err));
+    return err;
+}
+
+static int nets_find(const char *ssid) {
+    for (int i = 0; i < s_count; i++) {
+        if (strcmp(s_nets[i].ssid, ssid) == 0) return i;
+    }
+    return -1;
+}
+
+// true si a es peor candidata a quedarse en la lista que b
+static bool nets_worse(const wifi_store_net_t *a, const wifi_store_net_t *b) {
+    if (a->priority != b->priority) return a->priority < b->priority;
+    if (a->failures != b->failures) return a->failures > b->failures;
+    return a->last_ok < b->last_ok;
+}
+
+static uint32_t nets_last_ok_max(void) {
+    uint32_t m = 0;
+    for (int i = 0; i < s_count; i++) {
+        if (s_nets[i].last_ok > m) m = s_nets[i].last_ok;
+    }
+    return m;
+}
+
+esp_err_t wifi_store_init(void) {
+    if (s_lock) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    nvs_handle_t h;
+    esp_err_t err = ensure_nvs_open(&h, NVS_READWRITE);
+    if (err != ESP_OK) return err;
+    size_t len = sizeof(s_nets);
+    err = nvs_get_blob(h, WIFI_KEY_NETS, s_nets, &len);
+    if (err == ESP_OK && len % sizeof(wifi_store_net_t) == 0) {
+        s_count = len / sizeof(wifi_store_net_t);
+    } else if (err == ESP_ERR_NVS_INVALID_LENGTH) {
+        // Guardada con más capacidad que la actual: se quedan las primeras
+        size_t full = 0;
+        nvs_get_blob(h, WIFI_KEY_NETS, NULL, &full);
+        void *tmp = malloc(full);
+        if (tmp && nvs_get_blob(h, WIFI_KEY_NETS, tmp, &full) == ESP_OK) {
+            memcpy(s_nets, tmp, sizeof(s_nets));
+            s_count = WIFI_STORE_MAX_NETWORKS;
+            ESP_LOGW(TAG, "Lista recortada a %d redes", s_count);
+        }
+        free(tmp);
+    } else {
+        s_count = 0;
+    }
+
+    // Migración: una sola red en ssid/pass pasa a ser la primera de la lista
+    char ssid[33] = {0};
+    size_t l1 = sizeof(ssid);
+    if (nvs_get_str(h, WIFI_KEY_SSID, ssid, &l1) == ESP_OK && ssid[0]) {
+        char pass[65] = {0};
+        size_t l2 = sizeof(pass);
+        nvs_get_str(h, WIFI_KEY_PASS, pass, &l2);
+        if (s_count < WIFI_STORE_MAX_NETWORKS && nets_find(ssid) < 0) {
+            wifi_store_net_t *n = &s_nets[s_count++];
+            memset(n, 0, sizeof(*n));
+            snprintf(n->ssid, sizeof(n->ssid), "%s", ssid);
+            snprintf(n->pass, sizeof(n->pass), "%s", pass);
+            n->last_ok = 1; // era la red en uso: el enlace guardado es suyo
+        }
+        nvs_erase_key(h, WIFI_KEY_SSID);
+        nvs_erase_key(h, WIFI_KEY_PASS);
+        nvs_erase_key(h, WIFI_KEY_LINK); // sin ssid: se rehace al conectar
+        nvs_commit(h);
+        nvs_close(h);
+        ESP_LOGI(TAG, "Migrada la red guardada %s a la lista", ssid);
+        return nets_commit();
+    }
+    nvs_close(h);
+    ESP_LOGI(TAG, "%d redes guardadas", s_count);
+    return ESP_OK;
+}
+
+bool wifi_store_has_credentials(void) {
+    return wifi_store_count() > 0;
+}
+
+int wifi_store_count(void) {
+    if (!s_lock) return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int n = s_count;
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+esp_err_t wifi_store_get(int index, wifi_store_net_t *out) {
+    if (!out) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (index >= 0 && index < s_count) {
+        *out = s_nets[index];
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t wifi_store_add(const char *ssid, const char *pass, int priority) {
+    if (!ssid || !ssid[0] || strlen(ssid) > 32 || (pass && strlen(pass) > 64)) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = nets_find(ssid);
+    if (i < 0) {
+        if (s_count < WIFI_STORE_MAX_NETWORKS) {
+            i = s_count++;
+        } else {
+            i = 0;
+            for (int k = 1; k < s_count; k++) {
+                if (nets_worse(&s_nets[k], &s_nets[i])) i = k;
+            }
+            ESP_LOGW(TAG, "Lista llena: %s reemplaza a %s", ssid, s_nets[i].ssid);
+        }
+        memset(&s_nets[i], 0, sizeof(s_nets[i]));
+        snprintf(s_nets[i].ssid, sizeof(s_nets[i].ssid), "%s", ssid);
+    }
+    wifi_store_net_t *n = &s_nets[i];
+    snprintf(n->pass, sizeof(n->pass), "%s", pass ? pass : "");
+    if (priority >= 0) n->priority = priority > 255 ? 255 : (uint8_t)priority;
+    n->failures = 0;
+    esp_err_t err = nets_commit();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t wifi_store_remove(const char *ssid) {
+    if (!ssid) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = nets_find(ssid);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (i >= 0) {
+        memmove(&s_nets[i], &s_nets[i + 1], (s_count - i - 1) * sizeof(s_nets[0]));
+        s_count--;
+        err = nets_commit();
+    }
+    xSemaphoreGive(s_lock);
+    if (err == ESP_OK) {
+        wifi_store_link_t link;
+        if (wifi_store_load_link(&link) == ESP_OK && strcmp(link.ssid, ssid) == 0) wifi_store_clear_link();
+    }
+    return err;
+}
+
+esp_err_t wifi_store_mark(const char *ssid, bool ok) {
+    if (!ssid) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = nets_find(ssid);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (i >= 0) {
+        wifi_store_net_t *n = &s_nets[i];
+        uint32_t newest = nets_last_ok_max();
+        bool changed = false;
+        if (ok) {
+            // Ya era la más reciente y sin fallos: nada que escribir
+            changed = n->failures != 0 || n->last_ok != newest || newest == 0;
+            n->failures = 0;
+            if (n->last_ok != newest || newest == 0) n->last_ok = newest + 1;
+        } else if (n->failures < 255) {
+            n->failures++;
+            changed = true;
+        }
+        err = changed ? nets_commit() : ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
 }
 
 esp_err_t wifi_store_load(char *ssid, size_t ssid_len, char *pass, size_t pass_len) {
     if (!ssid || !pass) return ESP_ERR_INVALID_ARG;
     ssid[0]=0; pass[0]=0;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int best = -1;
+    for (int i = 0; i < s_count; i++) {
+        if (best < 0 || s_nets[i].priority > s_nets[best].priority ||
+            (s_nets[i].priority == s_nets[best].priority && s_nets[i].last_ok > s_nets[best].last_ok)) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        snprintf(ssid, ssid_len, "%s", s_nets[best].ssid);
+        snprintf(pass, pass_len, "%s", s_nets[best].pass);
+    }
+    xSemaphoreGive(s_lock);
+    return best >= 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t wifi_store_save(const char *ssid, const char *pass) {
+    return wifi_store_add(ssid, pass, -1);
+}
+
+esp_err_t wifi_store_clear(void) {
+    if (s_lock) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_count = 0;
+        xSemaphoreGive(s_lock);
+    }
+    nvs_handle_t h;
+    esp_err_t err = ensure_nvs_open(&h, NVS_READWRITE);
+    if (err != ESP_OK) return err;
+    nvs_erase_key(h, WIFI_KEY_NETS);
+    nvs_erase_key(h, WIFI_KEY_SSID);
+    nvs_erase_key(h, WIFI_KEY_PASS);
+    nvs_erase_key(h, WIFI_KEY_LINK);
+    err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+esp_err_t wifi_store_load_link(wifi_store_link_t *link) {
+    if (!link) return ESP_ERR_INVALID_ARG;
+    memset(link, 0, sizeof(*link));
     nvs_handle_t h;
     esp_err_t err = ensure_nvs_open(&h, NVS_READONLY);
     if (err != ESP_OK) return err;
-    size_t l1 = ssid_len;
-    err = nvs_get_str(h, WIFI_KEY_SSID, ssid, &l1);
-    if (err != ESP_OK) { nvs_close(h); return err; }
-    size_t l2 = pass_len;
-    err = nvs_get_str(h, WIFI_KEY_PASS, pass, &l2);
-    if (err == ESP_ERR_NVS_NOT_FOUND) { pass[0]=0; err = ESP_OK; }
+    size_t len = sizeof(*link);
+    err = nvs_get_blob(h, WIFI_KEY_LINK, link, &len);
     nvs_close(h);
+    if (err == ESP_OK && (len != sizeof(*link) || link->channel == 0)) {
+        // Formato viejo o vacío: tratar como inexistente
+        memset(link, 0, sizeof(*link));
+        err = ESP_ERR_NVS_NOT_FOUND;
+    }
     return err;
 }
 
-esp_err_t wifi_store_save(const char *ssid, const char *pass) {
-    if (!ssid) return ESP_ERR_INVALID_ARG;
+esp_err_t wifi_store_save_link(const wifi_store_link_t *link) {
+    if (!link) return ESP_ERR_INVALID_ARG;
+    wifi_store_link_t old;
+    if (wifi_store_load_link(&old) == ESP_OK && memcmp(&old, link, sizeof(old)) == 0) {
+        return ESP_OK; // sin cambios: no gastar flash
+    }
     nvs_handle_t h;
     esp_err_t err = ensure_nvs_open(&h, NVS_READWRITE);
     if (err != ESP_OK) return err;
-    ESP_ERROR_CHECK(nvs_set_str(h, WIFI_KEY_SSID, ssid));
-    ESP_ERROR_CHECK(nvs_set_str(h, WIFI_KEY_PASS, pass?pass:""));
-    err = nvs_commit(h);
+    err = nvs_set_blob(h, WIFI_KEY_LINK, link, sizeof(*link));
+    if (err == ESP_OK) err = nvs_commit(h);
     nvs_close(h);
     return err;
 }
 
-esp_err_t wifi_store_clear(void) {
+esp_err_t wifi_store_clear_link(void) {
     nvs_handle_t h;
     esp_err_t err = ensure_nvs_open(&h, NVS_READWRITE);
     if (err != ESP_OK) return err;
-    nvs_erase_key(h, WIFI_KEY_SSID);
-    nvs_erase_key(h, WIFI_KEY_PASS);
+    nvs_erase_key(h, WIFI_KEY_LINK);
     err = nvs_commit(h);
     nvs_close(h);
     return err;
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Minifica y comprime con gzip un recurso del portal para embeberlo en el firmware.
+
+Uso: pack_web.py <entrada> <salida.gz>
+
+La minificación es conservadora (no hay node en el entorno de ESP-IDF):
+quita comentarios HTML, comentarios CSS y líneas de comentario // de JS,
+recorta cada línea y, dentro de <style> y <script>, elimina espacios junto
+a signos de puntuación fuera de las cadenas. El JS debe terminar las
+sentencias con ';' (las líneas se unen).
+"""
+import gzip
+import re
+import sys
+
+PUNCT = set('{}()[];,:=<>+-*/?&|!')
+
+
+def squeeze_code(code):
+    out = []
+    quote = None
+    pending_space = False
+    for ch in code:
+        if quote:
+            out.append(ch)
+            if ch == quote and out[-2:-1] != ['\\']:
+                quote = None
+            continue
+        if ch.isspace():
+            pending_space = True
+            continue
+        if pending_space and out and out[-1] not in PUNCT and ch not in PUNCT:
+            out.append(' ')
+        pending_space = False
+        out.append(ch)
+        if ch in '\'"`':
+            quote = ch
+    return ''.join(out)
+
+
+def strip_js_comments(code):
+    return '\n'.join(l for l in code.split('\n') if not l.strip().startswith('//'))
+
+
+def minify_html(text):
+    text = re.sub(r'<!--.*?-->', '', text, flags=re.S)
+
+    def style(m):
+        css = re.sub(r'/\*.*?\*/', '', m.group(2), flags=re.S)
+        return m.group(1) + squeeze_code(css) + m.group(3)
+
+    def script(m):
+        return m.group(1) + squeeze_code(strip_js_comments(m.group(2))) + m.group(3)
+
+    # Marcado: líneas recortadas y unidas
+    parts = re.split(r'(<style>.*?</style>|<script>.*?</script>)', text, flags=re.S)
+    out = []
+    for part in parts:
+        if part.startswith('<style>'):
+            out.append(re.sub(r'(<style>)(.*?)(</style>)', style, part, flags=re.S))
+        elif part.startswith('<script>'):
+            out.append(re.sub(r'(<script>)(.*?)(</script>)', script, part, flags=re.S))
+        else:
+            out.append(''.join(l.strip() for l in part.split('\n')))
+    return ''.join(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    src, dst = sys.argv[1], sys.argv[2]
+    with open(src, encoding='utf-8') as f:
+        raw = f.read()
+    mini = minify_html(raw).encode('utf-8') if src.endswith('.html') else raw.encode('utf-8')
+    # mtime=0: salida reproducible (y el ETag estable entre compilaciones)
+    packed = gzip.compress(mini, compresslevel=9, mtime=0)
+    with open(dst, 'wb') as f:
+        f.write(packed)
+    size = len(raw.encode('utf-8'))
+    print('pack_web: %s %d B -> minificado %d B -> gzip %d B (%d B menos, -%d%%)' % (
+        src.split('/')[-1], size, len(mini), len(packed), size - len(packed),
+        100 * (size - len(packed)) // size))
+
+
+if __name__ == '__main__':
+    main()
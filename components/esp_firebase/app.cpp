@@ -1,12 +1,12 @@
 
-#include <iostream>
-
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
 #include "esp_tls.h"
 #include "esp_crt_bundle.h"
+#include "esp_timer.h"
+#include "metrics.h"
 
 #include "app.h"
 
@@ -23,11 +23,107 @@
 #define HTTP_TAG "HTTP_CLIENT"
 #define FIREBASE_APP_TAG "FirebaseApp"
 
+namespace {
+
+// Cuerpos y respuestas de Identity Toolkit / Secure Token, enlazados con
+// Json::writeFields/readFields: sin árbol Value y con escape correcto
+struct AccountRequest {
+    const char* email;
+    const char* password;
+    bool returnSecureToken;
+};
+const Json::FieldBinding<AccountRequest> kAccountRequestFields[] = {
+    JSONCPP_BIND(AccountRequest, email, "email"),
+    JSONCPP_BIND(AccountRequest, password, "password"),
+    JSONCPP_BIND(AccountRequest, returnSecureToken, "returnSecureToken"),
+};
+
+struct AccountResponse {
+    Json::String refreshToken;
+};
+const Json::FieldBinding<AccountResponse> kAccountResponseFields[] = {
+    JSONCPP_BIND(AccountResponse, refreshToken, "refreshToken"),
+};
+
+struct TokenRequest {
+    const char* grant_type;
+    const char* refresh_token;
+};
+const Json::FieldBinding<TokenRequest> kTokenRequestFields[] = {
+    JSONCPP_BIND(TokenRequest, grant_type, "grant_type"),
+    JSONCPP_BIND(TokenRequest, refresh_token, "refresh_token"),
+};
+
+struct TokenResponse {
+    Json::String access_token;
+    Json::String expires_in; // llega como string en segundos
+    Json::String expiresIn;  // por si cambia el campo
+};
+// Posiciones en kTokenResponseFields y en el arreglo found de readFields()
+enum TokenResponseField {
+    kTokenAccessToken,
+    kTokenExpiresIn,
+    kTokenExpiresInCamel,
+    kTokenResponseFieldCount
+};
+constexpr Json::FieldBinding<TokenResponse> kTokenResponseFields[] = {
+    JSONCPP_BIND(TokenResponse, access_token, "access_token"),
+    JSONCPP_BIND(TokenResponse, expires_in, "expires_in"),
+    JSONCPP_BIND(TokenResponse, expiresIn, "expiresIn"),
+};
+// Si se reordena la tabla sin el enum, no compila
+static_assert(sizeof(kTokenResponseFields) / sizeof(kTokenResponseFields[0]) == kTokenResponseFieldCount,
+              "kTokenResponseFields y TokenResponseField no coinciden");
+static_assert(kTokenResponseFields[kTokenAccessToken].address ==
+                  &Json::boundMember<TokenResponse, Json::String, &TokenResponse::access_token> &&
+              kTokenResponseFields[kTokenExpiresIn].address ==
+                  &Json::boundMember<TokenResponse, Json::String, &TokenResponse::expires_in> &&
+              kTokenResponseFields[kTokenExpiresInCamel].address ==
+                  &Json::boundMember<TokenResponse, Json::String, &TokenResponse::expiresIn>,
+              "kTokenResponseFields y TokenResponseField no coinciden");
+
+template <class T, size_t N>
+std::string toJson(const T& object, const Json::FieldBinding<T> (&fields)[N])
+{
+    // Primera pasada solo mide; la segunda escribe en el string ya dimensionado
+    std::string body(Json::writeFields(object, fields, nullptr, 0), '\0');
+    Json::writeFields(object, fields, &body[0], body.size() + 1);
+    return body;
+}
+
+} // namespace
+
 // Prefer ESP-IDF certificate bundle over embedded certs
 
 
 
 static int output_len = 0; 
+
+// /metrics: duración de cada intento por método, reintentos y conexiones TLS
+// (con keep-alive apagado cada intento hace su handshake)
+static const uint32_t HTTP_BOUNDS_US[] = {100000, 250000, 500000, 1000000, 2000000, 5000000, 10000000, 20000000};
+static metric_t* http_latency[HTTP_METHOD_MAX] = {};
+static metric_t* http_retries = nullptr;
+static metric_t* tls_handshakes = nullptr;
+
+static void register_http_metrics(void)
+{
+    static const struct { esp_http_client_method_t method; const char* labels; } methods[] = {
+        {HTTP_METHOD_GET, "method=\"GET\""},
+        {HTTP_METHOD_POST, "method=\"POST\""},
+        {HTTP_METHOD_PUT, "method=\"PUT\""},
+        {HTTP_METHOD_PATCH, "method=\"PATCH\""},
+        {HTTP_METHOD_DELETE, "method=\"DELETE\""},
+    };
+    for (const auto& m : methods) {
+        http_latency[m.method] = metrics_histogram("firebase_http_request_seconds",
+                                                   "Duración de cada intento HTTPS a Firebase", m.labels,
+                                                   HTTP_BOUNDS_US, sizeof(HTTP_BOUNDS_US) / sizeof(HTTP_BOUNDS_US[0]));
+    }
+    http_retries = metrics_counter("firebase_http_retries_total", "Reintentos de peticiones a Firebase", nullptr);
+    tls_handshakes = metrics_counter("firebase_tls_handshakes_total", "Conexiones TLS establecidas", nullptr);
+}
+
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
 
@@ -37,6 +133,7 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
             break;
         case HTTP_EVENT_ON_CONNECTED:
             ESP_LOGD(HTTP_TAG, "HTTP_EVENT_ON_CONNECTED");
+            metrics_inc(tls_handshakes);
             memset(evt->user_data, 0, HTTP_RECV_BUFFER_SIZE);
             output_len = 0;
             break;
@@ -78,6 +175,7 @@ namespace ESPFirebase {
 // TODO: protect this function from breaking 
 void FirebaseApp::firebaseClientInit(void)
 {   
+    register_http_metrics();
     esp_http_client_config_t config = {};
     config.url = "https://google.com";    // you have to set this as https link of some sort so that it can init properly, you cant leave it empty
     config.event_handler = http_event_handler;
@@ -104,13 +202,15 @@ esp_err_t FirebaseApp::setHeader(const char* header, const char* value)
 
 http_ret_t FirebaseApp::performRequest(const char* url,
                                        esp_http_client_method_t method,
-                                       std::string post_field)
+                                       const char* post_field,
+                                       size_t post_field_len)
 {
     const int MAX_ATTEMPTS = 5; // 1 intento + 1 reintento
     esp_err_t err = ESP_FAIL;
     int status_code = -1;
 
     for (int attempt = 1; attempt <= MAX_ATTEMPTS; ++attempt) {
+        if (attempt > 1) metrics_inc(http_retries);
         // Inicializa o reusa el cliente
         if (FirebaseApp::client == nullptr) {
             esp_http_client_config_t cfg = {};
@@ -132,8 +232,8 @@ http_ret_t FirebaseApp::performRequest(const char* url,
         // Métodos con body
         if (method == HTTP_METHOD_POST || method == HTTP_METHOD_PUT || method == HTTP_METHOD_PATCH) {
             if (esp_http_client_set_post_field(FirebaseApp::client,
-                                               post_field.c_str(),
-                                               post_field.length()) != ESP_OK) {
+                                               post_field,
+                                               (int)post_field_len) != ESP_OK) {
                 ESP_LOGE(FIREBASE_APP_TAG, "set_post_field fallo");
             }
             setHeader("content-type", "application/json");
@@ -143,7 +243,10 @@ http_ret_t FirebaseApp::performRequest(const char* url,
             esp_http_client_set_header(FirebaseApp::client, "Content-Length", "0");
         }
 
+        int64_t t0 = esp_timer_get_time();
         err = esp_http_client_perform(FirebaseApp::client);
+        metrics_observe_us(method < HTTP_METHOD_MAX ? http_latency[method] : nullptr,
+                           (uint32_t)(esp_timer_get_time() - t0));
         status_code = esp_http_client_get_status_code(FirebaseApp::client);
 
         // Aceptar cualquier 2xx como éxito (DELETE puede devolver 204)
@@ -153,8 +256,8 @@ http_ret_t FirebaseApp::performRequest(const char* url,
         }
 
         ESP_LOGE(FIREBASE_APP_TAG,
-                "request: url=%s\nmethod=%d\npost_field=%s",
-                url, method, post_field.c_str());
+                "request: url=%s\nmethod=%d\npost_field=%.*s",
+                url, method, (int)post_field_len, post_field);
         ESP_LOGE(FIREBASE_APP_TAG, "response=\n%s", local_response_buffer);
 
         // Reintento: asegurar headers/estado del body correctos
@@ -191,11 +294,10 @@ esp_err_t FirebaseApp::getRefreshToken(bool register_account)
 
     http_ret_t http_ret;
     
-    std::string account_json = R"({"email":")";
-    account_json += FirebaseApp::user_account.user_email; 
-    account_json += + R"(", "password":")"; 
-    account_json += FirebaseApp::user_account.user_password;
-    account_json += R"(", "returnSecureToken": true})"; 
+    const AccountRequest account = {FirebaseApp::user_account.user_email,
+                                    FirebaseApp::user_account.user_password,
+                                    true};
+    const std::string account_json = toJson(account, kAccountRequestFields);
 
     FirebaseApp::setHeader("content-type", "application/json");
     if (register_account)
@@ -210,12 +312,12 @@ esp_err_t FirebaseApp::getRefreshToken(bool register_account)
     if (http_ret.err == ESP_OK && http_ret.status_code == 200)
     {
         // std::cout << FirebaseApp::local_response_buffer << '\n';
+        // Solo interesa refreshToken: una pasada, sin construir el árbol completo
         const char* begin = FirebaseApp::local_response_buffer;
         const char* end = begin + strlen(FirebaseApp::local_response_buffer);
-        Json::Reader reader;
-        Json::Value data;
-        reader.parse(begin, end, data, false);
-        FirebaseApp::refresh_token = data["refreshToken"].asString();
+        AccountResponse response;
+        Json::readFields(begin, end, kAccountResponseFields, response);
+        FirebaseApp::refresh_token = response.refreshToken;
 
         ESP_LOGD(FIREBASE_APP_TAG, "Refresh Token=%s", FirebaseApp::refresh_token.c_str());
         return ESP_OK;
@@ -229,8 +331,8 @@ esp_err_t FirebaseApp::getAuthToken()
 {
     http_ret_t http_ret;
 
-    std::string token_post_data = R"({"grant_type": "refresh_token", "refresh_token":")";
-    token_post_data+= FirebaseApp::refresh_token + "\"}";
+    const TokenRequest request = {"refresh_token", FirebaseApp::refresh_token.c_str()};
+    const std::string token_post_data = toJson(request, kTokenRequestFields);
 
 
     FirebaseApp::setHeader("content-type", "application/json");
@@ -239,15 +341,14 @@ esp_err_t FirebaseApp::getAuthToken()
     {
         const char* begin = FirebaseApp::local_response_buffer;
         const char* end = begin + strlen(FirebaseApp::local_response_buffer);
-        Json::Reader reader;
-        Json::Value data;
-        reader.parse(begin, end, data, false);
-        FirebaseApp::auth_token = data["access_token"].asString();
-        // expires_in llega como string en segundos
-        if (data.isMember("expires_in")) {
-            FirebaseApp::auth_expires_in = atoi(data["expires_in"].asCString());
-        } else if (data.isMember("expiresIn")) { // por si cambia el campo
-            FirebaseApp::auth_expires_in = atoi(data["expiresIn"].asCString());
+        TokenResponse response;
+        bool found[kTokenResponseFieldCount];
+        Json::readFields(begin, end, kTokenResponseFields, response, found);
+        FirebaseApp::auth_token = response.access_token;
+        if (found[kTokenExpiresIn]) {
+            FirebaseApp::auth_expires_in = atoi(response.expires_in.c_str());
+        } else if (found[kTokenExpiresInCamel]) {
+            FirebaseApp::auth_expires_in = atoi(response.expiresIn.c_str());
         } else {
             FirebaseApp::auth_expires_in = 3600; // fallback 1h
         }
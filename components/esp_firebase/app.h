@@ -62,7 +62,12 @@ namespace ESPFirebase
              * @param post_field Optional post field. Used when method is POST
              * @return Returns struct http_ret_t: esp_err_t + http status code.
              */
-            http_ret_t performRequest(const char* url, esp_http_client_method_t method, std::string post_field = "");
+            http_ret_t performRequest(const char* url, esp_http_client_method_t method, const std::string& post_field = "")
+            {
+                return performRequest(url, method, post_field.data(), post_field.size());
+            }
+            // Igual que arriba, pero sin copiar el body: post_field debe vivir hasta que retorne
+            http_ret_t performRequest(const char* url, esp_http_client_method_t method, const char* post_field, size_t post_field_len);
             esp_err_t setHeader(const char* header, const char* value);
             
             void clearHTTPBuffer(void);
@@ -1,5 +1,6 @@
 #include "app.h"
 #include "rtdb.h"
+#include "firebase.h"
 #include <string>
 
 // Acceso a claves privadas centralizadas
@@ -9,11 +10,21 @@ using namespace ESPFirebase;
 
 static FirebaseApp* g_app = nullptr;
 static RTDB* g_rtdb = nullptr;
+static bool (*g_link_check)(void) = nullptr;
+
+static bool link_down() {
+	return g_link_check && !g_link_check();
+}
 
 extern "C" {
 
+void firebase_set_link_check(bool (*online)(void)) {
+	g_link_check = online;
+}
+
 int firebase_init(void) {
 	if (g_app) return 0;
+	if (link_down()) return FIREBASE_ERR_OFFLINE;
 	// Create Firebase app with API key
 	g_app = new FirebaseApp(API_KEY);
 
@@ -26,7 +37,12 @@ int firebase_init(void) {
 			err = g_app->loginUserAccount(g_app->user_account);
 		}
 	}
-	if (err != ESP_OK) return -2;
+	if (err != ESP_OK) {
+		// Sin sesión no queda nada a medias: el próximo firebase_init() reintenta desde cero
+		delete g_app;
+		g_app = nullptr;
+		return -2;
+	}
 
 	// Create RTDB client
 	g_rtdb = new RTDB(g_app, DATABASE_URL);
@@ -35,6 +51,7 @@ int firebase_init(void) {
 
 int firebase_refresh_token(void) {
 	if (!g_app) return -1;
+	if (link_down()) return FIREBASE_ERR_OFFLINE;
 	// Forzamos refresh usando el refresh_token almacenado;
 	// si falla, intenta login completo.
 	if (g_app->forceRefreshAuth() == ESP_OK) return 0;
@@ -43,6 +60,7 @@ int firebase_refresh_token(void) {
 
 int firebase_push(const char* path, const char* json) {
 	if (!g_rtdb) return -1;
+	if (link_down()) return FIREBASE_ERR_OFFLINE;
 	// RTDB::postData corresponds to push semantics
 	esp_err_t err = g_rtdb->postData(path, json);
 	return err == ESP_OK ? 0 : (int)err;
@@ -50,24 +68,28 @@ int firebase_push(const char* path, const char* json) {
 
 int firebase_putData(const char* path, const char* json) {
 	if (!g_rtdb) return -1;
+	if (link_down()) return FIREBASE_ERR_OFFLINE;
 	esp_err_t err = g_rtdb->putData(path, json);
 	return err == ESP_OK ? 0 : (int)err;
 }
 
 int firebase_delete(const char* path) {
 	if (!g_rtdb) return -1;
+	if (link_down()) return FIREBASE_ERR_OFFLINE;
 	esp_err_t err = g_rtdb->deleteData(path);
 	return err == ESP_OK ? 0 : (int)err;
 }
 
 int firebase_trim_days(const char* root_path, int max_days) {
     if (!g_rtdb) return -1;
+    if (link_down()) return FIREBASE_ERR_OFFLINE;
     esp_err_t err = g_rtdb->trimDays(root_path, max_days);
     return err == ESP_OK ? 0 : (int)err;
 }
 
 int firebase_trim_oldest_batch(const char* root_path, int batch_size) {
     if (!g_rtdb) return -1;
+    if (link_down()) return FIREBASE_ERR_OFFLINE;
     return g_rtdb->trimOldestBatch(root_path, batch_size);
 }
 
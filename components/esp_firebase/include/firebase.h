@@ -1,9 +1,17 @@
 #pragma once
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Devuelto por todas las llamadas mientras el enlace está caído (ver
+// firebase_set_link_check): fallan al momento en vez de agotar el timeout HTTPS
+#define FIREBASE_ERR_OFFLINE (-3)
+
+// online() se consulta antes de cada operación; NULL (por defecto) no comprueba
+void firebase_set_link_check(bool (*online)(void));
+
 int firebase_init(void);
 int firebase_auth(void);
 int firebase_refresh_token(void);
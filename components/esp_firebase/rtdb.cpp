@@ -1,6 +1,8 @@
-#include <iostream>
 #include <vector>
-#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <queue>
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -14,6 +16,31 @@
 
 namespace ESPFirebase {
 
+// Profundidad máxima aceptada en respuestas del RTDB. El parser ya no usa pila
+// por nivel, pero destruir un Json::Value muy anidado sigue siendo recursivo.
+static const size_t kMaxJsonDepth = Json::maxExtractDepth;
+
+static Json::Features rtdbFeatures()
+{
+    Json::Features features;
+    features.stackLimit_ = kMaxJsonDepth;
+    return features;
+}
+
+// Serializa directo a un buffer del tamaño exacto (measure + BufferSink),
+// sin std::string intermedio ni copia extra hacia performRequest
+static std::unique_ptr<char[]> serializeJson(const Json::Value& data)
+{
+    Json::FastWriter writer;
+    writer.omitEndingLineFeed();
+    const size_t len = writer.measure(data);
+    std::unique_ptr<char[]> body(new (std::nothrow) char[len + 1]);
+    if (!body) return nullptr;
+    Json::BufferSink sink(body.get(), len + 1);
+    writer.write(data, sink);
+    return body;
+}
+
 
 RTDB::RTDB(FirebaseApp* app, const char * database_url)
     : app(app), base_database_url(database_url)
@@ -21,7 +48,7 @@ RTDB::RTDB(FirebaseApp* app, const char * database_url)
 {
     
 }
-Json::Value RTDB::getData(const char* path)
+Json::Value RTDB::getData(const char* path, Json::KeyPool* keys)
 {
     
     std::string url = RTDB::base_database_url;
@@ -35,7 +62,8 @@ Json::Value RTDB::getData(const char* path)
         const char* begin = this->app->local_response_buffer;
         const char* end = begin + strlen(this->app->local_response_buffer);
 
-        Json::Reader reader;
+        Json::Reader reader(rtdbFeatures());
+        reader.setKeyPool(keys);
         Json::Value data;
 
         reader.parse(begin, end, data, false);
@@ -56,7 +84,8 @@ Json::Value RTDB::getData(const char* path)
             const char* begin = this->app->local_response_buffer;
             const char* end = begin + strlen(this->app->local_response_buffer);
 
-            Json::Reader reader;
+            Json::Reader reader(rtdbFeatures());
+            reader.setKeyPool(keys);
             Json::Value data;
 
             reader.parse(begin, end, data, false);
@@ -81,13 +110,13 @@ esp_err_t RTDB::putData(const char* path, const char* json_str)
     url += path;
     url += ".json?auth=" + this->app->auth_token;
     this->app->setHeader("content-type", "application/json");
-    http_ret_t http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_PUT, json_str);
+    http_ret_t http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_PUT, json_str, strlen(json_str));
     if (!(http_ret.err == ESP_OK && http_ret.status_code == 200) && http_ret.status_code == 401) {
         ESP_LOGW(RTDB_TAG, "PUT 401 -> intentando refresh auth");
         this->app->forceRefreshAuth();
         url = RTDB::base_database_url; url += path; url += ".json?auth=" + this->app->auth_token;
         this->app->setHeader("content-type", "application/json");
-        http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_PUT, json_str);
+        http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_PUT, json_str, strlen(json_str));
     }
     this->app->clearHTTPBuffer();
     if (http_ret.err == ESP_OK && http_ret.status_code == 200) {
@@ -100,11 +129,12 @@ esp_err_t RTDB::putData(const char* path, const char* json_str)
 
 esp_err_t RTDB::putData(const char* path, const Json::Value& data)
 {
-    Json::FastWriter writer;
-    std::string json_str = writer.write(data);
-    esp_err_t err = RTDB::putData(path, json_str.c_str());
-    return err;
-
+    std::unique_ptr<char[]> body = serializeJson(data);
+    if (!body) {
+        ESP_LOGE(RTDB_TAG, "Sin memoria para serializar el body");
+        return ESP_ERR_NO_MEM;
+    }
+    return RTDB::putData(path, body.get());
 }
 
 esp_err_t RTDB::postData(const char* path, const char* json_str)
@@ -114,13 +144,13 @@ esp_err_t RTDB::postData(const char* path, const char* json_str)
     url += path;
     url += ".json?auth=" + this->app->auth_token;
     this->app->setHeader("content-type", "application/json");
-    http_ret_t http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_POST, json_str);
+    http_ret_t http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_POST, json_str, strlen(json_str));
     if (!(http_ret.err == ESP_OK && http_ret.status_code == 200) && http_ret.status_code == 401) {
         ESP_LOGW(RTDB_TAG, "POST 401 -> intentando refresh auth");
         this->app->forceRefreshAuth();
         url = RTDB::base_database_url; url += path; url += ".json?auth=" + this->app->auth_token;
         this->app->setHeader("content-type", "application/json");
-        http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_POST, json_str);
+        http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_POST, json_str, strlen(json_str));
     }
     this->app->clearHTTPBuffer();
     if (http_ret.err == ESP_OK && http_ret.status_code == 200) {
@@ -133,11 +163,12 @@ esp_err_t RTDB::postData(const char* path, const char* json_str)
 
 esp_err_t RTDB::postData(const char* path, const Json::Value& data)
 {
-    Json::FastWriter writer;
-    std::string json_str = writer.write(data);
-    esp_err_t err = RTDB::postData(path, json_str.c_str());
-    return err;
-
+    std::unique_ptr<char[]> body = serializeJson(data);
+    if (!body) {
+        ESP_LOGE(RTDB_TAG, "Sin memoria para serializar el body");
+        return ESP_ERR_NO_MEM;
+    }
+    return RTDB::postData(path, body.get());
 }
 esp_err_t RTDB::patchData(const char* path, const char* json_str)
 {
@@ -146,13 +177,13 @@ esp_err_t RTDB::patchData(const char* path, const char* json_str)
     url += path;
     url += ".json?auth=" + this->app->auth_token;
     this->app->setHeader("content-type", "application/json");
-    http_ret_t http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_PATCH, json_str);
+    http_ret_t http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_PATCH, json_str, strlen(json_str));
     if (!(http_ret.err == ESP_OK && http_ret.status_code == 200) && http_ret.status_code == 401) {
         ESP_LOGW(RTDB_TAG, "PATCH 401 -> intentando refresh auth");
         this->app->forceRefreshAuth();
         url = RTDB::base_database_url; url += path; url += ".json?auth=" + this->app->auth_token;
         this->app->setHeader("content-type", "application/json");
-        http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_PATCH, json_str);
+        http_ret = this->app->performRequest(url.c_str(), HTTP_METHOD_PATCH, json_str, strlen(json_str));
     }
     this->app->clearHTTPBuffer();
     if (http_ret.err == ESP_OK && http_ret.status_code == 200) {
@@ -165,10 +196,40 @@ esp_err_t RTDB::patchData(const char* path, const char* json_str)
 
 esp_err_t RTDB::patchData(const char* path, const Json::Value& data)
 {
-    Json::FastWriter writer;
-    std::string json_str = writer.write(data);
-    esp_err_t err = RTDB::patchData(path, json_str.c_str());
-    return err;
+    std::unique_ptr<char[]> body = serializeJson(data);
+    if (!body) {
+        ESP_LOGE(RTDB_TAG, "Sin memoria para serializar el body");
+        return ESP_ERR_NO_MEM;
+    }
+    return RTDB::patchData(path, body.get());
+}
+
+// PATCH de Firebase solo mezcla el primer nivel: los objetos anidados del
+// merge patch se expresan como rutas "padre/hijo"
+static void flattenPatch(const Json::Value& patch, std::string& prefix, Json::Value& out)
+{
+    for (auto it = patch.begin(); it != patch.end(); ++it) {
+        const size_t len = prefix.size();
+        prefix += it.name();
+        if (it->isObject() && !it->empty()) {
+            prefix += '/';
+            flattenPatch(*it, prefix, out);
+        } else {
+            out[prefix] = *it;
+        }
+        prefix.resize(len);
+    }
+}
+
+esp_err_t RTDB::patchData(const char* path, const Json::Value& before, const Json::Value& after)
+{
+    if (!before.isObject() || !after.isObject()) return RTDB::putData(path, after);
+    const Json::Value patch = Json::mergePatch(before, after);
+    if (patch.empty()) return ESP_OK; // nada cambió
+    Json::Value flat(Json::objectValue);
+    std::string prefix;
+    flattenPatch(patch, prefix, flat);
+    return RTDB::patchData(path, flat);
 }
 
 esp_err_t RTDB::deleteData(const char* path)
@@ -238,22 +299,35 @@ esp_err_t RTDB::trimDays(const char* root_path, int max_days)
         return ESP_FAIL;
     }
 
+    // Solo se recorren las claves (sin Value ni getMemberNames): una pasada
+    // cuenta los días y otra conserva solo los to_delete más antiguos
     const char* begin = this->app->local_response_buffer;
     const char* end = begin + strlen(this->app->local_response_buffer);
-    Json::Reader reader;
-    Json::Value days_obj;
-    reader.parse(begin, end, days_obj, false);
-    this->app->clearHTTPBuffer();
-    if (!days_obj.isObject()) return ESP_OK; // nada que recortar
-
-    std::vector<std::string> days = days_obj.getMemberNames();
-    if ((int)days.size() <= max_days) return ESP_OK;
+    int day_count = 0;
+    Json::MemberNameCursor counter(begin, end);
+    while (counter.next()) ++day_count;
+    if (!counter.ok() || day_count <= max_days) {
+        this->app->clearHTTPBuffer();
+        return ESP_OK; // nada que recortar
+    }
 
     // Las fechas deben estar en formato YYYY-MM-DD para que el orden lex sea cronológico
-    std::sort(days.begin(), days.end()); // asc: más antiguo primero si YYYY-MM-DD
+    const size_t to_delete = (size_t)(day_count - max_days);
+    std::priority_queue<std::string> oldest; // max-heap: top = el más reciente de los guardados
+    Json::MemberNameCursor cursor(begin, end);
+    while (cursor.next()) {
+        if (oldest.size() < to_delete) {
+            oldest.emplace(cursor.name(), cursor.length());
+        } else if (oldest.top().compare(0, std::string::npos, cursor.name(), cursor.length()) > 0) {
+            oldest.pop();
+            oldest.emplace(cursor.name(), cursor.length());
+        }
+    }
+    this->app->clearHTTPBuffer();
+    std::vector<std::string> days(oldest.size());
+    for (size_t i = days.size(); i-- > 0; oldest.pop()) days[i] = oldest.top(); // asc
 
-    int to_delete = (int)days.size() - max_days;
-    for (int i = 0; i < to_delete; ++i) {
+    for (size_t i = 0; i < days.size(); ++i) {
         std::string child = std::string(root_path) + "/" + days[i];
         ESP_LOGI(RTDB_TAG, "trimDays: borrando día antiguo %s", days[i].c_str());
         RTDB::deleteData(child.c_str());
@@ -275,23 +349,19 @@ int RTDB::trimOldestBatch(const char* root_path, int batch_size)
         this->app->clearHTTPBuffer();
         return -1;
     }
+    // Solo hacen falta las claves: se recorren sin materializar los registros
     const char* begin = this->app->local_response_buffer;
     const char* end = begin + strlen(this->app->local_response_buffer);
-    Json::Reader reader;
-    Json::Value obj;
-    reader.parse(begin, end, obj, false);
-    this->app->clearHTTPBuffer();
-    if (!obj.isObject()) return 0;
-    std::vector<std::string> keys = obj.getMemberNames();
-    if (keys.empty()) return 0;
-
-    std::string patch_body;
+    std::string patch_body = "{";
     patch_body.reserve(1024);
-    patch_body += "{";
-    for (size_t i = 0; i < keys.size(); ++i) {
-        if (i) patch_body += ",";
-        patch_body += "\""; patch_body += keys[i]; patch_body += "\":null";
+    int count = 0;
+    Json::MemberNameCursor cursor(begin, end);
+    while (cursor.next()) {
+        if (count++) patch_body += ",";
+        patch_body += "\""; patch_body.append(cursor.name(), cursor.length()); patch_body += "\":null";
     }
+    this->app->clearHTTPBuffer();
+    if (!cursor.ok() || count == 0) return 0;
     patch_body += "}";
 
     std::string patch_url = RTDB::base_database_url;
@@ -303,7 +373,7 @@ int RTDB::trimOldestBatch(const char* root_path, int batch_size)
     if (!(patch_ret.err == ESP_OK && patch_ret.status_code >= 200 && patch_ret.status_code < 300)) {
         return -2;
     }
-    return (int)keys.size();
+    return count;
 }
 
 }
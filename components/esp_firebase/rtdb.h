@@ -20,7 +20,9 @@ namespace ESPFirebase
 
     public:
                 
-        Json::Value getData(const char* path);
+        // keys: opcional; comparte los nombres de miembro repetidos (arreglos
+        // de registros). Debe vivir más que el Value devuelto y sus copias.
+        Json::Value getData(const char* path, Json::KeyPool* keys = nullptr);
 
         esp_err_t putData(const char* path, const char* json_str);
         esp_err_t putData(const char* path, const Json::Value& data);
@@ -30,6 +32,9 @@ namespace ESPFirebase
 
         esp_err_t patchData(const char* path, const char* json_str);
         esp_err_t patchData(const char* path, const Json::Value& data);
+        // Envía solo lo que cambió de before a after (merge patch aplanado a
+        // rutas "a/b" para el PATCH multi-ruta); sin cambios no hay petición
+        esp_err_t patchData(const char* path, const Json::Value& before, const Json::Value& after);
         
         esp_err_t deleteData(const char* path);
         // Opcionales de mantenimiento
@@ -6,6 +6,7 @@
 #ifndef JSON_ALLOCATOR_H_INCLUDED
 #define JSON_ALLOCATOR_H_INCLUDED
 
+#include <cstddef>
 #include <cstring>
 #include <memory>
 
@@ -13,6 +14,111 @@
 #pragma pack()
 
 namespace Json {
+
+/** \brief Memory functions behind the library's own allocations.
+ *
+ * The strings and members of every Value, and the work stacks of the
+ * readers, are allocated through allocateMemory(), which calls these hooks.
+ * By default they are malloc() and free(). On ESP-IDF, for example, large
+ * trees can be moved out of internal DRAM:
+ * \code
+ * void* toSpiram(size_t size, void*) {
+ *   return heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM,
+ *                                  MALLOC_CAP_DEFAULT);
+ * }
+ * void release(void* pointer, void*) { heap_caps_free(pointer); }
+ * const Json::AllocatorHooks hooks = {toSpiram, release, nullptr};
+ * Json::setAllocatorHooks(&hooks);
+ * \endcode
+ * Define JSONCPP_USING_ALLOCATOR_HOOKS to 1 to route Json::String as well.
+ */
+struct AllocatorHooks {
+  /// Return NULL on failure.
+  void* (*allocate)(size_t size, void* context);
+  void (*release)(void* pointer, void* context);
+  void* context;
+};
+
+/** Install \a hooks, or malloc() and free() again if \a hooks is NULL.
+ * Memory is handed back to whichever hooks are installed when it is
+ * released, so switch only while no library object holds memory. Not
+ * thread safe.
+ */
+void JSON_API setAllocatorHooks(const AllocatorHooks* hooks);
+
+/// Allocate through the hooks. Never returns NULL: running out of memory is
+/// reported like any other runtime error.
+void* JSON_API allocateMemory(size_t size);
+
+/// Release memory from allocateMemory(). NULL is ignored.
+void JSON_API releaseMemory(void* pointer);
+
+/** \brief Standard allocator over allocateMemory() and releaseMemory().
+ *
+ * Used for the containers inside Value and the readers, and for Json::String
+ * when JSONCPP_USING_ALLOCATOR_HOOKS is set.
+ */
+template <typename T> class HookAllocator {
+public:
+  // Type definitions
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  /**
+   * Allocate memory for N items through the allocator hooks.
+   */
+  pointer allocate(size_type n) {
+    return static_cast<pointer>(allocateMemory(n * sizeof(T)));
+  }
+
+  /**
+   * Release memory which was allocated for N items at pointer P.
+   */
+  void deallocate(pointer p, size_type) { releaseMemory(p); }
+
+  /**
+   * Construct an item in-place at pointer P.
+   */
+  template <typename... Args> void construct(pointer p, Args&&... args) {
+    // construct using "placement new" and "perfect forwarding"
+    ::new (static_cast<void*>(p)) T(std::forward<Args>(args)...);
+  }
+
+  size_type max_size() const { return size_t(-1) / sizeof(T); }
+
+  pointer address(reference x) const { return std::addressof(x); }
+
+  const_pointer address(const_reference x) const { return std::addressof(x); }
+
+  /**
+   * Destroy an item in-place at pointer P.
+   */
+  void destroy(pointer p) {
+    // destroy using "explicit destructor"
+    p->~T();
+  }
+
+  // Boilerplate
+  HookAllocator() {}
+  template <typename U> HookAllocator(const HookAllocator<U>&) {}
+  template <typename U> struct rebind { using other = HookAllocator<U>; };
+};
+
+template <typename T, typename U>
+bool operator==(const HookAllocator<T>&, const HookAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const HookAllocator<T>&, const HookAllocator<U>&) {
+  return false;
+}
+
 template <typename T> class SecureAllocator {
 public:
   // Type definitions
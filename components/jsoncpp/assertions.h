@@ -7,12 +7,15 @@
 #define JSON_ASSERTIONS_H_INCLUDED
 
 #include <cstdlib>
-#include <sstream>
 
 #if !defined(JSON_IS_AMALGAMATION)
 #include "config.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
 
+#if !JSONCPP_NO_IOSTREAM
+#include <sstream>
+#endif
+
 /** It should not be possible for a maliciously designed file to
  *  cause an abort() or seg-fault, so these macros are used only
  *  for pre-condition violations and internal logic errors.
@@ -27,6 +30,13 @@
     }                                                                          \
   } while (0)
 
+#if JSONCPP_NO_IOSTREAM
+#define JSON_FAIL_MESSAGE(message)                                             \
+  do {                                                                         \
+    Json::throwLogicError(message);                                            \
+    abort();                                                                   \
+  } while (0)
+#else
 #define JSON_FAIL_MESSAGE(message)                                             \
   do {                                                                         \
     OStringStream oss;                                                         \
@@ -34,6 +44,7 @@
     Json::throwLogicError(oss.str());                                          \
     abort();                                                                   \
   } while (0)
+#endif
 
 #else // JSON_USE_EXCEPTION
 
@@ -41,6 +52,13 @@
 
 // The call to assert() will show the failure message in debug builds. In
 // release builds we abort, for a core-dump or debugger.
+#if JSONCPP_NO_IOSTREAM
+#define JSON_FAIL_MESSAGE(message)                                             \
+  {                                                                            \
+    assert(false && (message));                                                \
+    abort();                                                                   \
+  }
+#else
 #define JSON_FAIL_MESSAGE(message)                                             \
   {                                                                            \
     OStringStream oss;                                                         \
@@ -48,6 +66,7 @@
     assert(false && oss.str().c_str());                                        \
     abort();                                                                   \
   }
+#endif
 
 #endif
 
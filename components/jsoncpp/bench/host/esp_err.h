@@ -0,0 +1,10 @@
+// Host stand-in for the ESP-IDF header, enough for main/sensors.h.
+#ifndef JSONCPP_BENCH_ESP_ERR_H_INCLUDED
+#define JSONCPP_BENCH_ESP_ERR_H_INCLUDED
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+#endif // JSONCPP_BENCH_ESP_ERR_H_INCLUDED
@@ -0,0 +1,8 @@
+// Host stand-in for main/privado.h, which holds the device credentials and
+// is not in the repository. main/sensors_json.cpp only needs DEVICE_ID.
+#ifndef JSONCPP_BENCH_PRIVADO_H_INCLUDED
+#define JSONCPP_BENCH_PRIVADO_H_INCLUDED
+
+#define DEVICE_ID "ESP32-WROVER-01"
+
+#endif // JSONCPP_BENCH_PRIVADO_H_INCLUDED
@@ -0,0 +1,595 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+// Host benchmark over the payload shapes the firmware exchanges with
+// Firebase. Prints one JSON object per line:
+//   {"payload":"listing_10k","bytes":220001,"op":"Reader","ns_per_byte":22.9,
+//    "allocs":30005,"peak_heap":790671,"iterations":21}
+// allocs and peak_heap are for a single run of the operation; peak_heap is
+// the highest live heap above what was allocated before it started, so for
+// the readers it includes the resulting Value.
+// Payloads with real numbers also time decoding just their number tokens,
+// through the istringstream the readers used before and through
+// decodeRealToken(). Doubles are also formatted one by one, through the old
+// snprintf path and through valueToChars(), reported per value:
+//   {"values":"sensor","count":20000,"op":"valueToChars_17",
+//    "ns_per_value":98.1,"allocs":0,"peak_heap":0,"iterations":103}
+//
+// The bound-struct encoder is timed on the session record against the old
+// snprintf format and a Value with FastWriter, and its decoder on the three
+// members app.cpp reads from the token response against Reader and
+// extractPointers().
+//
+// Usage: json_bench [milliseconds per case, default 200]
+
+#include "legacy.h"
+
+#include <json.h>
+#include <json_tool.h>
+#include <sensors.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Heap accounting
+// //////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct HeapStats {
+  size_t allocs;
+  size_t live;
+  size_t peak;
+};
+
+HeapStats heap;
+
+// Each block carries its size in front so release can account for it.
+const size_t headerSize = alignof(std::max_align_t);
+
+void* trackedAllocate(size_t size) {
+  auto block = static_cast<char*>(malloc(size + headerSize));
+  if (block == nullptr)
+    return nullptr;
+  *reinterpret_cast<size_t*>(block) = size;
+  ++heap.allocs;
+  heap.live += size;
+  if (heap.live > heap.peak)
+    heap.peak = heap.live;
+  return block + headerSize;
+}
+
+void trackedRelease(void* pointer) {
+  if (pointer == nullptr)
+    return;
+  char* block = static_cast<char*>(pointer) - headerSize;
+  heap.live -= *reinterpret_cast<size_t*>(block);
+  free(block);
+}
+
+void* hookAllocate(size_t size, void*) { return trackedAllocate(size); }
+void hookRelease(void* pointer, void*) { trackedRelease(pointer); }
+
+} // namespace
+
+void* operator new(size_t size) {
+  void* pointer = trackedAllocate(size);
+  if (pointer == nullptr)
+    abort();
+  return pointer;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { trackedRelease(pointer); }
+void operator delete[](void* pointer) noexcept { trackedRelease(pointer); }
+void operator delete(void* pointer, size_t) noexcept {
+  trackedRelease(pointer);
+}
+void operator delete[](void* pointer, size_t) noexcept {
+  trackedRelease(pointer);
+}
+
+// Corpus
+// //////////////////////////////////////////////////////////////////
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Payload {
+  const char* name;
+  std::string document;
+};
+
+std::string randomToken(std::mt19937& random, size_t length) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+  std::string token;
+  token.reserve(length);
+  for (size_t i = 0; i < length; ++i)
+    token += alphabet[random() % (sizeof(alphabet) - 1)];
+  return token;
+}
+
+// Response of securetoken.googleapis.com to a refresh_token grant.
+std::string tokenResponse(std::mt19937& random) {
+  const std::string idToken = "eyJhbGciOiJSUzI1NiIsImtpZCI6Ij" +
+                              randomToken(random, 880) + "." +
+                              randomToken(random, 342);
+  return "{\"access_token\":\"" + idToken +
+         "\",\"expires_in\":\"3600\",\"token_type\":\"Bearer\","
+         "\"refresh_token\":\"AMf-vB" +
+         randomToken(random, 290) + "\",\"id_token\":\"" + idToken +
+         "\",\"user_id\":\"" + randomToken(random, 28) +
+         "\",\"project_id\":\"" + std::to_string(random() % 1000000000000ULL) +
+         "\"}";
+}
+
+// "YY-MM-DD_HH-MM", the key of one record under /historial_mediciones.
+std::string recordKey(unsigned index) {
+  const unsigned minutes = index * 5;
+  const unsigned day = minutes / (24 * 60);
+  char key[32];
+  snprintf(key, sizeof(key), "%02u-%02u-%02u_%02u-%02u", 26 + day / 336,
+           1 + day / 28 % 12, 1 + day % 28, minutes / 60 % 24, minutes % 60);
+  return key;
+}
+
+// One averaged record as sensors_format_json() writes it.
+std::string record(std::mt19937& random, unsigned index, bool session) {
+  const auto reading = [&](double base, double spread) {
+    return base + spread * static_cast<double>(random() % 1000) / 1000.0;
+  };
+  const std::string key = recordKey(index);
+  char text[512];
+  int length = snprintf(
+      text, sizeof(text),
+      "{\"pm1p0\":%.2f,\"pm2p5\":%.2f,\"pm4p0\":%.2f,\"pm10p0\":%.2f,"
+      "\"voc\":%.1f,\"nox\":%.1f,\"cTe\":%.2f,\"cHu\":%.2f,\"co2\":%u,"
+      "\"fecha\":\"%.8s\"",
+      reading(2, 6), reading(4, 10), reading(5, 12), reading(6, 14),
+      reading(80, 60), reading(1, 3), reading(18, 10), reading(35, 30),
+      static_cast<unsigned>(reading(420, 500)), key.c_str());
+  if (session)
+    length += snprintf(text + length, sizeof(text) - length,
+                       ",\"inicio\":\"%s\",\"ciudad\":\"Monterrey, Nuevo "
+                       "Le\\u00f3n\"",
+                       key.c_str() + 9);
+  length += snprintf(text + length, sizeof(text) - length,
+                     ",\"hora\":\"%s:00\"", key.c_str() + 9);
+  if (session)
+    snprintf(text + length, sizeof(text) - length,
+             ",\"id\":\"ESP32-WROVER-01\"");
+  return std::string(text) + "}";
+}
+
+// GET ?shallow=true of /historial_mediciones.
+std::string shallowListing(unsigned keys) {
+  std::string listing = "{";
+  for (unsigned i = 0; i < keys; ++i) {
+    if (i)
+      listing += ',';
+    listing += '"' + recordKey(i) + "\":true";
+  }
+  return listing + "}";
+}
+
+// GET of a whole day: 288 records, the first opening a session.
+std::string historyDay(std::mt19937& random) {
+  std::string day = "{";
+  for (unsigned i = 0; i < 288; ++i) {
+    if (i)
+      day += ',';
+    day += '"' + recordKey(i) + "\":" + record(random, i, i == 0);
+  }
+  return day + "}";
+}
+
+// A number-heavy upload: bare readings with coordinates and timestamps, with
+// the mix of precisions the sensors produce. About 1.1 MB.
+std::string readings(std::mt19937& random) {
+  const auto reading = [&](double base, double spread) {
+    return base + spread * static_cast<double>(random() % 100000) / 100000.0;
+  };
+  std::string array = "[";
+  for (unsigned i = 0; i < 6000; ++i) {
+    char text[320];
+    snprintf(text, sizeof(text),
+             "%s{\"pm1p0\":%.2f,\"pm2p5\":%.2f,\"pm4p0\":%.2f,"
+             "\"pm10p0\":%.2f,\"voc\":%.1f,\"nox\":%.1f,\"cTe\":%.2f,"
+             "\"cHu\":%.2f,\"co2\":%u,\"lat\":%.6f,\"lon\":%.6f,"
+             "\"alt\":%.17g,\"t\":%.3e}",
+             i ? "," : "", reading(2, 6), reading(4, 10), reading(5, 12),
+             reading(6, 14), reading(80, 60), reading(1, 3), reading(18, 10),
+             reading(35, 30), static_cast<unsigned>(reading(420, 500)),
+             reading(25.6, 0.2), reading(-100.4, 0.2), reading(530, 40),
+             1.76e9 + i * 300.0);
+    array += text;
+  }
+  return array + "]";
+}
+
+std::vector<Payload> corpus() {
+  std::mt19937 random(2024);
+  std::vector<Payload> payloads;
+  payloads.push_back({"token_response", tokenResponse(random)});
+  payloads.push_back({"record", record(random, 0, false)});
+  payloads.push_back({"record_session", record(random, 0, true)});
+  payloads.push_back({"listing_1k", shallowListing(1000)});
+  payloads.push_back({"listing_10k", shallowListing(10000)});
+  payloads.push_back({"listing_50k", shallowListing(50000)});
+  payloads.push_back({"history_day", historyDay(random)});
+  payloads.push_back({"readings_1mb", readings(random)});
+  return payloads;
+}
+
+// Runner
+// //////////////////////////////////////////////////////////////////
+
+struct Measurement {
+  size_t allocs;
+  size_t peak;
+  double nanoseconds;
+  size_t iterations;
+};
+
+// Runs \a operation once for the heap figures, then repeatedly for at least
+// \a budget. Operations return a size so the work cannot be optimized out.
+template <class Operation>
+Measurement measure(Operation operation, Clock::duration budget) {
+  Measurement result{};
+  const HeapStats before = heap;
+  heap.peak = heap.live;
+  volatile size_t sink = operation();
+  result.allocs = heap.allocs - before.allocs;
+  result.peak = heap.peak - before.live;
+  heap.peak = before.peak > heap.peak ? before.peak : heap.peak;
+
+  const Clock::time_point start = Clock::now();
+  Clock::time_point now = start;
+  do {
+    sink = sink + operation();
+    ++result.iterations;
+    now = Clock::now();
+  } while (now - start < budget);
+  result.nanoseconds =
+      std::chrono::duration<double, std::nano>(now - start).count() /
+      static_cast<double>(result.iterations);
+  return result;
+}
+
+void report(const Payload& payload, const char* op,
+            const Measurement& measurement) {
+  printf("{\"payload\":\"%s\",\"bytes\":%zu,\"op\":\"%s\",\"ns_per_byte\":%.3f,"
+         "\"allocs\":%zu,\"peak_heap\":%zu,\"iterations\":%zu}\n",
+         payload.name, payload.document.size(), op,
+         measurement.nanoseconds /
+             static_cast<double>(payload.document.size()),
+         measurement.allocs, measurement.peak, measurement.iterations);
+  fflush(stdout);
+}
+
+// Number tokens
+// //////////////////////////////////////////////////////////////////
+
+struct Token {
+  const char* begin;
+  const char* end;
+};
+
+// The tokens the readers hand to decodeRealToken(): numbers outside strings
+// with a fraction or an exponent (the rest are decoded as integers).
+std::vector<Token> realTokens(const std::string& document) {
+  std::vector<Token> tokens;
+  const char* p = document.data();
+  const char* end = p + document.size();
+  while (p != end) {
+    if (*p == '"') {
+      for (++p; p != end && *p != '"'; ++p)
+        if (*p == '\\' && p + 1 != end)
+          ++p;
+      if (p != end)
+        ++p;
+    } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+      const char* begin = p;
+      bool real = false;
+      for (; p != end && strchr("0123456789+-.eE", *p) != nullptr; ++p)
+        real = real || *p == '.' || *p == 'e' || *p == 'E';
+      if (real)
+        tokens.push_back({begin, p});
+    } else {
+      ++p;
+    }
+  }
+  return tokens;
+}
+
+template <class Decode>
+size_t decodeAll(const std::vector<Token>& tokens, Decode decode) {
+  size_t decoded = 0;
+  for (const Token& token : tokens) {
+    double value = 0;
+    if (decode(token.begin, token.end, value))
+      decoded += static_cast<size_t>(value) & 1;
+  }
+  return decoded;
+}
+
+// Number formatting
+// //////////////////////////////////////////////////////////////////
+
+struct Values {
+  const char* name;
+  std::vector<double> values;
+};
+
+// Readings with two decimals as the sensors report them, and doubles spread
+// over the whole exponent range.
+std::vector<Values> valueSets() {
+  std::mt19937_64 random(27);
+  std::vector<Values> sets = {{"sensor", {}}, {"random", {}}};
+  for (int i = 0; i < 20000; ++i) {
+    sets[0].values.push_back(static_cast<double>(random() % 1000000) / 100.0);
+    const auto numerator = static_cast<double>(static_cast<int64_t>(random()));
+    sets[1].values.push_back(numerator /
+                             static_cast<double>(random() % 1000000 + 1));
+  }
+  return sets;
+}
+
+size_t formatLegacy(double value) {
+  return legacy::valueToString(value).size();
+}
+
+size_t formatChars(double value) {
+  char buffer[32];
+  return Json::valueToChars(value, buffer, sizeof(buffer));
+}
+
+size_t formatLegacyFixed2(double value) {
+  return legacy::valueToString(value, 2, Json::PrecisionType::decimalPlaces)
+      .size();
+}
+
+size_t formatCharsFixed2(double value) {
+  char buffer[32];
+  return Json::valueToChars(value, buffer, sizeof(buffer), 2,
+                            Json::PrecisionType::decimalPlaces);
+}
+
+template <class Format>
+size_t formatAll(const std::vector<double>& values, Format format) {
+  size_t length = 0;
+  for (double value : values)
+    length += format(value);
+  return length;
+}
+
+void report(const Values& values, const char* op,
+            const Measurement& measurement) {
+  printf("{\"values\":\"%s\",\"count\":%zu,\"op\":\"%s\","
+         "\"ns_per_value\":%.3f,\"allocs\":%zu,\"peak_heap\":%zu,"
+         "\"iterations\":%zu}\n",
+         values.name, values.values.size(), op,
+         measurement.nanoseconds / static_cast<double>(values.values.size()),
+         measurement.allocs, measurement.peak, measurement.iterations);
+  fflush(stdout);
+}
+
+// Bound structs
+// //////////////////////////////////////////////////////////////////
+
+// The opening record of a session, the largest one sensors_format_json()
+// writes.
+const SensorData sensorReading = {612,   24.1f,  46.3f, 12.34f, 15.2f,
+                                  17.9f, 19.01f, 101.3f, 1.2f,  25.02f,
+                                  43.9f, 24.56f, 45.12f};
+const char* const sensorTime = "10:15:00";
+const char* const sensorDate = "2026-10-18 10:15:00";
+const char* const sensorStart = "2026-10-18 10:00:00";
+
+size_t sensorRecordSnprintf() {
+  char buffer[384];
+  legacy::sensorRecord(&sensorReading, sensorTime, sensorDate, sensorStart,
+                       sensors_get_city_state(), "ESP32-WROVER-01", buffer,
+                       sizeof(buffer));
+  return strlen(buffer);
+}
+
+size_t sensorRecordWriteFields() {
+  char buffer[384];
+  sensors_format_json(&sensorReading, sensorTime, sensorDate, sensorStart,
+                      buffer, sizeof(buffer));
+  return strlen(buffer);
+}
+
+size_t sensorRecordFastWriter() {
+  const SensorData& d = sensorReading;
+  Json::Value record(Json::objectValue);
+  record["pm1p0"] = d.pm1p0;
+  record["pm2p5"] = d.pm2p5;
+  record["pm4p0"] = d.pm4p0;
+  record["pm10p0"] = d.pm10p0;
+  record["voc"] = d.voc;
+  record["nox"] = d.nox;
+  record["cTe"] = d.avg_temp;
+  record["cHu"] = d.avg_hum;
+  record["co2"] = d.co2;
+  record["fecha"] = sensorDate;
+  record["inicio"] = sensorStart;
+  record["ciudad"] = sensors_get_city_state();
+  record["hora"] = sensorTime;
+  record["id"] = "ESP32-WROVER-01";
+  Json::FastWriter writer;
+  return writer.write(record).size();
+}
+
+// The members FirebaseApp reads from a token refresh (TokenResponse in
+// components/esp_firebase/app.cpp).
+struct TokenFields {
+  Json::String access_token;
+  Json::String expires_in;
+  Json::String expiresIn;
+};
+const Json::FieldBinding<TokenFields> tokenFields[] = {
+    JSONCPP_BIND(TokenFields, access_token, "access_token"),
+    JSONCPP_BIND(TokenFields, expires_in, "expires_in"),
+    JSONCPP_BIND(TokenFields, expiresIn, "expiresIn"),
+};
+const char* const tokenPointers[] = {"/access_token", "/expires_in",
+                                     "/expiresIn"};
+
+size_t tokenWithReader(const char* begin, const char* end) {
+  Json::Reader reader;
+  Json::Value root;
+  reader.parse(begin, end, root, false);
+  size_t length = 0;
+  for (const char* pointer : tokenPointers)
+    length += root.get(pointer + 1, "").asString().size();
+  return length;
+}
+
+size_t tokenWithPointers(const char* begin, const char* end) {
+  Json::Value values[3];
+  Json::extractPointers(begin, end, tokenPointers, 3, values);
+  size_t length = 0;
+  for (const Json::Value& value : values)
+    length += value.isString() ? value.asString().size() : 0;
+  return length;
+}
+
+size_t tokenWithFields(const char* begin, const char* end) {
+  TokenFields fields;
+  Json::readFields(begin, end, tokenFields, fields);
+  return fields.access_token.size() + fields.expires_in.size() +
+         fields.expiresIn.size();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  const auto budget =
+      std::chrono::milliseconds(argc > 1 ? atoi(argv[1]) : 200);
+  const Json::AllocatorHooks hooks = {hookAllocate, hookRelease, nullptr};
+  Json::setAllocatorHooks(&hooks);
+
+  Json::CharReaderBuilder readerBuilder;
+  Json::StreamWriterBuilder writerBuilder;
+  writerBuilder["indentation"] = "";
+
+  const std::vector<Payload> payloads = corpus();
+  for (const Payload& payload : payloads) {
+    const char* begin = payload.document.data();
+    const char* end = begin + payload.document.size();
+
+    report(payload, "Reader", measure(
+                                  [&] {
+                                    Json::Reader reader;
+                                    Json::Value root;
+                                    reader.parse(begin, end, root, false);
+                                    return static_cast<size_t>(root.size());
+                                  },
+                                  budget));
+
+    report(payload, "CharReaderBuilder",
+           measure(
+               [&] {
+                 std::unique_ptr<Json::CharReader> reader(
+                     readerBuilder.newCharReader());
+                 Json::Value root;
+                 Json::String errors;
+                 reader->parse(begin, end, &root, &errors);
+                 return static_cast<size_t>(root.size());
+               },
+               budget));
+
+    Json::Value root;
+    Json::Reader().parse(begin, end, root, false);
+
+    report(payload, "FastWriter", measure(
+                                      [&] {
+                                        Json::FastWriter writer;
+                                        return writer.write(root).size();
+                                      },
+                                      budget));
+
+    report(payload, "StreamWriterBuilder",
+           measure([&] { return Json::writeString(writerBuilder, root).size(); },
+                   budget));
+
+    // Number decoding alone, old path against new, per byte of the whole
+    // document so it reads against the Reader figures above.
+    const std::vector<Token> tokens = realTokens(payload.document);
+    if (tokens.empty())
+      continue;
+    report(payload, "decodeDouble_istringstream",
+           measure([&] { return decodeAll(tokens, legacy::decodeDouble); },
+                   budget));
+    report(payload, "decodeRealToken",
+           measure([&] { return decodeAll(tokens, Json::decodeRealToken); },
+                   budget));
+  }
+
+  char record[384];
+  sensors_format_json(&sensorReading, sensorTime, sensorDate, sensorStart,
+                      record, sizeof(record));
+  const Payload sensorRecord = {"sensor_record", record};
+  report(sensorRecord, "snprintf", measure(sensorRecordSnprintf, budget));
+  report(sensorRecord, "writeFields",
+         measure(sensorRecordWriteFields, budget));
+  report(sensorRecord, "Value_FastWriter",
+         measure(sensorRecordFastWriter, budget));
+
+  const Payload& token = payloads.front();
+  const char* tokenBegin = token.document.data();
+  const char* tokenEnd = tokenBegin + token.document.size();
+  report(token, "Reader_3_fields", measure(
+                                       [&] {
+                                         return tokenWithReader(tokenBegin,
+                                                                tokenEnd);
+                                       },
+                                       budget));
+  report(token, "extractPointers_3_fields", measure(
+                                                [&] {
+                                                  return tokenWithPointers(
+                                                      tokenBegin, tokenEnd);
+                                                },
+                                                budget));
+  report(token, "readFields_3_fields", measure(
+                                           [&] {
+                                             return tokenWithFields(tokenBegin,
+                                                                    tokenEnd);
+                                           },
+                                           budget));
+
+  // The writers format every double through valueToChars(); before, it was
+  // legacy::valueToString(). Default precision, then 2 decimal places.
+  for (const Values& values : valueSets()) {
+    const std::vector<double>& doubles = values.values;
+    report(values, "snprintf_17g",
+           measure([&] { return formatAll(doubles, formatLegacy); }, budget));
+    report(values, "valueToChars_17",
+           measure([&] { return formatAll(doubles, formatChars); }, budget));
+    report(values, "snprintf_2f", measure(
+                                      [&] {
+                                        return formatAll(doubles,
+                                                         formatLegacyFixed2);
+                                      },
+                                      budget));
+    report(values, "valueToChars_2f", measure(
+                                          [&] {
+                                            return formatAll(doubles,
+                                                             formatCharsFixed2);
+                                          },
+                                          budget));
+  }
+  return 0;
+}
@@ -0,0 +1,115 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef JSONCPP_BENCH_LEGACY_H_INCLUDED
+#define JSONCPP_BENCH_LEGACY_H_INCLUDED
+
+// The conversions and formats the firmware used before replacing them, kept
+// verbatim so json_bench can time against them and json_check can require
+// the same output.
+
+#include <json.h>
+#include <json_tool.h>
+#include <sensors.h>
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+#include <string>
+
+namespace legacy {
+
+// Reader::decodeDouble() before json_number_parse.inl: one istringstream per
+// token.
+inline bool decodeDouble(const char* begin, const char* end, double& value) {
+  std::istringstream is(std::string(begin, end));
+  if (!(is >> value)) {
+    if (value == std::numeric_limits<double>::max())
+      value = std::numeric_limits<double>::infinity();
+    else if (value == std::numeric_limits<double>::lowest())
+      value = -std::numeric_limits<double>::infinity();
+    else if (!std::isinf(value))
+      return false;
+  }
+  return true;
+}
+
+// valueToString(double) for finite values before json_number_format.inl:
+// "%.*g" or "%.*f" through snprintf.
+inline Json::String valueToString(
+    double value, unsigned int precision = Json::Value::defaultRealPrecision,
+    Json::PrecisionType precisionType =
+        Json::PrecisionType::significantDigits) {
+  Json::String buffer(size_t(36), '\0');
+  while (true) {
+    int len = snprintf(&*buffer.begin(), buffer.size(),
+                       (precisionType == Json::PrecisionType::significantDigits)
+                           ? "%.*g"
+                           : "%.*f",
+                       precision, value);
+    assert(len >= 0);
+    auto wouldPrint = static_cast<size_t>(len);
+    if (wouldPrint >= buffer.size()) {
+      buffer.resize(wouldPrint + 1);
+      continue;
+    }
+    buffer.resize(wouldPrint);
+    break;
+  }
+
+  buffer.erase(Json::fixNumericLocale(buffer.begin(), buffer.end()),
+               buffer.end());
+
+  if (buffer.find('.') == buffer.npos && buffer.find('e') == buffer.npos) {
+    buffer += ".0";
+  }
+
+  if (precisionType == Json::PrecisionType::decimalPlaces) {
+    buffer.erase(
+        Json::fixZerosInTheEnd(buffer.begin(), buffer.end(), precision),
+        buffer.end());
+  }
+
+  return buffer;
+}
+
+// sensors_format_json() and the two snprintf() variants in main.c before
+// they became one Json::writeFields() call: the session record when there is
+// an inicio, the first record of a day when there is only a fecha, and the
+// bare readings otherwise.
+inline void sensorRecord(const SensorData* d, const char* time_str,
+                         const char* fecha_str, const char* inicio_str,
+                         const char* ciudad, const char* id, char* buf,
+                         size_t buf_size) {
+  if (inicio_str)
+    snprintf(buf, buf_size,
+             "{\"pm1p0\":%.2f,\"pm2p5\":%.2f,\"pm4p0\":%.2f,\"pm10p0\":%.2f,"
+             "\"voc\":%.1f,\"nox\":%.1f,\"cTe\":%.2f,\"cHu\":%.2f,\"co2\":%u,"
+             "\"fecha\":\"%s\",\"inicio\":\"%s\",\"ciudad\":\"%s\","
+             "\"hora\":\"%s\",\"id\":\"%s\"}",
+             d->pm1p0, d->pm2p5, d->pm4p0, d->pm10p0, d->voc, d->nox,
+             d->avg_temp, d->avg_hum, d->co2, fecha_str, inicio_str, ciudad,
+             time_str, id);
+  else if (fecha_str)
+    snprintf(buf, buf_size,
+             "{\"pm1p0\":%.2f,\"pm2p5\":%.2f,\"pm4p0\":%.2f,\"pm10p0\":%.2f,"
+             "\"voc\":%.1f,\"nox\":%.1f,\"cTe\":%.2f,\"cHu\":%.2f,\"co2\":%u,"
+             "\"fecha\":\"%s\",\"hora\":\"%s\"}",
+             d->pm1p0, d->pm2p5, d->pm4p0, d->pm10p0, d->voc, d->nox,
+             d->avg_temp, d->avg_hum, d->co2, fecha_str, time_str);
+  else
+    snprintf(buf, buf_size,
+             "{\"pm1p0\":%.2f,\"pm2p5\":%.2f,\"pm4p0\":%.2f,\"pm10p0\":%.2f,"
+             "\"voc\":%.1f,\"nox\":%.1f,\"cTe\":%.2f,\"cHu\":%.2f,\"co2\":%u,"
+             "\"hora\":\"%s\"}",
+             d->pm1p0, d->pm2p5, d->pm4p0, d->pm10p0, d->voc, d->nox,
+             d->avg_temp, d->avg_hum, d->co2, time_str);
+}
+
+} // namespace legacy
+
+#endif // JSONCPP_BENCH_LEGACY_H_INCLUDED
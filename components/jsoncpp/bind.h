@@ -0,0 +1,215 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef JSON_BIND_H_INCLUDED
+#define JSON_BIND_H_INCLUDED
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "writer.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <cstddef>
+#include <type_traits>
+
+#pragma pack(push)
+#pragma pack()
+
+namespace Json {
+
+/// How a bound member is stored in its struct.
+enum class BindType : unsigned char {
+  boolField,
+  signedField,   ///< any signed integer type
+  unsignedField, ///< any unsigned integer type
+  floatField,
+  doubleField,
+  charsField,  ///< char[N], NUL terminated
+  stringField, ///< Json::String
+  cStringField ///< const char*; encode only, a null pointer omits the member
+};
+
+/// BoundField::format for reals printed as the shortest round-tripping form.
+enum : unsigned char { bindShortest = 0xff };
+
+/** \brief Description of one member of a bound struct. Built at compile time
+ * by JSONCPP_BIND() and JSONCPP_BIND_FIXED(); see writeFields().
+ */
+struct BoundField {
+  /// The member name pre-quoted as `,"name":`. The writer drops the comma
+  /// before the first member.
+  const char* key;
+  /// Bytes in key; JSONCPP_BIND() refuses names that do not fit.
+  unsigned char keyLength;
+  BindType type;
+  /// Decimal places for reals (like "%.*f"), or #bindShortest.
+  unsigned char format;
+  /// sizeof the member; integer width or char array capacity.
+  size_t size;
+};
+
+template <class T> struct FieldBinding {
+  BoundField field;
+  void* (*address)(T& object);
+};
+
+template <class M, class = void> struct BindTypeOf;
+template <> struct BindTypeOf<bool> {
+  static constexpr BindType value = BindType::boolField;
+};
+template <class M>
+struct BindTypeOf<M, typename std::enable_if<std::is_integral<M>::value &&
+                                             std::is_signed<M>::value>::type> {
+  static constexpr BindType value = BindType::signedField;
+};
+template <class M>
+struct BindTypeOf<M, typename std::enable_if<
+                         std::is_integral<M>::value &&
+                         std::is_unsigned<M>::value &&
+                         !std::is_same<M, bool>::value>::type> {
+  static constexpr BindType value = BindType::unsignedField;
+};
+template <> struct BindTypeOf<float> {
+  static constexpr BindType value = BindType::floatField;
+};
+template <> struct BindTypeOf<double> {
+  static constexpr BindType value = BindType::doubleField;
+};
+template <size_t N> struct BindTypeOf<char[N]> {
+  static constexpr BindType value = BindType::charsField;
+};
+template <> struct BindTypeOf<String> {
+  static constexpr BindType value = BindType::stringField;
+};
+template <> struct BindTypeOf<const char*> {
+  static constexpr BindType value = BindType::cStringField;
+};
+
+template <class T, class M, M T::*P> void* boundMember(T& object) {
+  return &(object.*P);
+}
+
+/// Not constexpr: using it in a constant expression is a compile error.
+size_t boundKeyNeedsEscaping();
+
+/// Length of a member name, refusing names the writer would have to escape.
+constexpr size_t boundKeyLength(const char* key, size_t i, size_t n) {
+  return i == n ? n
+         : (key[i] == '"' || key[i] == '\\' ||
+            static_cast<unsigned char>(key[i]) < 0x20)
+             ? boundKeyNeedsEscaping()
+             : boundKeyLength(key, i + 1, n);
+}
+
+/// Not constexpr, like boundKeyNeedsEscaping().
+size_t boundKeyTooLong();
+
+/// Bytes of ,"key": for a name of \a length, refusing what keyLength cannot
+/// hold.
+constexpr size_t boundKeyBytes(size_t length) {
+  return length + 4 <= 0xff ? length + 4 : boundKeyTooLong();
+}
+
+/** Emit one JSON object with a member per field, in table order.
+ * members[i] addresses the struct member described by fields[i].
+ * \return false if the sink refused data.
+ */
+bool JSON_API writeBoundFields(WriterSink& sink,
+                               const BoundField* const* fields,
+                               const void* const* members, size_t count);
+
+/** Assign the members of the top-level object in [begin, end) to the matching
+ * fields. Members without a field, and members whose value is null, are
+ * skipped.
+ * \return false if the document is malformed or a value does not fit its
+ *         field's type.
+ */
+bool JSON_API readBoundFields(const char* begin, const char* end,
+                              const BoundField* const* fields,
+                              void* const* members, size_t count, bool* found);
+
+/** \brief Write a struct as a JSON object without going through a Value.
+ *
+ * The field table is declared once, next to the struct:
+ * \code
+ * struct Reading { double temperature; uint16_t co2; const char* city; };
+ * static const Json::FieldBinding<Reading> readingFields[] = {
+ *     JSONCPP_BIND_FIXED(Reading, temperature, "cTe", 2),
+ *     JSONCPP_BIND(Reading, co2, "co2"),
+ *     JSONCPP_BIND(Reading, city, "ciudad"),
+ * };
+ * Json::writeFields(reading, readingFields, sink);
+ * \endcode
+ *
+ * Keys are quoted at compile time; a key that would need escaping does not
+ * compile. Strings are escaped like StreamWriterBuilder with emitUTF8 set.
+ * Non-finite reals are written as null.
+ */
+template <class T, size_t N>
+bool writeFields(const T& object, const FieldBinding<T> (&fields)[N],
+                 WriterSink& sink) {
+  const BoundField* bound[N];
+  const void* members[N];
+  for (size_t i = 0; i < N; ++i) {
+    bound[i] = &fields[i].field;
+    members[i] = fields[i].address(const_cast<T&>(object));
+  }
+  return writeBoundFields(sink, bound, members, N);
+}
+
+/** Like snprintf(): write at most \a size - 1 bytes plus a NUL into
+ * \a buffer and return the length the whole document needs.
+ */
+template <class T, size_t N>
+size_t writeFields(const T& object, const FieldBinding<T> (&fields)[N],
+                   char* buffer, size_t size) {
+  BufferSink sink(buffer, size);
+  writeFields(object, fields, sink);
+  return sink.size();
+}
+
+/** \brief Read a JSON object straight into a struct.
+ *
+ * Integer fields accept integer literals that fit their type, reals accept
+ * any number, char arrays accept strings shorter than the array. Fields
+ * whose member is missing keep their value.
+ * \param found if not NULL, receives one flag per field.
+ */
+template <class T, size_t N>
+bool readFields(const char* begin, const char* end,
+                const FieldBinding<T> (&fields)[N], T& object,
+                bool* found = nullptr) {
+  const BoundField* bound[N];
+  void* members[N];
+  for (size_t i = 0; i < N; ++i) {
+    bound[i] = &fields[i].field;
+    members[i] = fields[i].address(object);
+  }
+  return readBoundFields(begin, end, bound, members, N, found);
+}
+
+} // namespace Json
+
+/// Bind \a member of \a Type to the JSON member \a key (a string literal).
+#define JSONCPP_BIND(Type, member, key)                                        \
+  JSONCPP_BIND_FORMAT(Type, member, key, ::Json::bindShortest)
+
+/// Like JSONCPP_BIND() for a real written with \a decimals places, as "%.*f".
+#define JSONCPP_BIND_FIXED(Type, member, key, decimals)                        \
+  JSONCPP_BIND_FORMAT(Type, member, key, decimals)
+
+#define JSONCPP_BIND_FORMAT(Type, member, key, format)                         \
+  {                                                                            \
+    {",\"" key "\":",                                                          \
+     static_cast<unsigned char>(                                               \
+         std::integral_constant<size_t,                                        \
+                                ::Json::boundKeyBytes(::Json::boundKeyLength(  \
+                                    key, 0, sizeof(key) - 1))>::value),        \
+     ::Json::BindTypeOf<decltype(Type::member)>::value,                        \
+     static_cast<unsigned char>(format), sizeof(Type::member)},                \
+        &::Json::boundMember<Type, decltype(Type::member), &Type::member>      \
+  }
+
+#pragma pack(pop)
+
+#endif // JSON_BIND_H_INCLUDED
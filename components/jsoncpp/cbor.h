@@ -0,0 +1,100 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef JSON_CBOR_H_INCLUDED
+#define JSON_CBOR_H_INCLUDED
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "json_features.h"
+#include "writer.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+
+#pragma pack(push)
+#pragma pack()
+
+namespace Json {
+
+/** \brief Streaming CBOR (RFC 8949) encoder writing into a WriterSink.
+ *
+ * Items are written as they are passed in, so a document can be produced
+ * without building a Value. Integers use the shortest head, and reals use
+ * the smallest of half, single and double precision that holds the value
+ * exactly.
+ *
+ * Usage:
+ * \code
+ * Json::CborWriter cbor(sink);
+ * cbor.beginMap(2);
+ * cbor.writeString("co2");
+ * cbor.writeUInt(612);
+ * cbor.writeString("cTe");
+ * cbor.writeReal(24.5);
+ * if (!cbor.ok()) ...
+ * \endcode
+ *
+ * Every write returns false once the sink has refused data; ok() reports the
+ * same thing at the end.
+ */
+class JSON_API CborWriter {
+public:
+  /// Pass as a count to open a container that is closed with end().
+  static const size_t indefiniteLength = ~size_t(0);
+
+  explicit CborWriter(WriterSink& sink);
+
+  bool writeNull();
+  bool writeBool(bool value);
+  bool writeInt(LargestInt value);
+  bool writeUInt(LargestUInt value);
+  bool writeReal(double value);
+  /// Text string; \a data is expected to be UTF-8.
+  bool writeString(const char* data, size_t length);
+  bool writeString(const char* string);
+  /// Start an array of \a count items.
+  bool beginArray(size_t count = indefiniteLength);
+  /// Start a map of \a count key/value pairs, given as 2 * count items.
+  bool beginMap(size_t count = indefiniteLength);
+  /// Close the innermost container opened with indefiniteLength.
+  bool end();
+  /// Write a whole Value. Objects become maps with text keys.
+  bool writeValue(const Value& value);
+
+  bool ok() const { return ok_; }
+
+private:
+  bool writeHead(unsigned majorType, LargestUInt argument);
+  bool put(const void* data, size_t length);
+
+  WriterSink& sink_;
+  bool ok_{true};
+};
+
+/// Encode \a root as CBOR into \a sink. \return false if the sink refused
+/// data.
+bool JSON_API writeCbor(const Value& root, WriterSink& sink);
+
+/** \brief Decode one CBOR data item from [begin, end) into \a root.
+ *
+ * Arrays and maps are read without recursion. Maps need text, byte string or
+ * integer keys; integer keys become their decimal spelling. Byte strings read
+ * as strings, tags are ignored, and undefined or unassigned simple values read
+ * as null.
+ *
+ * CBOR does not record whether an integer was signed, so integers are typed
+ * as Reader types them: intValue when they fit in a LargestInt, uintValue
+ * above that, and a real below the LargestInt range. A uintValue written
+ * with writeCbor() therefore reads back as an intValue of the same value
+ * unless it exceeds Value::maxLargestInt.
+ * \param depthLimit maximum nesting of arrays and maps.
+ * \return false if the input is not exactly one well-formed item.
+ */
+bool JSON_API parseCbor(const char* begin, const char* end, Value& root,
+                        size_t depthLimit = JSONCPP_DEPRECATED_STACK_LIMIT);
+
+} // namespace Json
+
+#pragma pack(pop)
+
+#endif // JSON_CBOR_H_INCLUDED
@@ -7,19 +7,46 @@
 #define JSON_CONFIG_H_INCLUDED
 #include <cstddef>
 #include <cstdint>
-#include <istream>
 #include <memory>
-#include <ostream>
-#include <sstream>
 #include <string>
 #include <type_traits>
 
+// If non-zero, nothing in the library uses iostreams: the stream based
+// overloads (Reader::parse(IStream&), parseFromStream, operator>>,
+// operator<<, StreamWriter::write(OStream*) and StyledStreamWriter) are
+// compiled out. Parse from buffers and write through a WriterSink instead.
+#ifndef JSONCPP_NO_IOSTREAM
+#define JSONCPP_NO_IOSTREAM 0
+#endif
+
+#if !JSONCPP_NO_IOSTREAM
+#include <istream>
+#include <ostream>
+#include <sstream>
+#endif
+
 // If non-zero, the library uses exceptions to report bad input instead of C
 // assertion macros. The default is to use exceptions.
 #ifndef JSON_USE_EXCEPTION
 #define JSON_USE_EXCEPTION 1
 #endif
 
+// If non-zero, Value carries neither comments nor source offsets: the
+// comment accessors become no-ops, the readers stop collecting comments (they
+// are still skipped when allowed) and the offset accessors return 0. This
+// makes every Value node smaller. Library and clients must agree on it.
+#ifndef JSONCPP_LEAN_VALUE
+#define JSONCPP_LEAN_VALUE 0
+#endif
+
+// If non-zero, Json::String and the other containers built on Allocator<T>
+// allocate through the AllocatorHooks (see allocator.h) as Value does.
+// Json::String is then no longer std::string. Library and clients must agree
+// on it.
+#ifndef JSONCPP_USING_ALLOCATOR_HOOKS
+#define JSONCPP_USING_ALLOCATOR_HOOKS 0
+#endif
+
 // Temporary, tracked for removal with issue #982.
 #ifndef JSON_USE_NULLREF
 #define JSON_USE_NULLREF 1
@@ -126,10 +153,12 @@ using LargestUInt = UInt64;
 #endif // if defined(JSON_NO_INT64)
 
 template <typename T>
-using Allocator =
-    typename std::conditional<JSONCPP_USING_SECURE_MEMORY, SecureAllocator<T>,
-                              std::allocator<T>>::type;
+using Allocator = typename std::conditional<
+    JSONCPP_USING_SECURE_MEMORY, SecureAllocator<T>,
+    typename std::conditional<JSONCPP_USING_ALLOCATOR_HOOKS, HookAllocator<T>,
+                              std::allocator<T>>::type>::type;
 using String = std::basic_string<char, std::char_traits<char>, Allocator<char>>;
+#if !JSONCPP_NO_IOSTREAM
 using IStringStream =
     std::basic_istringstream<String::value_type, String::traits_type,
                              String::allocator_type>;
@@ -138,13 +167,16 @@ using OStringStream =
                              String::allocator_type>;
 using IStream = std::istream;
 using OStream = std::ostream;
+#endif // if !JSONCPP_NO_IOSTREAM
 } // namespace Json
 
 // Legacy names (formerly macros).
 using JSONCPP_STRING = Json::String;
+#if !JSONCPP_NO_IOSTREAM
 using JSONCPP_ISTRINGSTREAM = Json::IStringStream;
 using JSONCPP_OSTRINGSTREAM = Json::OStringStream;
 using JSONCPP_ISTREAM = Json::IStream;
 using JSONCPP_OSTREAM = Json::OStream;
+#endif // if !JSONCPP_NO_IOSTREAM
 
 #endif // JSON_CONFIG_H_INCLUDED
@@ -0,0 +1,126 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef JSON_EXTRACT_H_INCLUDED
+#define JSON_EXTRACT_H_INCLUDED
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "value.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+
+#pragma pack(push)
+#pragma pack()
+
+namespace Json {
+
+/// Maximum number of pointers handled by one extractPointers() call.
+enum { maxExtractPointers = 32 };
+
+/// Default nesting limit (Features::stackLimit_) for the values the
+/// functions below parse; the RTDB client uses the same one.
+enum { maxExtractDepth = 32 };
+
+/** \brief Pull a few values out of a JSON document without building a DOM.
+ *
+ * The document is scanned once. Subtrees that no pointer can reach are
+ * skipped structurally, without allocating. Only the addressed values are
+ * parsed into Values, after the whole document is scanned. When an object
+ * repeats a member name the last occurrence wins, as in Reader.
+ *
+ * Usage:
+ * \code
+ * const char* const paths[] = {"/access_token", "/expires_in"};
+ * Json::Value values[2];
+ * if (Json::extractPointers(begin, end, paths, 2, values)) ...
+ * \endcode
+ *
+ * \param pointers RFC 6901 JSON Pointers: "" is the whole document,
+ *        "/a/0/b" descends through member "a", index 0, then member "b".
+ *        "~0" and "~1" stand for '~' and '/' inside a reference token.
+ * \param count at most #maxExtractPointers.
+ * \param values receives one Value per pointer; it is left untouched when
+ *        the pointer does not resolve.
+ * \param found if not NULL, receives one flag per pointer.
+ * \param stackLimit nesting limit for the addressed values.
+ * \return false if a pointer is malformed, \a count is too large or the
+ *         document is malformed. Skipped subtrees are only checked for
+ *         terminated strings and balanced brackets; comments are not
+ *         accepted. An addressed value nested deeper than \a stackLimit
+ *         fails the call.
+ */
+bool JSON_API extractPointers(const char* begin, const char* end,
+                              const char* const* pointers, size_t count,
+                              Value* values, bool* found = nullptr,
+                              size_t stackLimit = maxExtractDepth);
+
+/** \brief Enumerate the member names of one object in a JSON document,
+ * in document order, without parsing the member values.
+ *
+ * Values are skipped structurally and nothing is allocated unless a name
+ * contains escape sequences, so memory use does not depend on the number of
+ * members.
+ *
+ * Usage:
+ * \code
+ * Json::MemberNameCursor cursor(begin, end);
+ * while (cursor.next())
+ *   use(cursor.name(), cursor.length());
+ * if (!cursor.ok()) ... // malformed document
+ * \endcode
+ */
+class JSON_API MemberNameCursor {
+public:
+  /** \param pointer RFC 6901 JSON Pointer to the object, see
+   *        extractPointers(); "" is the top-level value.
+   */
+  MemberNameCursor(const char* begin, const char* end,
+                   const char* pointer = "");
+
+  /** Move to the next member.
+   * \return false once the object is exhausted or on error; see ok().
+   */
+  bool next();
+
+  /** The current name: a view into the document, or into a decoded copy if
+   * it contains escape sequences. Valid until the next call to next().
+   */
+  const char* name() const { return name_; }
+  size_t length() const { return length_; }
+
+  /// False if the document or the pointer is malformed, or the pointer does
+  /// not address an object.
+  bool ok() const { return state_ != failed; }
+
+private:
+  enum State : unsigned char { first, inside, done, failed };
+
+  const char* cur_;
+  const char* end_;
+  const char* name_{};
+  size_t length_{0};
+  String decoded_;
+  State state_;
+};
+
+/** \brief Call \a callback with the name of each member of the object at
+ * \a pointer, in document order, skipping the member values.
+ *
+ * Built on MemberNameCursor. Names are passed as views into the document
+ * unless they contain escape sequences, in which case a decoded temporary is
+ * passed. The callback returns false to stop early.
+ * \return false if the document or the pointer is malformed, or the pointer
+ *         does not address an object.
+ */
+bool JSON_API forEachMemberName(const char* begin, const char* end,
+                                const char* pointer,
+                                bool (*callback)(const char* name,
+                                                 size_t length, void* context),
+                                void* context);
+
+} // namespace Json
+
+#pragma pack(pop)
+
+#endif // JSON_EXTRACT_H_INCLUDED
@@ -6,8 +6,12 @@
 #ifndef JSON_JSON_H_INCLUDED
 #define JSON_JSON_H_INCLUDED
 
+#include "bind.h"
+#include "cbor.h"
 #include "config.h"
+#include "extract.h"
 #include "json_features.h"
+#include "patch.h"
 #include "reader.h"
 #include "value.h"
 #include "writer.h"
@@ -0,0 +1,524 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "json_tool.h"
+#include <cbor.h>
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Json {
+
+namespace {
+
+enum MajorType : unsigned {
+  majorUnsigned = 0,
+  majorNegative = 1,
+  majorBytes = 2,
+  majorText = 3,
+  majorArray = 4,
+  majorMap = 5,
+  majorTag = 6,
+  majorSimple = 7
+};
+
+enum : unsigned char {
+  cborFalse = 0xf4,
+  cborTrue = 0xf5,
+  cborNull = 0xf6,
+  cborHalf = 0xf9,
+  cborFloat = 0xfa,
+  cborDouble = 0xfb,
+  cborBreak = 0xff
+};
+
+/// Binary16 bits of \a value if it converts exactly. NaN is not handled.
+bool toHalf(float value, uint16_t& half) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const int exponent = static_cast<int>((bits >> 23) & 0xff);
+  const uint32_t mantissa = bits & 0x7fffff;
+  if (exponent == 0xff || (exponent == 0 && mantissa == 0)) { // inf or zero
+    half = static_cast<uint16_t>(sign | (exponent ? 0x7c00 : 0));
+    return true;
+  }
+  if (exponent == 0)
+    return false; // binary32 subnormals are below the binary16 range
+  const int e = exponent - 127;
+  if (e > 15 || e < -24)
+    return false;
+  if (e >= -14) {
+    if (mantissa & 0x1fff)
+      return false;
+    half = static_cast<uint16_t>(sign | ((e + 15) << 10) | (mantissa >> 13));
+    return true;
+  }
+  // Subnormal binary16: value == m * 2^-24 with m < 1024.
+  const uint32_t full = mantissa | 0x800000;
+  const int shift = -e - 1;
+  if (full & ((uint32_t(1) << shift) - 1))
+    return false;
+  half = static_cast<uint16_t>(sign | (full >> shift));
+  return true;
+}
+
+double fromHalf(uint16_t half) {
+  const int exponent = (half >> 10) & 0x1f;
+  const int mantissa = half & 0x3ff;
+  double value;
+  if (exponent == 0)
+    value = std::ldexp(mantissa, -24);
+  else if (exponent != 31)
+    value = std::ldexp(mantissa + 1024, exponent - 25);
+  else
+    value = mantissa == 0 ? INFINITY : NAN;
+  return (half & 0x8000) ? -value : value;
+}
+
+} // namespace
+
+// Class CborWriter
+// //////////////////////////////////////////////////////////////////
+
+const size_t CborWriter::indefiniteLength;
+
+CborWriter::CborWriter(WriterSink& sink) : sink_(sink) {}
+
+bool CborWriter::put(const void* data, size_t length) {
+  ok_ = ok_ && sink_.write(static_cast<const char*>(data), length);
+  return ok_;
+}
+
+bool CborWriter::writeHead(unsigned majorType, LargestUInt argument) {
+  unsigned char head[9];
+  const auto type = static_cast<unsigned char>(majorType << 5);
+  size_t length;
+  if (argument < 24) {
+    head[0] = static_cast<unsigned char>(type | argument);
+    length = 1;
+  } else if (argument <= 0xff) {
+    head[0] = type | 24;
+    length = 2;
+  } else if (argument <= 0xffff) {
+    head[0] = type | 25;
+    length = 3;
+  } else if (argument <= 0xffffffffU) {
+    head[0] = type | 26;
+    length = 5;
+  } else {
+    head[0] = type | 27;
+    length = 9;
+  }
+  for (size_t i = length - 1; i > 0; --i, argument >>= 8)
+    head[i] = static_cast<unsigned char>(argument & 0xff);
+  return put(head, length);
+}
+
+bool CborWriter::writeNull() {
+  const unsigned char byte = cborNull;
+  return put(&byte, 1);
+}
+
+bool CborWriter::writeBool(bool value) {
+  const unsigned char byte = value ? cborTrue : cborFalse;
+  return put(&byte, 1);
+}
+
+bool CborWriter::writeInt(LargestInt value) {
+  if (value >= 0)
+    return writeHead(majorUnsigned, static_cast<LargestUInt>(value));
+  // -1 - value without overflowing on the minimum.
+  return writeHead(majorNegative, ~static_cast<LargestUInt>(value));
+}
+
+bool CborWriter::writeUInt(LargestUInt value) {
+  return writeHead(majorUnsigned, value);
+}
+
+bool CborWriter::writeReal(double value) {
+  unsigned char item[9];
+  size_t length;
+  uint16_t half;
+  const auto single = static_cast<float>(value);
+  if (std::isnan(value)) {
+    item[0] = cborHalf;
+    item[1] = 0x7e; // the canonical quiet NaN
+    item[2] = 0x00;
+    length = 3;
+  } else if (static_cast<double>(single) == value && toHalf(single, half)) {
+    item[0] = cborHalf;
+    item[1] = static_cast<unsigned char>(half >> 8);
+    item[2] = static_cast<unsigned char>(half & 0xff);
+    length = 3;
+  } else if (static_cast<double>(single) == value) {
+    uint32_t bits;
+    memcpy(&bits, &single, sizeof(bits));
+    item[0] = cborFloat;
+    for (int i = 4; i > 0; --i, bits >>= 8)
+      item[i] = static_cast<unsigned char>(bits & 0xff);
+    length = 5;
+  } else {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    item[0] = cborDouble;
+    for (int i = 8; i > 0; --i, bits >>= 8)
+      item[i] = static_cast<unsigned char>(bits & 0xff);
+    length = 9;
+  }
+  return put(item, length);
+}
+
+bool CborWriter::writeString(const char* data, size_t length) {
+  return writeHead(majorText, length) && put(data, length);
+}
+
+bool CborWriter::writeString(const char* string) {
+  return writeString(string, strlen(string));
+}
+
+bool CborWriter::beginArray(size_t count) {
+  if (count == indefiniteLength) {
+    const unsigned char byte = (majorArray << 5) | 31;
+    return put(&byte, 1);
+  }
+  return writeHead(majorArray, count);
+}
+
+bool CborWriter::beginMap(size_t count) {
+  if (count == indefiniteLength) {
+    const unsigned char byte = (majorMap << 5) | 31;
+    return put(&byte, 1);
+  }
+  return writeHead(majorMap, count);
+}
+
+bool CborWriter::end() {
+  const unsigned char byte = cborBreak;
+  return put(&byte, 1);
+}
+
+bool CborWriter::writeValue(const Value& value) {
+  switch (value.type()) {
+  case nullValue:
+    return writeNull();
+  case intValue:
+    return writeInt(value.asLargestInt());
+  case uintValue:
+    return writeUInt(value.asLargestUInt());
+  case realValue:
+    return writeReal(value.asDouble());
+  case stringValue: {
+    char const* begin;
+    char const* end;
+    if (!value.getString(&begin, &end))
+      return writeString("", 0);
+    return writeString(begin, static_cast<size_t>(end - begin));
+  }
+  case booleanValue:
+    return writeBool(value.asBool());
+  case arrayValue: {
+    const ArrayIndex size = value.size();
+    if (!beginArray(size))
+      return false;
+    for (ArrayIndex index = 0; index < size; ++index) {
+      if (!writeValue(value[index]))
+        return false;
+    }
+    return true;
+  }
+  case objectValue: {
+    if (!beginMap(value.size()))
+      return false;
+    for (auto it = value.begin(); it != value.end(); ++it) {
+      char const* end;
+      char const* name = it.memberName(&end);
+      if (!writeString(name, static_cast<size_t>(end - name)) ||
+          !writeValue(*it))
+        return false;
+    }
+    return true;
+  }
+  }
+  return false;
+}
+
+bool writeCbor(const Value& root, WriterSink& sink) {
+  CborWriter writer(sink);
+  return writer.writeValue(root) && sink.flush();
+}
+
+// CBOR decoding
+// //////////////////////////////////////////////////////////////////
+
+namespace {
+
+class CborParser {
+public:
+  CborParser(const char* begin, const char* end, size_t depthLimit)
+      : cur_(reinterpret_cast<const unsigned char*>(begin)),
+        end_(reinterpret_cast<const unsigned char*>(end)),
+        depthLimit_(depthLimit) {}
+
+  bool parse(Value& root);
+
+private:
+  // One per open array or map.
+  struct Frame {
+    Value* container;
+    uint64_t remaining; // items left, keys included; unused if indefinite
+    bool indefinite;
+    bool expectKey;
+  };
+
+  bool readHead(unsigned& majorType, unsigned& info, uint64_t& argument);
+  bool readString(unsigned majorType, unsigned info, uint64_t length,
+                  String& out);
+  bool readKey(unsigned majorType, unsigned info, uint64_t argument);
+  bool readScalar(unsigned majorType, unsigned info, uint64_t argument,
+                  Value& out);
+  void itemDone();
+
+  const unsigned char* cur_;
+  const unsigned char* end_;
+  size_t depthLimit_;
+  std::vector<Frame, HookAllocator<Frame>> stack_;
+  String key_;
+};
+
+bool CborParser::readHead(unsigned& majorType, unsigned& info,
+                          uint64_t& argument) {
+  if (cur_ == end_)
+    return false;
+  majorType = *cur_ >> 5;
+  info = *cur_ & 0x1f;
+  ++cur_;
+  if (info < 24) {
+    argument = info;
+    return true;
+  }
+  if (info == 31) {
+    argument = 0;
+    return true; // indefinite length or break
+  }
+  if (info > 27)
+    return false; // reserved
+  const size_t length = size_t(1) << (info - 24);
+  if (static_cast<size_t>(end_ - cur_) < length)
+    return false;
+  argument = 0;
+  for (size_t i = 0; i < length; ++i)
+    argument = (argument << 8) | *cur_++;
+  return true;
+}
+
+bool CborParser::readString(unsigned majorType, unsigned info,
+                            uint64_t length, String& out) {
+  if (info != 31) {
+    if (length > static_cast<uint64_t>(end_ - cur_))
+      return false;
+    out.assign(reinterpret_cast<const char*>(cur_),
+               static_cast<size_t>(length));
+    cur_ += length;
+    return true;
+  }
+  // Indefinite length: definite chunks of the same type up to a break.
+  out.clear();
+  for (;;) {
+    if (cur_ == end_)
+      return false;
+    if (*cur_ == cborBreak) {
+      ++cur_;
+      return true;
+    }
+    unsigned chunkType;
+    unsigned chunkInfo;
+    uint64_t chunkLength;
+    if (!readHead(chunkType, chunkInfo, chunkLength) ||
+        chunkType != majorType || chunkInfo == 31 ||
+        chunkLength > static_cast<uint64_t>(end_ - cur_))
+      return false;
+    out.append(reinterpret_cast<const char*>(cur_),
+               static_cast<size_t>(chunkLength));
+    cur_ += chunkLength;
+  }
+}
+
+bool CborParser::readKey(unsigned majorType, unsigned info,
+                         uint64_t argument) {
+  if (majorType == majorBytes || majorType == majorText)
+    return readString(majorType, info, argument, key_);
+  if ((majorType != majorUnsigned && majorType != majorNegative) ||
+      info == 31)
+    return false;
+  UIntToStringBuffer buffer;
+  char* current = buffer + sizeof(buffer);
+  if (majorType == majorUnsigned) {
+    uintToString(argument, current);
+  } else if (argument == ~uint64_t(0)) {
+    // -2^64 does not fit in 64 bits, unlike its magnitude minus one.
+    key_ = "-18446744073709551616";
+    return true;
+  } else {
+    uintToString(argument + 1, current);
+    *--current = '-';
+  }
+  key_ = current;
+  return true;
+}
+
+bool CborParser::readScalar(unsigned majorType, unsigned info,
+                            uint64_t argument, Value& out) {
+  switch (majorType) {
+  case majorUnsigned:
+    if (info == 31)
+      return false;
+    if (argument <= static_cast<uint64_t>(Value::maxLargestInt))
+      out = Value(static_cast<LargestInt>(argument));
+    else
+      out = Value(static_cast<LargestUInt>(argument));
+    return true;
+  case majorNegative:
+    if (info == 31)
+      return false;
+    if (argument <= static_cast<uint64_t>(Value::maxLargestInt))
+      out = Value(-1 - static_cast<LargestInt>(argument));
+    else
+      out = Value(-1.0 - static_cast<double>(argument));
+    return true;
+  case majorBytes:
+  case majorText: {
+    String string;
+    if (!readString(majorType, info, argument, string))
+      return false;
+    out = Value(string.data(), string.data() + string.size());
+    return true;
+  }
+  case majorSimple:
+    switch (info) {
+    case 20:
+    case 21:
+      out = Value(info == 21);
+      return true;
+    case 25:
+      out = Value(fromHalf(static_cast<uint16_t>(argument)));
+      return true;
+    case 26: {
+      const auto bits = static_cast<uint32_t>(argument);
+      float single;
+      memcpy(&single, &bits, sizeof(single));
+      out = Value(static_cast<double>(single));
+      return true;
+    }
+    case 27: {
+      double real;
+      memcpy(&real, &argument, sizeof(real));
+      out = Value(real);
+      return true;
+    }
+    case 31:
+      return false; // a break outside an indefinite container
+    default:
+      out = Value(); // null, undefined and unassigned simple values
+      return true;
+    }
+  default:
+    return false;
+  }
+}
+
+/// Count a finished item against its container, closing every container it
+/// completes.
+void CborParser::itemDone() {
+  while (!stack_.empty()) {
+    Frame& frame = stack_.back();
+    if (frame.container->isObject())
+      frame.expectKey = !frame.expectKey;
+    if (frame.indefinite || --frame.remaining != 0)
+      return;
+    stack_.pop_back();
+  }
+}
+
+bool CborParser::parse(Value& root) {
+  root = Value();
+  bool started = false;
+  while (!started || !stack_.empty()) {
+    unsigned majorType;
+    unsigned info;
+    uint64_t argument;
+    if (!readHead(majorType, info, argument))
+      return false;
+    while (majorType == majorTag) { // tags only annotate the next item
+      if (info == 31 || !readHead(majorType, info, argument))
+        return false;
+    }
+
+    if (!stack_.empty() && majorType == majorSimple && info == 31) {
+      Frame& frame = stack_.back();
+      if (!frame.indefinite || !frame.expectKey)
+        return false;
+      stack_.pop_back();
+      itemDone();
+      continue;
+    }
+
+    Value* slot;
+    if (!started) {
+      slot = &root;
+      started = true;
+    } else {
+      Frame& frame = stack_.back();
+      if (frame.container->isObject()) {
+        if (frame.expectKey) {
+          if (!readKey(majorType, info, argument))
+            return false;
+          itemDone();
+          continue;
+        }
+        slot = frame.container->demand(key_.data(), key_.data() + key_.size());
+      } else {
+        slot = &frame.container->append(Value());
+      }
+    }
+
+    if (majorType == majorArray || majorType == majorMap) {
+      if (stack_.size() >= depthLimit_)
+        return false;
+      *slot = Value(majorType == majorArray ? arrayValue : objectValue);
+      const bool indefinite = info == 31;
+      uint64_t items = argument;
+      if (majorType == majorMap && !indefinite) {
+        if (items > (~uint64_t(0) >> 1))
+          return false;
+        items *= 2;
+      }
+      // Each item takes at least one byte.
+      if (!indefinite && items > static_cast<uint64_t>(end_ - cur_))
+        return false;
+      if (indefinite || items != 0) {
+        stack_.push_back(Frame{slot, items, indefinite, true});
+        continue;
+      }
+    } else if (!readScalar(majorType, info, argument, *slot)) {
+      return false;
+    }
+    itemDone();
+  }
+  return cur_ == end_;
+}
+
+} // namespace
+
+bool parseCbor(const char* begin, const char* end, Value& root,
+               size_t depthLimit) {
+  CborParser parser(begin, end, depthLimit);
+  return parser.parse(root);
+}
+
+} // namespace Json
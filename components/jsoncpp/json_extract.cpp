@@ -0,0 +1,633 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "json_tool.h"
+#include <bind.h>
+#include <extract.h>
+#include <reader.h>
+#endif // if !defined(JSON_IS_AMALGAMATION)
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace Json {
+
+namespace {
+
+using PointerSet = uint32_t;
+
+static_assert(sizeof(PointerSet) * 8 >= maxExtractPointers,
+              "PointerSet too small for maxExtractPointers");
+
+/// Forward-only cursor that skips JSON values without materializing them.
+class Scanner {
+public:
+  Scanner(const char* begin, const char* end) : cur_(begin), end_(end) {}
+
+  void skipSpace() {
+    while (cur_ != end_ &&
+           (*cur_ == ' ' || *cur_ == '\t' || *cur_ == '\n' || *cur_ == '\r'))
+      ++cur_;
+  }
+
+  bool consume(char c) {
+    skipSpace();
+    if (cur_ == end_ || *cur_ != c)
+      return false;
+    ++cur_;
+    return true;
+  }
+
+  char peek() {
+    skipSpace();
+    return cur_ == end_ ? '\0' : *cur_;
+  }
+
+  /// \pre *cur_ == '"'. Leaves cur_ after the closing quote.
+  bool skipString() {
+    ++cur_;
+    for (;;) {
+      cur_ = findQuoteOrBackslash(cur_, end_, '"');
+      if (cur_ == end_)
+        return false;
+      if (*cur_++ == '"')
+        return true;
+      if (cur_ == end_)
+        return false;
+      ++cur_; // escaped character
+    }
+  }
+
+  /// Skip one value, checking only string termination and bracket balance.
+  bool skipValue() {
+    skipSpace();
+    if (cur_ == end_)
+      return false;
+    if (*cur_ == '"')
+      return skipString();
+    if (*cur_ != '{' && *cur_ != '[') {
+      const char* start = cur_;
+      while (cur_ != end_ && *cur_ != ',' && *cur_ != '}' && *cur_ != ']' &&
+             *cur_ != ' ' && *cur_ != '\t' && *cur_ != '\n' && *cur_ != '\r')
+        ++cur_;
+      return cur_ != start;
+    }
+    size_t depth = 0;
+    while (cur_ != end_) {
+      const char c = *cur_;
+      if (c == '"') {
+        if (!skipString())
+          return false;
+        continue;
+      }
+      ++cur_;
+      if (c == '{' || c == '[') {
+        ++depth;
+      } else if (c == '}' || c == ']') {
+        if (--depth == 0)
+          return true;
+      }
+    }
+    return false;
+  }
+
+  /// Read a member name; [name, nameEnd) excludes the quotes.
+  bool readName(const char*& name, const char*& nameEnd) {
+    if (peek() != '"')
+      return false;
+    name = cur_ + 1;
+    if (!skipString())
+      return false;
+    nameEnd = cur_ - 1;
+    return true;
+  }
+
+  const char* cur_;
+  const char* end_;
+};
+
+/// Decode a string body that contains escape sequences.
+bool decodeName(const char* name, const char* nameEnd, String& decoded) {
+  String quoted;
+  quoted.reserve(static_cast<size_t>(nameEnd - name) + 2);
+  quoted += '"';
+  quoted.append(name, nameEnd);
+  quoted += '"';
+  Features features;
+  features.stackLimit_ = maxExtractDepth;
+  Reader reader(features);
+  Value value;
+  if (!reader.parse(quoted.data(), quoted.data() + quoted.size(), value,
+                    false) ||
+      !value.isString())
+    return false;
+  decoded = value.asString();
+  return true;
+}
+
+/** Compare the reference token starting at \a token (just after its '/')
+ * with [name, nameEnd). On a match, \a after points at the next '/' or NUL.
+ */
+bool tokenMatches(const char* token, const char* name, const char* nameEnd,
+                  const char*& after) {
+  for (;;) {
+    char c = *token;
+    if (c == '\0' || c == '/')
+      break;
+    ++token;
+    if (c == '~') {
+      c = *token == '0' ? '~' : '/';
+      ++token;
+    }
+    if (name == nameEnd || *name != c)
+      return false;
+    ++name;
+  }
+  after = token;
+  return name == nameEnd;
+}
+
+bool tokenMatchesIndex(const char* token, ArrayIndex index,
+                       const char*& after) {
+  UIntToStringBuffer buffer;
+  char* current = buffer + sizeof(buffer);
+  uintToString(index, current);
+  return tokenMatches(token, current, buffer + sizeof(buffer) - 1, after);
+}
+
+bool validPointer(const char* pointer) {
+  if (*pointer != '\0' && *pointer != '/')
+    return false;
+  for (; *pointer; ++pointer) {
+    if (*pointer == '~' && pointer[1] != '0' && pointer[1] != '1')
+      return false;
+  }
+  return true;
+}
+
+/// Walk an already materialized \a value along the tokens left in \a pointer.
+const Value* resolveInValue(const Value& value, const char* pointer) {
+  const Value* current = &value;
+  while (*pointer == '/') {
+    ++pointer;
+    String token;
+    for (; *pointer && *pointer != '/'; ++pointer) {
+      if (*pointer == '~') {
+        ++pointer;
+        token += *pointer == '0' ? '~' : '/';
+      } else {
+        token += *pointer;
+      }
+    }
+    if (current->isObject()) {
+      current = current->find(token.data(), token.data() + token.size());
+    } else if (current->isArray()) {
+      char const* digit = token.c_str();
+      ArrayIndex index = 0;
+      if (token.empty() || (token.size() > 1 && token[0] == '0'))
+        return nullptr;
+      for (; *digit; ++digit) {
+        if (*digit < '0' || *digit > '9')
+          return nullptr;
+        index = index * 10 + static_cast<ArrayIndex>(*digit - '0');
+      }
+      current = index < current->size() ? &(*current)[index] : nullptr;
+    } else {
+      return nullptr;
+    }
+    if (current == nullptr)
+      return nullptr;
+  }
+  return current;
+}
+
+class Extractor {
+public:
+  Extractor(const char* begin, const char* end, Value* values, bool* found,
+            size_t stackLimit)
+      : scanner_(begin, end), values_(values), found_(found),
+        stackLimit_(stackLimit) {}
+
+  bool scan(PointerSet candidates, const char* const* positions);
+  bool materialize();
+
+  Scanner scanner_;
+
+private:
+  Value* values_;
+  bool* found_;
+  size_t stackLimit_;
+  /// Pointers whose last matching member has been seen, the start of the
+  /// value it reached and what is left of the pointer below that value.
+  PointerSet reached_{0};
+  const char* starts_[maxExtractPointers];
+  const char* rests_[maxExtractPointers];
+};
+
+/** Scan the value at the cursor. \a candidates are the pointers whose
+ * leading tokens matched the path so far; positions[i] is what is left of
+ * pointer i (empty when the current value is its target).
+ */
+bool Extractor::scan(PointerSet candidates, const char* const* positions) {
+  PointerSet here = 0;
+  PointerSet deeper = 0;
+  for (int i = 0; i < maxExtractPointers; ++i) {
+    const PointerSet bit = PointerSet(1) << i;
+    if (candidates & bit)
+      (*positions[i] == '\0' ? here : deeper) |= bit;
+  }
+  const char kind = scanner_.peek();
+  if (here != 0) {
+    // Remember where the value is; it is parsed once the whole document is
+    // scanned, since a later member with the same name replaces it.
+    for (int i = 0; i < maxExtractPointers; ++i) {
+      if (candidates & (PointerSet(1) << i)) {
+        starts_[i] = scanner_.cur_;
+        rests_[i] = positions[i];
+      }
+    }
+    reached_ |= candidates;
+    return scanner_.skipValue();
+  }
+  if (kind != '{' && kind != '[')
+    return scanner_.skipValue(); // cannot descend into a scalar
+
+  const char* next[maxExtractPointers];
+  ++scanner_.cur_;
+  const char close = kind == '{' ? '}' : ']';
+  for (ArrayIndex index = 0; !scanner_.consume(close); ++index) {
+    if (index > 0 && !scanner_.consume(','))
+      return false;
+    PointerSet matched = 0;
+    if (kind == '{') {
+      const char* name;
+      const char* nameEnd;
+      if (!scanner_.readName(name, nameEnd) || !scanner_.consume(':'))
+        return false;
+      String decoded;
+      if (std::memchr(name, '\\', static_cast<size_t>(nameEnd - name))) {
+        if (!decodeName(name, nameEnd, decoded))
+          return false;
+        name = decoded.data();
+        nameEnd = name + decoded.size();
+      }
+      for (int i = 0; i < maxExtractPointers; ++i) {
+        const PointerSet bit = PointerSet(1) << i;
+        if ((deeper & bit) &&
+            tokenMatches(positions[i] + 1, name, nameEnd, next[i]))
+          matched |= bit;
+      }
+    } else {
+      for (int i = 0; i < maxExtractPointers; ++i) {
+        const PointerSet bit = PointerSet(1) << i;
+        if ((deeper & bit) &&
+            tokenMatchesIndex(positions[i] + 1, index, next[i]))
+          matched |= bit;
+      }
+    }
+    // As in Reader, the last of several members with the same name wins:
+    // forget what an earlier one reached.
+    reached_ &= ~matched;
+    if (!(matched ? scan(matched, next) : scanner_.skipValue()))
+      return false;
+  }
+  return true;
+}
+
+/// Parse the values the scan reached, once per distinct value.
+bool Extractor::materialize() {
+  Features features;
+  features.stackLimit_ = stackLimit_;
+  PointerSet pending = reached_;
+  for (int first = 0; first < maxExtractPointers; ++first) {
+    if (!(pending & (PointerSet(1) << first)))
+      continue;
+    const char* start = starts_[first];
+    Scanner scanner(start, scanner_.end_);
+    if (!scanner.skipValue())
+      return false;
+    const char* end = scanner.cur_;
+    Value value;
+    const auto length = static_cast<size_t>(end - start);
+    if (*start == '"' &&
+        !std::memchr(start, '\\', length)) { // the usual case: a plain string
+      value = Value(start + 1, end - 1);
+    } else if (length == 4 && std::memcmp(start, "true", 4) == 0) {
+      value = true;
+    } else if (length == 5 && std::memcmp(start, "false", 5) == 0) {
+      value = false;
+    } else if (!(length == 4 && std::memcmp(start, "null", 4) == 0)) {
+      Reader reader(features);
+      if (!reader.parse(start, end, value, false))
+        return false;
+    }
+    for (int i = first; i < maxExtractPointers; ++i) {
+      const PointerSet bit = PointerSet(1) << i;
+      if (!(pending & bit) || starts_[i] != start)
+        continue;
+      pending &= ~bit;
+      const Value* target = resolveInValue(value, rests_[i]);
+      if (target == nullptr)
+        continue;
+      values_[i] = *target;
+      if (found_)
+        found_[i] = true;
+    }
+  }
+  return true;
+}
+
+/// Position \a scanner on the value addressed by \a pointer.
+bool seek(Scanner& scanner, const char* pointer) {
+  while (*pointer == '/') {
+    const char* token = pointer + 1;
+    const char kind = scanner.peek();
+    if (kind != '{' && kind != '[')
+      return false;
+    ++scanner.cur_;
+    const char close = kind == '{' ? '}' : ']';
+    if (scanner.consume(close))
+      return false;
+    for (ArrayIndex index = 0;; ++index) {
+      bool matched;
+      if (kind == '{') {
+        const char* name;
+        const char* nameEnd;
+        if (!scanner.readName(name, nameEnd) || !scanner.consume(':'))
+          return false;
+        String decoded;
+        if (std::memchr(name, '\\', static_cast<size_t>(nameEnd - name))) {
+          if (!decodeName(name, nameEnd, decoded))
+            return false;
+          name = decoded.data();
+          nameEnd = name + decoded.size();
+        }
+        matched = tokenMatches(token, name, nameEnd, pointer);
+      } else {
+        matched = tokenMatchesIndex(token, index, pointer);
+      }
+      if (matched)
+        break;
+      if (!scanner.skipValue())
+        return false;
+      if (scanner.consume(close) || !scanner.consume(','))
+        return false;
+    }
+  }
+  return true;
+}
+
+/// Store \a value in an integer member of \a size bytes if it fits.
+template <class Int>
+bool storeBound(void* member, LargestUInt magnitude, bool negative) {
+  using Limits = std::numeric_limits<Int>;
+  if (negative ? magnitude > LargestUInt(0) - LargestUInt(Limits::min())
+               : magnitude > LargestUInt(Limits::max()))
+    return false;
+  const Int value =
+      negative ? static_cast<Int>(0 - magnitude) : static_cast<Int>(magnitude);
+  memcpy(member, &value, sizeof(value));
+  return true;
+}
+
+bool readBoundInteger(const BoundField& field, void* member,
+                      const char* begin, const char* end) {
+  const bool negative = begin != end && *begin == '-';
+  if (negative && field.type == BindType::unsignedField)
+    return false;
+  const char* p = begin + (negative ? 1 : 0);
+  if (p == end)
+    return false;
+  const LargestUInt limit = Value::maxLargestUInt / 10;
+  LargestUInt magnitude = 0;
+  for (; p != end; ++p) {
+    if (*p < '0' || *p > '9')
+      return false;
+    const auto digit = static_cast<unsigned>(*p - '0');
+    if (magnitude > limit ||
+        (magnitude == limit && digit > Value::maxLargestUInt % 10))
+      return false;
+    magnitude = magnitude * 10 + digit;
+  }
+  if (field.type == BindType::signedField) {
+    switch (field.size) {
+    case 1:
+      return storeBound<int8_t>(member, magnitude, negative);
+    case 2:
+      return storeBound<int16_t>(member, magnitude, negative);
+    case 4:
+      return storeBound<int32_t>(member, magnitude, negative);
+    default:
+      return storeBound<int64_t>(member, magnitude, negative);
+    }
+  }
+  switch (field.size) {
+  case 1:
+    return storeBound<uint8_t>(member, magnitude, false);
+  case 2:
+    return storeBound<uint16_t>(member, magnitude, false);
+  case 4:
+    return storeBound<uint32_t>(member, magnitude, false);
+  default:
+    return storeBound<uint64_t>(member, magnitude, false);
+  }
+}
+
+/// Assign the value token [begin, end) to a bound member.
+bool readBoundValue(const BoundField& field, void* member, const char* begin,
+                    const char* end) {
+  const auto length = static_cast<size_t>(end - begin);
+  switch (field.type) {
+  case BindType::boolField:
+    if (length == 4 && std::memcmp(begin, "true", 4) == 0)
+      *static_cast<bool*>(member) = true;
+    else if (length == 5 && std::memcmp(begin, "false", 5) == 0)
+      *static_cast<bool*>(member) = false;
+    else
+      return false;
+    return true;
+  case BindType::signedField:
+  case BindType::unsignedField:
+    return readBoundInteger(field, member, begin, end);
+  case BindType::floatField:
+  case BindType::doubleField: {
+    double value;
+    if (!decodeRealToken(begin, end, value))
+      return false;
+    if (field.type == BindType::floatField)
+      *static_cast<float*>(member) = static_cast<float>(value);
+    else
+      *static_cast<double*>(member) = value;
+    return true;
+  }
+  case BindType::charsField:
+  case BindType::stringField: {
+    if (*begin != '"')
+      return false;
+    const char* chars = begin + 1;
+    const char* charsEnd = end - 1;
+    String decoded;
+    if (std::memchr(chars, '\\', static_cast<size_t>(charsEnd - chars))) {
+      if (!decodeName(chars, charsEnd, decoded))
+        return false;
+      chars = decoded.data();
+      charsEnd = chars + decoded.size();
+    }
+    const auto size = static_cast<size_t>(charsEnd - chars);
+    if (field.type == BindType::stringField) {
+      static_cast<String*>(member)->assign(chars, size);
+      return true;
+    }
+    if (size >= field.size)
+      return false;
+    memcpy(member, chars, size);
+    static_cast<char*>(member)[size] = '\0';
+    return true;
+  }
+  case BindType::cStringField:
+    break;
+  }
+  return false;
+}
+
+} // namespace
+
+bool extractPointers(const char* begin, const char* end,
+                     const char* const* pointers, size_t count, Value* values,
+                     bool* found, size_t stackLimit) {
+  if (count > maxExtractPointers)
+    return false;
+  Extractor extractor(begin, end, values, found, stackLimit);
+  PointerSet all = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (!validPointer(pointers[i]))
+      return false;
+    all |= PointerSet(1) << i;
+    if (found)
+      found[i] = false;
+  }
+  if (count == 0)
+    return true;
+  return extractor.scan(all, pointers) && extractor.materialize();
+}
+
+// Class MemberNameCursor
+// //////////////////////////////////////////////////////////////////
+
+MemberNameCursor::MemberNameCursor(const char* begin, const char* end,
+                                   const char* pointer)
+    : cur_(begin), end_(end) {
+  Scanner scanner(begin, end);
+  if (!validPointer(pointer) || !seek(scanner, pointer) ||
+      !scanner.consume('{'))
+    state_ = failed;
+  else
+    state_ = scanner.consume('}') ? done : first;
+  cur_ = scanner.cur_;
+}
+
+bool MemberNameCursor::next() {
+  if (state_ == done || state_ == failed)
+    return false;
+  Scanner scanner(cur_, end_);
+  const bool skipCurrent = state_ == inside;
+  state_ = failed; // until the name below is read
+  if (skipCurrent) {
+    if (!scanner.skipValue())
+      return false;
+    if (scanner.consume('}')) {
+      state_ = done;
+      return false;
+    }
+    if (!scanner.consume(','))
+      return false;
+  }
+  const char* name;
+  const char* nameEnd;
+  if (!scanner.readName(name, nameEnd) || !scanner.consume(':'))
+    return false;
+  if (std::memchr(name, '\\', static_cast<size_t>(nameEnd - name))) {
+    if (!decodeName(name, nameEnd, decoded_))
+      return false;
+    name = decoded_.data();
+    nameEnd = name + decoded_.size();
+  }
+  name_ = name;
+  length_ = static_cast<size_t>(nameEnd - name);
+  cur_ = scanner.cur_;
+  state_ = inside;
+  return true;
+}
+
+bool forEachMemberName(const char* begin, const char* end,
+                       const char* pointer,
+                       bool (*callback)(const char* name, size_t length,
+                                        void* context),
+                       void* context) {
+  MemberNameCursor cursor(begin, end, pointer);
+  while (cursor.next()) {
+    if (!callback(cursor.name(), cursor.length(), context))
+      return true;
+  }
+  return cursor.ok();
+}
+
+bool readBoundFields(const char* begin, const char* end,
+                     const BoundField* const* fields, void* const* members,
+                     size_t count, bool* found) {
+  if (found)
+    std::fill(found, found + count, false);
+  Scanner scanner(begin, end);
+  if (!scanner.consume('{'))
+    return false;
+  if (scanner.consume('}'))
+    return true;
+  size_t hint = 0; // documents usually list members in table order
+  for (;;) {
+    const char* name;
+    const char* nameEnd;
+    if (!scanner.readName(name, nameEnd) || !scanner.consume(':'))
+      return false;
+    String decoded;
+    if (std::memchr(name, '\\', static_cast<size_t>(nameEnd - name))) {
+      if (!decodeName(name, nameEnd, decoded))
+        return false;
+      name = decoded.data();
+      nameEnd = name + decoded.size();
+    }
+    const auto length = static_cast<size_t>(nameEnd - name);
+    size_t match = count;
+    for (size_t n = 0; n < count; ++n) {
+      const size_t i = (hint + n) % count;
+      const BoundField& field = *fields[i];
+      if (field.keyLength == length + 4 &&
+          std::memcmp(field.key + 2, name, length) == 0) {
+        match = i;
+        break;
+      }
+    }
+    const char* value = (scanner.skipSpace(), scanner.cur_);
+    if (!scanner.skipValue())
+      return false;
+    const auto valueLength = static_cast<size_t>(scanner.cur_ - value);
+    if (match != count &&
+        !(valueLength == 4 && std::memcmp(value, "null", 4) == 0)) {
+      if (!readBoundValue(*fields[match], members[match], value,
+                          scanner.cur_))
+        return false;
+      if (found)
+        found[match] = true;
+      hint = match + 1;
+    }
+    if (scanner.consume('}'))
+      return true;
+    if (!scanner.consume(','))
+      return false;
+  }
+}
+
+} // namespace Json
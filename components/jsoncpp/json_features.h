@@ -10,6 +10,12 @@
 #include "forwards.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
 
+// Define JSONCPP_DEPRECATED_STACK_LIMIT as an appropriate integer at compile
+// time to change the default stack limit
+#if !defined(JSONCPP_DEPRECATED_STACK_LIMIT)
+#define JSONCPP_DEPRECATED_STACK_LIMIT 1000
+#endif
+
 #pragma pack(push)
 #pragma pack()
 
@@ -53,6 +59,10 @@ public:
 
   /// \c true if numeric object key are allowed. Default: \c false.
   bool allowNumericKeys_{false};
+
+  /// Maximum nesting depth of arrays and objects; deeper documents fail to
+  /// parse. Default: JSONCPP_DEPRECATED_STACK_LIMIT (1000).
+  size_t stackLimit_{JSONCPP_DEPRECATED_STACK_LIMIT};
 };
 
 } // namespace Json
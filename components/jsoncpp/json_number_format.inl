@@ -0,0 +1,466 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+// included by json_writer.cpp
+
+// Allocation-free binary64 to decimal conversion for the writers.
+//
+// formatShortest() prints the shortest digit string that reads back as the
+// same double (Grisu2, F. Loitsch, "Printing Floating-Point Numbers Quickly
+// and Accurately with Integers", PLDI 2010). It replaces "%.17g", which always
+// round-trips too but spells 0.1 as 0.10000000000000001.
+//
+// formatFixed() is an exact integer implementation of "%.*f" for the small
+// decimal counts used for sensor values. It returns nullptr when the scaled
+// value does not fit in 64 bits, and the caller then uses snprintf.
+
+namespace Json {
+namespace {
+
+struct DiyFp {
+  uint64_t f;
+  int e;
+};
+
+inline DiyFp diyFpSub(DiyFp x, DiyFp y) {
+  assert(x.e == y.e && x.f >= y.f);
+  DiyFp r = {x.f - y.f, x.e};
+  return r;
+}
+
+// Upper 64 bits of the 128-bit product, rounded. Portable on 32-bit targets.
+inline DiyFp diyFpMul(DiyFp x, DiyFp y) {
+  const uint64_t uLo = x.f & 0xFFFFFFFFU, uHi = x.f >> 32;
+  const uint64_t vLo = y.f & 0xFFFFFFFFU, vHi = y.f >> 32;
+  const uint64_t p0 = uLo * vLo;
+  const uint64_t p1 = uLo * vHi;
+  const uint64_t p2 = uHi * vLo;
+  const uint64_t p3 = uHi * vHi;
+  uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFU) + (p2 & 0xFFFFFFFFU);
+  q += uint64_t(1) << 31;
+  DiyFp r = {p3 + (p1 >> 32) + (p2 >> 32) + (q >> 32), x.e + y.e + 64};
+  return r;
+}
+
+inline DiyFp diyFpNormalize(DiyFp x) {
+  assert(x.f != 0);
+  while ((x.f >> 63) == 0) {
+    x.f <<= 1;
+    --x.e;
+  }
+  return x;
+}
+
+inline DiyFp diyFpNormalizeTo(DiyFp x, int targetExponent) {
+  const int delta = x.e - targetExponent;
+  assert(delta >= 0 && ((x.f << delta) >> delta) == x.f);
+  DiyFp r = {x.f << delta, targetExponent};
+  return r;
+}
+
+// v and its rounding boundaries m- and m+, normalized to the exponent of m+.
+struct Boundaries {
+  DiyFp w;
+  DiyFp minus;
+  DiyFp plus;
+};
+
+Boundaries computeBoundaries(double value) {
+  assert(isfinite(value) && value > 0);
+  const int bias = 1075; // 1023 + 52
+  const uint64_t hiddenBit = uint64_t(1) << 52;
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint64_t fraction = bits & (hiddenBit - 1);
+  const int biasedExponent = static_cast<int>(bits >> 52);
+
+  DiyFp v;
+  if (biasedExponent == 0) {
+    v.f = fraction;
+    v.e = 1 - bias;
+  } else {
+    v.f = fraction + hiddenBit;
+    v.e = biasedExponent - bias;
+  }
+  // The gap to the predecessor halves at powers of two.
+  const bool lowerBoundaryIsCloser = fraction == 0 && biasedExponent > 1;
+  DiyFp plus = {2 * v.f + 1, v.e - 1};
+  DiyFp minus = lowerBoundaryIsCloser ? DiyFp{4 * v.f - 1, v.e - 2}
+                                      : DiyFp{2 * v.f - 1, v.e - 1};
+  Boundaries b;
+  b.plus = diyFpNormalize(plus);
+  b.minus = diyFpNormalizeTo(minus, b.plus.e);
+  b.w = diyFpNormalize(v);
+  return b;
+}
+
+// Scaled products must land in [alpha, gamma] so that the integral part of
+// the scaled upper boundary fits in 32 bits.
+const int grisuAlpha = -60;
+const int grisuGamma = -32;
+
+struct CachedPower {
+  uint64_t f;
+  int e;
+  int k;
+};
+
+// Normalized approximations of 10^k for k = -300, -292, ..., 324.
+const CachedPower cachedPowersOfTen[] = {
+    {0xAB70FE17C79AC6CA, -1060, -300},
+    {0xFF77B1FCBEBCDC4F, -1034, -292},
+    {0xBE5691EF416BD60C, -1007, -284},
+    {0x8DD01FAD907FFC3C, -980, -276},
+    {0xD3515C2831559A83, -954, -268},
+    {0x9D71AC8FADA6C9B5, -927, -260},
+    {0xEA9C227723EE8BCB, -901, -252},
+    {0xAECC49914078536D, -874, -244},
+    {0x823C12795DB6CE57, -847, -236},
+    {0xC21094364DFB5637, -821, -228},
+    {0x9096EA6F3848984F, -794, -220},
+    {0xD77485CB25823AC7, -768, -212},
+    {0xA086CFCD97BF97F4, -741, -204},
+    {0xEF340A98172AACE5, -715, -196},
+    {0xB23867FB2A35B28E, -688, -188},
+    {0x84C8D4DFD2C63F3B, -661, -180},
+    {0xC5DD44271AD3CDBA, -635, -172},
+    {0x936B9FCEBB25C996, -608, -164},
+    {0xDBAC6C247D62A584, -582, -156},
+    {0xA3AB66580D5FDAF6, -555, -148},
+    {0xF3E2F893DEC3F126, -529, -140},
+    {0xB5B5ADA8AAFF80B8, -502, -132},
+    {0x87625F056C7C4A8B, -475, -124},
+    {0xC9BCFF6034C13053, -449, -116},
+    {0x964E858C91BA2655, -422, -108},
+    {0xDFF9772470297EBD, -396, -100},
+    {0xA6DFBD9FB8E5B88F, -369, -92},
+    {0xF8A95FCF88747D94, -343, -84},
+    {0xB94470938FA89BCF, -316, -76},
+    {0x8A08F0F8BF0F156B, -289, -68},
+    {0xCDB02555653131B6, -263, -60},
+    {0x993FE2C6D07B7FAC, -236, -52},
+    {0xE45C10C42A2B3B06, -210, -44},
+    {0xAA242499697392D3, -183, -36},
+    {0xFD87B5F28300CA0E, -157, -28},
+    {0xBCE5086492111AEB, -130, -20},
+    {0x8CBCCC096F5088CC, -103, -12},
+    {0xD1B71758E219652C, -77, -4},
+    {0x9C40000000000000, -50, 4},
+    {0xE8D4A51000000000, -24, 12},
+    {0xAD78EBC5AC620000, 3, 20},
+    {0x813F3978F8940984, 30, 28},
+    {0xC097CE7BC90715B3, 56, 36},
+    {0x8F7E32CE7BEA5C70, 83, 44},
+    {0xD5D238A4ABE98068, 109, 52},
+    {0x9F4F2726179A2245, 136, 60},
+    {0xED63A231D4C4FB27, 162, 68},
+    {0xB0DE65388CC8ADA8, 189, 76},
+    {0x83C7088E1AAB65DB, 216, 84},
+    {0xC45D1DF942711D9A, 242, 92},
+    {0x924D692CA61BE758, 269, 100},
+    {0xDA01EE641A708DEA, 295, 108},
+    {0xA26DA3999AEF774A, 322, 116},
+    {0xF209787BB47D6B85, 348, 124},
+    {0xB454E4A179DD1877, 375, 132},
+    {0x865B86925B9BC5C2, 402, 140},
+    {0xC83553C5C8965D3D, 428, 148},
+    {0x952AB45CFA97A0B3, 455, 156},
+    {0xDE469FBD99A05FE3, 481, 164},
+    {0xA59BC234DB398C25, 508, 172},
+    {0xF6C69A72A3989F5C, 534, 180},
+    {0xB7DCBF5354E9BECE, 561, 188},
+    {0x88FCF317F22241E2, 588, 196},
+    {0xCC20CE9BD35C78A5, 614, 204},
+    {0x98165AF37B2153DF, 641, 212},
+    {0xE2A0B5DC971F303A, 667, 220},
+    {0xA8D9D1535CE3B396, 694, 228},
+    {0xFB9B7CD9A4A7443C, 720, 236},
+    {0xBB764C4CA7A44410, 747, 244},
+    {0x8BAB8EEFB6409C1A, 774, 252},
+    {0xD01FEF10A657842C, 800, 260},
+    {0x9B10A4E5E9913129, 827, 268},
+    {0xE7109BFBA19C0C9D, 853, 276},
+    {0xAC2820D9623BF429, 880, 284},
+    {0x80444B5E7AA7CF85, 907, 292},
+    {0xBF21E44003ACDD2D, 933, 300},
+    {0x8E679C2F5E44FF8F, 960, 308},
+    {0xD433179D9C8CB841, 986, 316},
+    {0x9E19DB92B4E31BA9, 1013, 324},
+};
+
+const int cachedPowersMinDecimalExponent = -300;
+const int cachedPowersDecimalStep = 8;
+
+CachedPower cachedPowerForBinaryExponent(int e) {
+  // k = ceil((alpha - e - 1) * log10(2)), using 78913 / 2^18 ~ log10(2).
+  const int f = grisuAlpha - e - 1;
+  const int k = (f * 78913) / (1 << 18) + static_cast<int>(f > 0);
+  const int index = (-cachedPowersMinDecimalExponent + k +
+                     (cachedPowersDecimalStep - 1)) /
+                    cachedPowersDecimalStep;
+  assert(index >= 0 && static_cast<size_t>(index) <
+                           sizeof(cachedPowersOfTen) /
+                               sizeof(cachedPowersOfTen[0]));
+  const CachedPower cached = cachedPowersOfTen[index];
+  assert(grisuAlpha <= cached.e + e + 64 && cached.e + e + 64 <= grisuGamma);
+  return cached;
+}
+
+int findLargestPow10(uint32_t n, uint32_t& pow10) {
+  static const uint32_t powers[] = {1,      10,      100,      1000,
+                                    10000,  100000,  1000000,  10000000,
+                                    100000000, 1000000000};
+  int digits = 10;
+  while (digits > 1 && n < powers[digits - 1])
+    --digits;
+  pow10 = powers[digits - 1];
+  return digits;
+}
+
+// Nudge the last digit towards w while staying inside the rounding interval.
+void grisuRound(char* buffer, int length, uint64_t dist, uint64_t delta,
+                uint64_t rest, uint64_t tenK) {
+  while (rest < dist && delta - rest >= tenK &&
+         (rest + tenK < dist || dist - rest > rest + tenK - dist)) {
+    --buffer[length - 1];
+    rest += tenK;
+  }
+}
+
+void grisuDigitGen(char* buffer, int& length, int& decimalExponent,
+                   DiyFp mMinus, DiyFp w, DiyFp mPlus) {
+  uint64_t delta = diyFpSub(mPlus, mMinus).f;
+  uint64_t dist = diyFpSub(mPlus, w).f;
+
+  const DiyFp one = {uint64_t(1) << -mPlus.e, mPlus.e};
+  uint32_t p1 = static_cast<uint32_t>(mPlus.f >> -one.e);
+  uint64_t p2 = mPlus.f & (one.f - 1);
+
+  uint32_t pow10;
+  int n = findLargestPow10(p1, pow10);
+  while (n > 0) {
+    const uint32_t d = p1 / pow10;
+    p1 %= pow10;
+    buffer[length++] = static_cast<char>('0' + d);
+    --n;
+    const uint64_t rest = (uint64_t(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      decimalExponent += n;
+      grisuRound(buffer, length, dist, delta, rest, uint64_t(pow10)
+                                                        << -one.e);
+      return;
+    }
+    pow10 /= 10;
+  }
+
+  int m = 0;
+  for (;;) {
+    p2 *= 10;
+    const uint64_t d = p2 >> -one.e;
+    p2 &= one.f - 1;
+    buffer[length++] = static_cast<char>('0' + d);
+    ++m;
+    delta *= 10;
+    dist *= 10;
+    if (p2 <= delta)
+      break;
+  }
+  decimalExponent -= m;
+  grisuRound(buffer, length, dist, delta, p2, one.f);
+}
+
+// Writes the digits of value > 0 to buffer; value == digits * 10^exponent.
+int grisu2(char* buffer, int& decimalExponent, double value) {
+  const Boundaries b = computeBoundaries(value);
+  const CachedPower cached = cachedPowerForBinaryExponent(b.plus.e);
+  const DiyFp c = {cached.f, cached.e};
+  const DiyFp w = diyFpMul(b.w, c);
+  DiyFp wMinus = diyFpMul(b.minus, c);
+  DiyFp wPlus = diyFpMul(b.plus, c);
+  // Shrink the interval by one ulp on each side to absorb the error of the
+  // cached power, so that any digit string inside still reads back as value.
+  ++wMinus.f;
+  --wPlus.f;
+  int length = 0;
+  decimalExponent = -cached.k;
+  grisuDigitGen(buffer, length, decimalExponent, wMinus, w, wPlus);
+  return length;
+}
+
+char* writeExponent(char* out, int e) {
+  *out++ = 'e';
+  if (e < 0) {
+    *out++ = '-';
+    e = -e;
+  } else {
+    *out++ = '+';
+  }
+  if (e >= 100) {
+    *out++ = static_cast<char>('0' + e / 100);
+    e %= 100;
+  }
+  *out++ = static_cast<char>('0' + e / 10);
+  *out++ = static_cast<char>('0' + e % 10);
+  return out;
+}
+
+/** Shortest round-trip spelling of a finite value, laid out like "%.17g".
+ * \param out at least 32 bytes.
+ * \return one past the last character written (no terminating NUL).
+ */
+char* formatShortest(char* out, double value) {
+  if (std::signbit(value)) {
+    *out++ = '-';
+    value = -value;
+  }
+  if (value == 0) {
+    *out++ = '0';
+    return out;
+  }
+  char digits[18];
+  int exponent;
+  const int length = grisu2(digits, exponent, value);
+  const int sciExponent = length + exponent - 1;
+
+  if (sciExponent < -4 || sciExponent >= 17) {
+    *out++ = digits[0];
+    if (length > 1) {
+      *out++ = '.';
+      memcpy(out, digits + 1, static_cast<size_t>(length - 1));
+      out += length - 1;
+    }
+    return writeExponent(out, sciExponent);
+  }
+  if (exponent >= 0) {
+    memcpy(out, digits, static_cast<size_t>(length));
+    out += length;
+    memset(out, '0', static_cast<size_t>(exponent));
+    return out + exponent;
+  }
+  if (sciExponent >= 0) {
+    const int integral = sciExponent + 1;
+    memcpy(out, digits, static_cast<size_t>(integral));
+    out += integral;
+    *out++ = '.';
+    memcpy(out, digits + integral, static_cast<size_t>(length - integral));
+    return out + (length - integral);
+  }
+  *out++ = '0';
+  *out++ = '.';
+  memset(out, '0', static_cast<size_t>(-sciExponent - 1));
+  out += -sciExponent - 1;
+  memcpy(out, digits, static_cast<size_t>(length));
+  return out + length;
+}
+
+/** Exact "%.*f" for a finite value and decimals <= 19.
+ * \param out at least 48 bytes.
+ * \return one past the last character written, or nullptr if the scaled
+ *         value does not fit in 64 bits.
+ */
+char* formatFixed(char* out, double value, unsigned int decimals) {
+  static const uint64_t powersOfFive[] = {
+      1ULL,
+      5ULL,
+      25ULL,
+      125ULL,
+      625ULL,
+      3125ULL,
+      15625ULL,
+      78125ULL,
+      390625ULL,
+      1953125ULL,
+      9765625ULL,
+      48828125ULL,
+      244140625ULL,
+      1220703125ULL,
+      6103515625ULL,
+      30517578125ULL,
+      152587890625ULL,
+      762939453125ULL,
+      3814697265625ULL,
+      19073486328125ULL};
+  static const uint64_t powersOfTen[] = {1ULL,
+                                         10ULL,
+                                         100ULL,
+                                         1000ULL,
+                                         10000ULL,
+                                         100000ULL,
+                                         1000000ULL,
+                                         10000000ULL,
+                                         100000000ULL,
+                                         1000000000ULL,
+                                         10000000000ULL,
+                                         100000000000ULL,
+                                         1000000000000ULL,
+                                         10000000000000ULL,
+                                         100000000000000ULL,
+                                         1000000000000000ULL,
+                                         10000000000000000ULL,
+                                         100000000000000000ULL,
+                                         1000000000000000000ULL,
+                                         10000000000000000000ULL};
+  if (decimals >= sizeof(powersOfTen) / sizeof(powersOfTen[0]))
+    return nullptr;
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const bool negative = (bits >> 63) != 0;
+  const int biasedExponent = static_cast<int>((bits >> 52) & 0x7FF);
+  uint64_t mantissa = bits & ((uint64_t(1) << 52) - 1);
+  int exponent2 = 1 - 1075;
+  if (biasedExponent != 0) {
+    mantissa |= uint64_t(1) << 52;
+    exponent2 = biasedExponent - 1075;
+  }
+
+  // value * 10^decimals == mantissa * 5^decimals * 2^(exponent2 + decimals),
+  // rounded half to even like printf.
+  uint64_t scaled = 0;
+  if (mantissa != 0) {
+    if (mantissa > UINT64_MAX / powersOfFive[decimals])
+      return nullptr;
+    const uint64_t n = mantissa * powersOfFive[decimals];
+    const int shift = exponent2 + static_cast<int>(decimals);
+    if (shift >= 0) {
+      if (shift >= 64 || n > (UINT64_MAX >> shift))
+        return nullptr;
+      scaled = n << shift;
+    } else if (shift > -64) {
+      const int s = -shift;
+      scaled = n >> s;
+      const uint64_t rest = n & ((uint64_t(1) << s) - 1);
+      const uint64_t half = uint64_t(1) << (s - 1);
+      if (rest > half || (rest == half && (scaled & 1)))
+        ++scaled;
+    } else {
+      return nullptr;
+    }
+  }
+
+  if (negative)
+    *out++ = '-';
+  const uint64_t integral = scaled / powersOfTen[decimals];
+  uint64_t fraction = scaled % powersOfTen[decimals];
+  UIntToStringBuffer digits;
+  char* current = digits + sizeof(digits);
+  uintToString(static_cast<LargestUInt>(integral), current);
+  const size_t integralLength =
+      static_cast<size_t>(digits + sizeof(digits) - 1 - current);
+  memcpy(out, current, integralLength);
+  out += integralLength;
+  if (decimals > 0) {
+    *out++ = '.';
+    for (unsigned int i = decimals; i > 0; --i) {
+      out[i - 1] = static_cast<char>('0' + fraction % 10);
+      fraction /= 10;
+    }
+    out += decimals;
+  }
+  return out;
+}
+
+} // namespace
+} // namespace Json
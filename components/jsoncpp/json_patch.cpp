@@ -0,0 +1,55 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include <patch.h>
+#endif // if !defined(JSON_IS_AMALGAMATION)
+
+namespace Json {
+
+Value mergePatch(const Value& from, const Value& to) {
+  if (!from.isObject() || !to.isObject())
+    return to;
+  Value patch(objectValue);
+  // Removed members. Iterators give the names without copying them.
+  for (auto it = from.begin(); it != from.end(); ++it) {
+    char const* end;
+    char const* name = it.memberName(&end);
+    if (to.find(name, end) == nullptr)
+      *patch.demand(name, end) = Value::nullSingleton();
+  }
+  // Added and changed members.
+  for (auto it = to.begin(); it != to.end(); ++it) {
+    char const* end;
+    char const* name = it.memberName(&end);
+    const Value* before = from.find(name, end);
+    if (before != nullptr && *before == *it)
+      continue;
+    if (before != nullptr && before->isObject() && it->isObject())
+      *patch.demand(name, end) = mergePatch(*before, *it);
+    else
+      *patch.demand(name, end) = *it;
+  }
+  return patch;
+}
+
+void applyMergePatch(Value& target, const Value& patch) {
+  if (!patch.isObject()) {
+    target = patch;
+    return;
+  }
+  if (!target.isObject())
+    target = Value(objectValue);
+  for (auto it = patch.begin(); it != patch.end(); ++it) {
+    char const* end;
+    char const* name = it.memberName(&end);
+    if (it->isNull())
+      target.removeMember(name, end, nullptr);
+    else
+      applyMergePatch(*target.demand(name, end), *it);
+  }
+}
+
+} // namespace Json
@@ -13,15 +13,19 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
-#include <iostream>
-#include <istream>
 #include <limits>
 #include <memory>
 #include <set>
-#include <sstream>
 #include <utility>
 
+#if !JSONCPP_NO_IOSTREAM
+#include <istream>
+#include <sstream>
+#endif
+
 #include <cstdio>
 #if __cplusplus >= 201103L
 
@@ -42,17 +46,32 @@
 #pragma warning(disable : 4996)
 #endif
 
-// Define JSONCPP_DEPRECATED_STACK_LIMIT as an appropriate integer at compile
-// time to change the stack limit
-#if !defined(JSONCPP_DEPRECATED_STACK_LIMIT)
-#define JSONCPP_DEPRECATED_STACK_LIMIT 1000
-#endif
-
-static size_t const stackLimit_g =
-    JSONCPP_DEPRECATED_STACK_LIMIT; // see readValue()
+#if !defined(JSON_IS_AMALGAMATION)
+#include "json_number_parse.inl"
+#endif // if !defined(JSON_IS_AMALGAMATION)
 
 namespace Json {
 
+bool decodeRealToken(const char* begin, const char* end, double& value) {
+  if (decodeDoubleFast(begin, end, value))
+    return true;
+#if JSONCPP_NO_IOSTREAM
+  return decodeDoubleSlow(begin, end, value);
+#else
+  const String buffer(begin, end);
+  IStringStream is(buffer);
+  if (!(is >> value)) {
+    if (value == std::numeric_limits<double>::max())
+      value = std::numeric_limits<double>::infinity();
+    else if (value == std::numeric_limits<double>::lowest())
+      value = -std::numeric_limits<double>::infinity();
+    else if (!std::isinf(value))
+      return false;
+  }
+  return true;
+#endif
+}
+
 #if __cplusplus >= 201103L || (defined(_CPPLIB_VER) && _CPPLIB_VER >= 520)
 using CharReaderPtr = std::unique_ptr<CharReader>;
 #else
@@ -82,6 +101,21 @@ bool Reader::containsNewLine(Reader::Location begin, Reader::Location end) {
   return std::any_of(begin, end, [](char b) { return b == '\n' || b == '\r'; });
 }
 
+// Class KeyPool
+// ////////////////////////////////
+
+size_t KeyPool::Hash::operator()(const String& key) const {
+  // FNV-1a; String may use a custom allocator, so std::hash does not apply.
+  uint32_t hash = 2166136261U;
+  for (const char c : key)
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619U;
+  return hash;
+}
+
+const char* KeyPool::intern(const String& key) {
+  return keys_.insert(key).first->c_str();
+}
+
 // Class Reader
 // //////////////////////////////////////////////////////////////////
 
@@ -97,6 +131,7 @@ bool Reader::parse(const std::string& document, Value& root,
   return parse(begin, end, root, collectComments);
 }
 
+#if !JSONCPP_NO_IOSTREAM
 bool Reader::parse(std::istream& is, Value& root, bool collectComments) {
   // std::istream_iterator<char> begin(is);
   // std::istream_iterator<char> end;
@@ -108,10 +143,12 @@ bool Reader::parse(std::istream& is, Value& root, bool collectComments) {
   String doc(std::istreambuf_iterator<char>(is), {});
   return parse(doc.data(), doc.data() + doc.size(), root, collectComments);
 }
+#endif
 
 bool Reader::parse(const char* beginDoc, const char* endDoc, Value& root,
                    bool collectComments) {
-  if (!features_.allowComments_) {
+  // The lean Value profile has nowhere to store comments.
+  if (JSONCPP_LEAN_VALUE || !features_.allowComments_) {
     collectComments = false;
   }
 
@@ -123,9 +160,8 @@ bool Reader::parse(const char* beginDoc, const char* endDoc, Value& root,
   lastValue_ = nullptr;
   commentsBefore_.clear();
   errors_.clear();
-  while (!nodes_.empty())
-    nodes_.pop();
-  nodes_.push(&root);
+  nodes_.clear();
+  nodes_.push_back(Frame{&root, 0, false});
 
   bool successful = readValue();
   Token token;
@@ -149,16 +185,49 @@ bool Reader::parse(const char* beginDoc, const char* endDoc, Value& root,
 }
 
 bool Reader::readValue() {
-  // readValue() may call itself only if it calls readObject() or ReadArray().
-  // These methods execute nodes_.push() just before and nodes_.pop)() just
-  // after calling readValue(). parse() executes one nodes_.push(), so > instead
-  // of >=.
-  if (nodes_.size() > stackLimit_g)
+  // Objects and arrays do not call readValue() again. They push a Frame for
+  // the member to read next and this loop reads it; once that member is
+  // complete its frame is popped and the container decides how to go on.
+  // Native stack use is therefore the same at any depth: nodes_ grows
+  // instead, up to features_.stackLimit_ levels.
+  size_t const bottom = nodes_.size();
+  bool successful = true;
+  for (;;) {
+    if (beginValue(successful))
+      continue;
+    for (;;) {
+      if (nodes_.size() == bottom)
+        return successful;
+      nodes_.pop_back();
+      bool const more = currentValue().isArray()
+                            ? endArrayElement(successful)
+                            : endObjectMember(successful);
+      if (more)
+        break;
+      endContainer();
+    }
+  }
+}
+
+bool Reader::beginValue(bool& successful) {
+  // parse() executes one nodes_.push_back(), so > instead of >=.
+  if (nodes_.size() > features_.stackLimit_) {
+#if JSON_USE_EXCEPTION
     throwRuntimeError("Exceeded stackLimit in readValue().");
+#else
+    // throwRuntimeError() would abort(); fail the parse instead.
+    Token token;
+    token.type_ = tokenError;
+    token.start_ = current_;
+    token.end_ = current_;
+    successful = addError("Exceeded stackLimit in readValue().", token);
+    return false;
+#endif
+  }
 
   Token token;
   skipCommentTokens(token);
-  bool successful = true;
+  successful = true;
 
   if (collectComments_ && !commentsBefore_.empty()) {
     currentValue().setComment(commentsBefore_, commentBefore);
@@ -167,13 +236,15 @@ bool Reader::readValue() {
 
   switch (token.type_) {
   case tokenObjectBegin:
-    successful = readObject(token);
-    currentValue().setOffsetLimit(current_ - begin_);
-    break;
+    if (beginObject(token, successful))
+      return true;
+    endContainer();
+    return false;
   case tokenArrayBegin:
-    successful = readArray(token);
-    currentValue().setOffsetLimit(current_ - begin_);
-    break;
+    if (beginArray(token))
+      return true;
+    endContainer();
+    return false;
   case tokenNumber:
     successful = decodeNumber(token);
     break;
@@ -214,15 +285,24 @@ bool Reader::readValue() {
   default:
     currentValue().setOffsetStart(token.start_ - begin_);
     currentValue().setOffsetLimit(token.end_ - begin_);
-    return addError("Syntax error: value, object or array expected.", token);
+    successful =
+        addError("Syntax error: value, object or array expected.", token);
+    return false;
   }
 
   if (collectComments_) {
     lastValueEnd_ = current_;
     lastValue_ = &currentValue();
   }
+  return false;
+}
 
-  return successful;
+void Reader::endContainer() {
+  currentValue().setOffsetLimit(current_ - begin_);
+  if (collectComments_) {
+    lastValueEnd_ = current_;
+    lastValue_ = &currentValue();
+  }
 }
 
 void Reader::skipCommentTokens(Token& token) {
@@ -431,6 +511,9 @@ void Reader::readNumber() {
 bool Reader::readString() {
   Char c = '\0';
   while (current_ != end_) {
+    current_ = findQuoteOrBackslash(current_, end_, '"');
+    if (current_ == end_)
+      break;
     c = getNextChar();
     if (c == '\\')
       getNextChar();
@@ -440,63 +523,84 @@ bool Reader::readString() {
   return c == '"';
 }
 
-bool Reader::readObject(Token& token) {
-  Token tokenName;
-  String name;
+bool Reader::beginObject(Token& token, bool& successful) {
   Value init(objectValue);
   currentValue().swapPayload(init);
   currentValue().setOffsetStart(token.start_ - begin_);
+  nodes_.back().nameEmpty = true;
+  return nextObjectMember(successful);
+}
+
+bool Reader::nextObjectMember(bool& successful) {
+  Token tokenName;
   while (readToken(tokenName)) {
     bool initialTokenOk = true;
     while (tokenName.type_ == tokenComment && initialTokenOk)
       initialTokenOk = readToken(tokenName);
     if (!initialTokenOk)
       break;
-    if (tokenName.type_ == tokenObjectEnd && name.empty()) // empty object
-      return true;
-    name.clear();
+    if (tokenName.type_ == tokenObjectEnd &&
+        nodes_.back().nameEmpty) // empty object
+      return false;
+    name_.clear();
     if (tokenName.type_ == tokenString) {
-      if (!decodeString(tokenName, name))
-        return recoverFromError(tokenObjectEnd);
+      if (!decodeString(tokenName, name_)) {
+        successful = recoverFromError(tokenObjectEnd);
+        return false;
+      }
     } else if (tokenName.type_ == tokenNumber && features_.allowNumericKeys_) {
       Value numberName;
-      if (!decodeNumber(tokenName, numberName))
-        return recoverFromError(tokenObjectEnd);
-      name = numberName.asString();
+      if (!decodeNumber(tokenName, numberName)) {
+        successful = recoverFromError(tokenObjectEnd);
+        return false;
+      }
+      name_ = numberName.asString();
     } else {
       break;
     }
+    nodes_.back().nameEmpty = name_.empty();
 
     Token colon;
     if (!readToken(colon) || colon.type_ != tokenMemberSeparator) {
-      return addErrorAndRecover("Missing ':' after object member name", colon,
-                                tokenObjectEnd);
-    }
-    Value& value = currentValue()[name];
-    nodes_.push(&value);
-    bool ok = readValue();
-    nodes_.pop();
-    if (!ok) // error already set
-      return recoverFromError(tokenObjectEnd);
-
-    Token comma;
-    if (!readToken(comma) ||
-        (comma.type_ != tokenObjectEnd && comma.type_ != tokenArraySeparator &&
-         comma.type_ != tokenComment)) {
-      return addErrorAndRecover("Missing ',' or '}' in object declaration",
-                                comma, tokenObjectEnd);
+      successful = addErrorAndRecover("Missing ':' after object member name",
+                                      colon, tokenObjectEnd);
+      return false;
     }
-    bool finalizeTokenOk = true;
-    while (comma.type_ == tokenComment && finalizeTokenOk)
-      finalizeTokenOk = readToken(comma);
-    if (comma.type_ == tokenObjectEnd)
-      return true;
+    Value& value =
+        keyPool_ && name_.find('\0') == String::npos
+            ? currentValue()[StaticString(keyPool_->intern(name_))]
+            : currentValue()[name_];
+    nodes_.push_back(Frame{&value, 0, false});
+    return true;
   }
-  return addErrorAndRecover("Missing '}' or object member name", tokenName,
-                            tokenObjectEnd);
+  successful = addErrorAndRecover("Missing '}' or object member name",
+                                  tokenName, tokenObjectEnd);
+  return false;
 }
 
-bool Reader::readArray(Token& token) {
+bool Reader::endObjectMember(bool& successful) {
+  if (!successful) { // error already set
+    successful = recoverFromError(tokenObjectEnd);
+    return false;
+  }
+
+  Token comma;
+  if (!readToken(comma) ||
+      (comma.type_ != tokenObjectEnd && comma.type_ != tokenArraySeparator &&
+       comma.type_ != tokenComment)) {
+    successful = addErrorAndRecover("Missing ',' or '}' in object declaration",
+                                    comma, tokenObjectEnd);
+    return false;
+  }
+  bool finalizeTokenOk = true;
+  while (comma.type_ == tokenComment && finalizeTokenOk)
+    finalizeTokenOk = readToken(comma);
+  if (comma.type_ == tokenObjectEnd)
+    return false;
+  return nextObjectMember(successful);
+}
+
+bool Reader::beginArray(Token& token) {
   Value init(arrayValue);
   currentValue().swapPayload(init);
   currentValue().setOffsetStart(token.start_ - begin_);
@@ -505,35 +609,44 @@ bool Reader::readArray(Token& token) {
   {
     Token endArray;
     readToken(endArray);
-    return true;
+    return false;
   }
-  int index = 0;
-  for (;;) {
-    Value& value = currentValue()[index++];
-    nodes_.push(&value);
-    bool ok = readValue();
-    nodes_.pop();
-    if (!ok) // error already set
-      return recoverFromError(tokenArrayEnd);
-
-    Token currentToken;
-    // Accept Comment after last item in the array.
+  nodes_.back().index = 0;
+  pushArrayElement();
+  return true;
+}
+
+bool Reader::endArrayElement(bool& successful) {
+  if (!successful) { // error already set
+    successful = recoverFromError(tokenArrayEnd);
+    return false;
+  }
+
+  Token currentToken;
+  // Accept Comment after last item in the array.
+  bool ok = readToken(currentToken);
+  while (currentToken.type_ == tokenComment && ok) {
     ok = readToken(currentToken);
-    while (currentToken.type_ == tokenComment && ok) {
-      ok = readToken(currentToken);
-    }
-    bool badTokenType = (currentToken.type_ != tokenArraySeparator &&
-                         currentToken.type_ != tokenArrayEnd);
-    if (!ok || badTokenType) {
-      return addErrorAndRecover("Missing ',' or ']' in array declaration",
-                                currentToken, tokenArrayEnd);
-    }
-    if (currentToken.type_ == tokenArrayEnd)
-      break;
   }
+  bool badTokenType = (currentToken.type_ != tokenArraySeparator &&
+                       currentToken.type_ != tokenArrayEnd);
+  if (!ok || badTokenType) {
+    successful = addErrorAndRecover("Missing ',' or ']' in array declaration",
+                                    currentToken, tokenArrayEnd);
+    return false;
+  }
+  if (currentToken.type_ == tokenArrayEnd)
+    return false;
+  pushArrayElement();
   return true;
 }
 
+void Reader::pushArrayElement() {
+  Frame& array = nodes_.back();
+  Value& value = (*array.value)[array.index++];
+  nodes_.push_back(Frame{&value, 0, false});
+}
+
 bool Reader::decodeNumber(Token& token) {
   Value decoded;
   if (!decodeNumber(token, decoded))
@@ -599,17 +712,9 @@ bool Reader::decodeDouble(Token& token) {
 
 bool Reader::decodeDouble(Token& token, Value& decoded) {
   double value = 0;
-  String buffer(token.start_, token.end_);
-  IStringStream is(buffer);
-  if (!(is >> value)) {
-    if (value == std::numeric_limits<double>::max())
-      value = std::numeric_limits<double>::infinity();
-    else if (value == std::numeric_limits<double>::lowest())
-      value = -std::numeric_limits<double>::infinity();
-    else if (!std::isinf(value))
-      return addError(
+  if (!decodeRealToken(token.start_, token.end_, value))
+    return addError(
         "'" + String(token.start_, token.end_) + "' is not a number.", token);
-  }
   decoded = value;
   return true;
 }
@@ -630,6 +735,12 @@ bool Reader::decodeString(Token& token, String& decoded) {
   Location current = token.start_ + 1; // skip '"'
   Location end = token.end_ - 1;       // do not include '"'
   while (current != end) {
+    // Copy the run up to the next escape in one go.
+    Location special = findQuoteOrBackslash(current, end, '"');
+    decoded.append(current, special);
+    current = special;
+    if (current == end)
+      break;
     Char c = *current++;
     if (c == '"')
       break;
@@ -757,7 +868,7 @@ bool Reader::addErrorAndRecover(const String& message, Token& token,
   return recoverFromError(skipUntilToken);
 }
 
-Value& Reader::currentValue() { return *(nodes_.top()); }
+Value& Reader::currentValue() { return *(nodes_.back().value); }
 
 Reader::Char Reader::getNextChar() {
   if (current_ == end_)
@@ -940,7 +1051,7 @@ private:
     Location extra_;
   };
 
-  using Errors = std::deque<ErrorInfo>;
+  using Errors = std::deque<ErrorInfo, HookAllocator<ErrorInfo>>;
 
   bool readToken(Token& token);
   void skipSpaces();
@@ -953,8 +1064,15 @@ private:
   bool readStringSingleQuote();
   bool readNumber(bool checkInf);
   bool readValue();
-  bool readObject(Token& token);
-  bool readArray(Token& token);
+  // Steps of readValue(); see Reader.
+  bool beginValue(bool& successful);
+  bool beginObject(Token& token, bool& successful);
+  bool nextObjectMember(bool& successful);
+  bool endObjectMember(bool& successful);
+  bool beginArray(Token& token);
+  bool nextArrayElement();
+  bool endArrayElement(bool& successful);
+  void endContainer();
   bool decodeNumber(Token& token);
   bool decodeNumber(Token& token, Value& decoded);
   bool decodeString(Token& token);
@@ -981,9 +1099,15 @@ private:
   static String normalizeEOL(Location begin, Location end);
   static bool containsNewLine(Location begin, Location end);
 
-  using Nodes = std::stack<Value*>;
+  struct Frame {
+    Value* value;
+    ArrayIndex index; // next element of an array
+    bool nameEmpty;   // last member name of an object was ""
+  };
+  using Nodes = std::vector<Frame, HookAllocator<Frame>>;
 
   Nodes nodes_{};
+  String name_{}; // member name being decoded
   Errors errors_{};
   String document_{};
   Location begin_ = nullptr;
@@ -1009,7 +1133,8 @@ OurReader::OurReader(OurFeatures const& features) : features_(features) {}
 
 bool OurReader::parse(const char* beginDoc, const char* endDoc, Value& root,
                       bool collectComments) {
-  if (!features_.allowComments_) {
+  // The lean Value profile has nowhere to store comments.
+  if (JSONCPP_LEAN_VALUE || !features_.allowComments_) {
     collectComments = false;
   }
 
@@ -1021,14 +1146,13 @@ bool OurReader::parse(const char* beginDoc, const char* endDoc, Value& root,
   lastValue_ = nullptr;
   commentsBefore_.clear();
   errors_.clear();
-  while (!nodes_.empty())
-    nodes_.pop();
-  nodes_.push(&root);
+  nodes_.clear();
+  nodes_.push_back(Frame{&root, 0, false});
 
   // skip byte order mark if it exists at the beginning of the UTF-8 text.
   skipBom(features_.skipBom_);
   bool successful = readValue();
-  nodes_.pop();
+  nodes_.pop_back();
   Token token;
   skipCommentTokens(token);
   if (features_.failIfExtra_ && (token.type_ != tokenEndOfStream)) {
@@ -1054,12 +1178,45 @@ bool OurReader::parse(const char* beginDoc, const char* endDoc, Value& root,
 }
 
 bool OurReader::readValue() {
-  //  To preserve the old behaviour we cast size_t to int.
-  if (nodes_.size() > features_.stackLimit_)
+  // Iterative, as Reader::readValue().
+  size_t const bottom = nodes_.size();
+  bool successful = true;
+  for (;;) {
+    if (beginValue(successful))
+      continue;
+    for (;;) {
+      if (nodes_.size() == bottom)
+        return successful;
+      nodes_.pop_back();
+      bool const more = currentValue().isArray()
+                            ? endArrayElement(successful)
+                            : endObjectMember(successful);
+      if (more)
+        break;
+      endContainer();
+    }
+  }
+}
+
+bool OurReader::beginValue(bool& successful) {
+  // parse() executes one nodes_.push_back(), so > instead of >=.
+  if (nodes_.size() > features_.stackLimit_) {
+#if JSON_USE_EXCEPTION
     throwRuntimeError("Exceeded stackLimit in readValue().");
+#else
+    // throwRuntimeError() would abort(); fail the parse instead.
+    Token token;
+    token.type_ = tokenError;
+    token.start_ = current_;
+    token.end_ = current_;
+    successful = addError("Exceeded stackLimit in readValue().", token);
+    return false;
+#endif
+  }
+
   Token token;
   skipCommentTokens(token);
-  bool successful = true;
+  successful = true;
 
   if (collectComments_ && !commentsBefore_.empty()) {
     currentValue().setComment(commentsBefore_, commentBefore);
@@ -1068,13 +1225,15 @@ bool OurReader::readValue() {
 
   switch (token.type_) {
   case tokenObjectBegin:
-    successful = readObject(token);
-    currentValue().setOffsetLimit(current_ - begin_);
-    break;
+    if (beginObject(token, successful))
+      return true;
+    endContainer();
+    return false;
   case tokenArrayBegin:
-    successful = readArray(token);
-    currentValue().setOffsetLimit(current_ - begin_);
-    break;
+    if (beginArray(token))
+      return true;
+    endContainer();
+    return false;
   case tokenNumber:
     successful = decodeNumber(token);
     break;
@@ -1133,7 +1292,9 @@ bool OurReader::readValue() {
   default:
     currentValue().setOffsetStart(token.start_ - begin_);
     currentValue().setOffsetLimit(token.end_ - begin_);
-    return addError("Syntax error: value, object or array expected.", token);
+    successful =
+        addError("Syntax error: value, object or array expected.", token);
+    return false;
   }
 
   if (collectComments_) {
@@ -1141,8 +1302,16 @@ bool OurReader::readValue() {
     lastValueHasAComment_ = false;
     lastValue_ = &currentValue();
   }
+  return false;
+}
 
-  return successful;
+void OurReader::endContainer() {
+  currentValue().setOffsetLimit(current_ - begin_);
+  if (collectComments_) {
+    lastValueEnd_ = current_;
+    lastValueHasAComment_ = false;
+    lastValue_ = &currentValue();
+  }
 }
 
 void OurReader::skipCommentTokens(Token& token) {
@@ -1422,6 +1591,9 @@ bool OurReader::readNumber(bool checkInf) {
 bool OurReader::readString() {
   Char c = 0;
   while (current_ != end_) {
+    current_ = findQuoteOrBackslash(current_, end_, '"');
+    if (current_ == end_)
+      break;
     c = getNextChar();
     if (c == '\\')
       getNextChar();
@@ -1434,6 +1606,9 @@ bool OurReader::readString() {
 bool OurReader::readStringSingleQuote() {
   Char c = 0;
   while (current_ != end_) {
+    current_ = findQuoteOrBackslash(current_, end_, '\'');
+    if (current_ == end_)
+      break;
     c = getNextChar();
     if (c == '\\')
       getNextChar();
@@ -1443,12 +1618,16 @@ bool OurReader::readStringSingleQuote() {
   return c == '\'';
 }
 
-bool OurReader::readObject(Token& token) {
-  Token tokenName;
-  String name;
+bool OurReader::beginObject(Token& token, bool& successful) {
   Value init(objectValue);
   currentValue().swapPayload(init);
   currentValue().setOffsetStart(token.start_ - begin_);
+  nodes_.back().nameEmpty = true;
+  return nextObjectMember(successful);
+}
+
+bool OurReader::nextObjectMember(bool& successful) {
+  Token tokenName;
   while (readToken(tokenName)) {
     bool initialTokenOk = true;
     while (tokenName.type_ == tokenComment && initialTokenOk)
@@ -1456,99 +1635,121 @@ bool OurReader::readObject(Token& token) {
     if (!initialTokenOk)
       break;
     if (tokenName.type_ == tokenObjectEnd &&
-        (name.empty() ||
+        (nodes_.back().nameEmpty ||
          features_.allowTrailingCommas_)) // empty object or trailing comma
-      return true;
-    name.clear();
+      return false;
+    name_.clear();
     if (tokenName.type_ == tokenString) {
-      if (!decodeString(tokenName, name))
-        return recoverFromError(tokenObjectEnd);
+      if (!decodeString(tokenName, name_)) {
+        successful = recoverFromError(tokenObjectEnd);
+        return false;
+      }
     } else if (tokenName.type_ == tokenNumber && features_.allowNumericKeys_) {
       Value numberName;
-      if (!decodeNumber(tokenName, numberName))
-        return recoverFromError(tokenObjectEnd);
-      name = numberName.asString();
+      if (!decodeNumber(tokenName, numberName)) {
+        successful = recoverFromError(tokenObjectEnd);
+        return false;
+      }
+      name_ = numberName.asString();
     } else {
       break;
     }
-    if (name.length() >= (1U << 30))
+    nodes_.back().nameEmpty = name_.empty();
+    if (name_.length() >= (1U << 30))
       throwRuntimeError("keylength >= 2^30");
-    if (features_.rejectDupKeys_ && currentValue().isMember(name)) {
-      String msg = "Duplicate key: '" + name + "'";
-      return addErrorAndRecover(msg, tokenName, tokenObjectEnd);
+    if (features_.rejectDupKeys_ && currentValue().isMember(name_)) {
+      String msg = "Duplicate key: '" + name_ + "'";
+      successful = addErrorAndRecover(msg, tokenName, tokenObjectEnd);
+      return false;
     }
 
     Token colon;
     if (!readToken(colon) || colon.type_ != tokenMemberSeparator) {
-      return addErrorAndRecover("Missing ':' after object member name", colon,
-                                tokenObjectEnd);
-    }
-    Value& value = currentValue()[name];
-    nodes_.push(&value);
-    bool ok = readValue();
-    nodes_.pop();
-    if (!ok) // error already set
-      return recoverFromError(tokenObjectEnd);
-
-    Token comma;
-    if (!readToken(comma) ||
-        (comma.type_ != tokenObjectEnd && comma.type_ != tokenArraySeparator &&
-         comma.type_ != tokenComment)) {
-      return addErrorAndRecover("Missing ',' or '}' in object declaration",
-                                comma, tokenObjectEnd);
+      successful = addErrorAndRecover("Missing ':' after object member name",
+                                      colon, tokenObjectEnd);
+      return false;
     }
-    bool finalizeTokenOk = true;
-    while (comma.type_ == tokenComment && finalizeTokenOk)
-      finalizeTokenOk = readToken(comma);
-    if (comma.type_ == tokenObjectEnd)
-      return true;
+    Value& value = currentValue()[name_];
+    nodes_.push_back(Frame{&value, 0, false});
+    return true;
+  }
+  successful = addErrorAndRecover("Missing '}' or object member name",
+                                  tokenName, tokenObjectEnd);
+  return false;
+}
+
+bool OurReader::endObjectMember(bool& successful) {
+  if (!successful) { // error already set
+    successful = recoverFromError(tokenObjectEnd);
+    return false;
+  }
+
+  Token comma;
+  if (!readToken(comma) ||
+      (comma.type_ != tokenObjectEnd && comma.type_ != tokenArraySeparator &&
+       comma.type_ != tokenComment)) {
+    successful = addErrorAndRecover("Missing ',' or '}' in object declaration",
+                                    comma, tokenObjectEnd);
+    return false;
   }
-  return addErrorAndRecover("Missing '}' or object member name", tokenName,
-                            tokenObjectEnd);
+  bool finalizeTokenOk = true;
+  while (comma.type_ == tokenComment && finalizeTokenOk)
+    finalizeTokenOk = readToken(comma);
+  if (comma.type_ == tokenObjectEnd)
+    return false;
+  return nextObjectMember(successful);
 }
 
-bool OurReader::readArray(Token& token) {
+bool OurReader::beginArray(Token& token) {
   Value init(arrayValue);
   currentValue().swapPayload(init);
   currentValue().setOffsetStart(token.start_ - begin_);
-  int index = 0;
-  for (;;) {
-    skipSpaces();
-    if (current_ != end_ && *current_ == ']' &&
-        (index == 0 ||
-         (features_.allowTrailingCommas_ &&
-          !features_.allowDroppedNullPlaceholders_))) // empty array or trailing
-                                                      // comma
-    {
-      Token endArray;
-      readToken(endArray);
-      return true;
-    }
-    Value& value = currentValue()[index++];
-    nodes_.push(&value);
-    bool ok = readValue();
-    nodes_.pop();
-    if (!ok) // error already set
-      return recoverFromError(tokenArrayEnd);
-
-    Token currentToken;
-    // Accept Comment after last item in the array.
-    ok = readToken(currentToken);
-    while (currentToken.type_ == tokenComment && ok) {
-      ok = readToken(currentToken);
-    }
-    bool badTokenType = (currentToken.type_ != tokenArraySeparator &&
-                         currentToken.type_ != tokenArrayEnd);
-    if (!ok || badTokenType) {
-      return addErrorAndRecover("Missing ',' or ']' in array declaration",
-                                currentToken, tokenArrayEnd);
-    }
-    if (currentToken.type_ == tokenArrayEnd)
-      break;
+  nodes_.back().index = 0;
+  return nextArrayElement();
+}
+
+bool OurReader::nextArrayElement() {
+  Frame& array = nodes_.back();
+  skipSpaces();
+  if (current_ != end_ && *current_ == ']' &&
+      (array.index == 0 ||
+       (features_.allowTrailingCommas_ &&
+        !features_.allowDroppedNullPlaceholders_))) // empty array or trailing
+                                                    // comma
+  {
+    Token endArray;
+    readToken(endArray);
+    return false;
   }
+  Value& value = (*array.value)[array.index++];
+  nodes_.push_back(Frame{&value, 0, false});
   return true;
 }
 
+bool OurReader::endArrayElement(bool& successful) {
+  if (!successful) { // error already set
+    successful = recoverFromError(tokenArrayEnd);
+    return false;
+  }
+
+  Token currentToken;
+  // Accept Comment after last item in the array.
+  bool ok = readToken(currentToken);
+  while (currentToken.type_ == tokenComment && ok) {
+    ok = readToken(currentToken);
+  }
+  bool badTokenType = (currentToken.type_ != tokenArraySeparator &&
+                       currentToken.type_ != tokenArrayEnd);
+  if (!ok || badTokenType) {
+    successful = addErrorAndRecover("Missing ',' or ']' in array declaration",
+                                    currentToken, tokenArrayEnd);
+    return false;
+  }
+  if (currentToken.type_ == tokenArrayEnd)
+    return false;
+  return nextArrayElement();
+}
+
 bool OurReader::decodeNumber(Token& token) {
   Value decoded;
   if (!decodeNumber(token, decoded))
@@ -1651,17 +1852,9 @@ bool OurReader::decodeDouble(Token& token) {
 
 bool OurReader::decodeDouble(Token& token, Value& decoded) {
   double value = 0;
-  const String buffer(token.start_, token.end_);
-  IStringStream is(buffer);
-  if (!(is >> value)) {
-    if (value == std::numeric_limits<double>::max())
-      value = std::numeric_limits<double>::infinity();
-    else if (value == std::numeric_limits<double>::lowest())
-      value = -std::numeric_limits<double>::infinity();
-    else if (!std::isinf(value))
-      return addError(
+  if (!decodeRealToken(token.start_, token.end_, value))
+    return addError(
         "'" + String(token.start_, token.end_) + "' is not a number.", token);
-  }
   decoded = value;
   return true;
 }
@@ -1682,6 +1875,12 @@ bool OurReader::decodeString(Token& token, String& decoded) {
   Location current = token.start_ + 1; // skip '"'
   Location end = token.end_ - 1;       // do not include '"'
   while (current != end) {
+    // Copy the run up to the next escape in one go.
+    Location special = findQuoteOrBackslash(current, end, '"');
+    decoded.append(current, special);
+    current = special;
+    if (current == end)
+      break;
     Char c = *current++;
     if (c == '"')
       break;
@@ -1809,7 +2008,7 @@ bool OurReader::addErrorAndRecover(const String& message, Token& token,
   return recoverFromError(skipUntilToken);
 }
 
-Value& OurReader::currentValue() { return *(nodes_.top()); }
+Value& OurReader::currentValue() { return *(nodes_.back().value); }
 
 OurReader::Char OurReader::getNextChar() {
   if (current_ == end_)
@@ -1979,6 +2178,7 @@ void CharReaderBuilder::setDefaults(Json::Value* settings) {
 //////////////////////////////////
 // global functions
 
+#if !JSONCPP_NO_IOSTREAM
 bool parseFromStream(CharReader::Factory const& fact, IStream& sin, Value* root,
                      String* errs) {
   OStringStream ssin;
@@ -2000,5 +2200,6 @@ IStream& operator>>(IStream& sin, Value& root) {
   }
   return sin;
 }
+#endif // if !JSONCPP_NO_IOSTREAM
 
 } // namespace Json
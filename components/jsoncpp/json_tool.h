@@ -18,6 +18,8 @@
 #ifndef JSONCPP_NO_LOCALE_SUPPORT
 #include <clocale>
 #endif
+#include <cstddef>
+#include <cstring>
 
 /* This header provides common string manipulation support, such as UTF-8,
  * portable conversion from/to string...
@@ -86,6 +88,72 @@ static inline void uintToString(LargestUInt value, char*& current) {
   } while (value != 0);
 }
 
+// Word-at-a-time (SWAR) scanning for the string fast paths of the reader and
+// the writer. A word is 32 bits on Xtensa and 64 bits on the host; unaligned
+// loads go through memcpy so this stays portable.
+using ScanWord = size_t;
+
+static inline ScanWord scanBroadcast(unsigned char c) {
+  return (~ScanWord(0) / 0xFF) * c;
+}
+
+/// Non-zero if any byte of \a x is below \a n (n <= 0x80).
+static inline ScanWord scanHasLess(ScanWord x, unsigned char n) {
+  return (x - scanBroadcast(n)) & ~x & scanBroadcast(0x80);
+}
+
+/// Non-zero if any byte of \a x equals \a c.
+static inline ScanWord scanHasByte(ScanWord x, unsigned char c) {
+  return scanHasLess(x ^ scanBroadcast(c), 1);
+}
+
+/** Return the first position in [begin, end) holding '"', '\\', a control
+ * character or, if \a stopOnNonAscii, a byte >= 0x80; \a end if none.
+ */
+static inline const char* findCharRequiringEscaping(const char* begin,
+                                                    const char* end,
+                                                    bool stopOnNonAscii) {
+  const ScanWord highBits = stopOnNonAscii ? scanBroadcast(0x80) : 0;
+  while (static_cast<size_t>(end - begin) >= sizeof(ScanWord)) {
+    ScanWord w;
+    memcpy(&w, begin, sizeof(w));
+    if ((w & highBits) | scanHasLess(w, 0x20) | scanHasByte(w, '"') |
+        scanHasByte(w, '\\'))
+      break;
+    begin += sizeof(ScanWord);
+  }
+  for (; begin != end; ++begin) {
+    const auto c = static_cast<unsigned char>(*begin);
+    if (c < 0x20 || c == '"' || c == '\\' || (stopOnNonAscii && c >= 0x80))
+      break;
+  }
+  return begin;
+}
+
+/// Return the first '\\' or \a quote in [begin, end); \a end if none.
+static inline const char* findQuoteOrBackslash(const char* begin,
+                                               const char* end, char quote) {
+  while (static_cast<size_t>(end - begin) >= sizeof(ScanWord)) {
+    ScanWord w;
+    memcpy(&w, begin, sizeof(w));
+    if (scanHasByte(w, static_cast<unsigned char>(quote)) |
+        scanHasByte(w, '\\'))
+      break;
+    begin += sizeof(ScanWord);
+  }
+  for (; begin != end; ++begin) {
+    if (*begin == quote || *begin == '\\')
+      break;
+  }
+  return begin;
+}
+
+/** Convert the number token [begin, end) to a double exactly like the
+ * readers do. Defined in json_reader.cpp.
+ * \return false if the token is not a number.
+ */
+bool decodeRealToken(const char* begin, const char* end, double& value);
+
 /** Change ',' to '.' everywhere in buffer.
  *
  * We had a sophisticated way, but it did not work in WinCE.
@@ -12,11 +12,15 @@
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdio>
 #include <cstring>
-#include <iostream>
-#include <sstream>
+#include <new>
 #include <utility>
 
+#if !JSONCPP_NO_IOSTREAM
+#include <iostream>
+#endif
+
 // Provide implementation equivalent of std::snprintf for older _MSC compilers
 #if defined(_MSC_VER) && _MSC_VER < 1900
 #include <stdarg.h>
@@ -48,6 +52,7 @@ int JSON_API msvc_pre1900_c99_snprintf(char* outBuf, size_t size,
 #define JSON_ASSERT_UNREACHABLE assert(false)
 
 namespace Json {
+#if !JSONCPP_LEAN_VALUE
 template <typename T>
 static std::unique_ptr<T> cloneUnique(const std::unique_ptr<T>& p) {
   std::unique_ptr<T> r;
@@ -56,6 +61,7 @@ static std::unique_ptr<T> cloneUnique(const std::unique_ptr<T>& p) {
   }
   return r;
 }
+#endif // if !JSONCPP_LEAN_VALUE
 
 // This is a walkaround to avoid the static initialization of Value::null.
 // kNull must be word-aligned to avoid crashing on ARM.  We use an alignment of
@@ -105,6 +111,48 @@ static inline bool InRange(double d, T min, U max) {
 }
 #endif // if !defined(JSON_USE_INT64_DOUBLE_CONVERSION)
 
+// Allocator hooks
+// //////////////////////////////////////////////////////////////////
+
+static void* defaultAllocate(size_t size, void*) { return malloc(size); }
+static void defaultRelease(void* pointer, void*) { free(pointer); }
+
+// Constant initialized, so usable from other static constructors.
+static AllocatorHooks allocatorHooks = {defaultAllocate, defaultRelease,
+                                        nullptr};
+
+void setAllocatorHooks(const AllocatorHooks* hooks) {
+  if (hooks)
+    allocatorHooks = *hooks;
+  else
+    allocatorHooks = {defaultAllocate, defaultRelease, nullptr};
+}
+
+void* allocateMemory(size_t size) {
+  void* pointer = allocatorHooks.allocate(size ? size : 1,
+                                          allocatorHooks.context);
+  if (pointer == nullptr)
+    throwRuntimeError("in Json::allocateMemory(): out of memory");
+  return pointer;
+}
+
+void releaseMemory(void* pointer) {
+  if (pointer)
+    allocatorHooks.release(pointer, allocatorHooks.context);
+}
+
+template <typename... Args>
+static inline Value::ObjectValues* newObjectValues(Args&&... args) {
+  return new (allocateMemory(sizeof(Value::ObjectValues)))
+      Value::ObjectValues(std::forward<Args>(args)...);
+}
+
+static inline void deleteObjectValues(Value::ObjectValues* map) {
+  using ObjectValues = Value::ObjectValues;
+  map->~ObjectValues();
+  releaseMemory(map);
+}
+
 /** Duplicates the specified string value.
  * @param value Pointer to the string to duplicate. Must be zero-terminated if
  *              length is "unknown".
@@ -113,16 +161,12 @@ static inline bool InRange(double d, T min, U max) {
  * @return Pointer on the duplicate instance of string.
  */
 static inline char* duplicateStringValue(const char* value, size_t length) {
-  // Avoid an integer overflow in the call to malloc below by limiting length
-  // to a sane value.
+  // Avoid an integer overflow in the call to allocateMemory below by
+  // limiting length to a sane value.
   if (length >= static_cast<size_t>(Value::maxInt))
     length = Value::maxInt - 1;
 
-  auto newString = static_cast<char*>(malloc(length + 1));
-  if (newString == nullptr) {
-    throwRuntimeError("in Json::Value::duplicateStringValue(): "
-                      "Failed to allocate string value buffer");
-  }
+  auto newString = static_cast<char*>(allocateMemory(length + 1));
   memcpy(newString, value, length);
   newString[length] = 0;
   return newString;
@@ -132,18 +176,14 @@ static inline char* duplicateStringValue(const char* value, size_t length) {
  */
 static inline char* duplicateAndPrefixStringValue(const char* value,
                                                   unsigned int length) {
-  // Avoid an integer overflow in the call to malloc below by limiting length
-  // to a sane value.
+  // Avoid an integer overflow in the call to allocateMemory below by
+  // limiting length to a sane value.
   JSON_ASSERT_MESSAGE(length <= static_cast<unsigned>(Value::maxInt) -
                                     sizeof(unsigned) - 1U,
                       "in Json::Value::duplicateAndPrefixStringValue(): "
                       "length too big for prefixing");
   size_t actualLength = sizeof(length) + length + 1;
-  auto newString = static_cast<char*>(malloc(actualLength));
-  if (newString == nullptr) {
-    throwRuntimeError("in Json::Value::duplicateAndPrefixStringValue(): "
-                      "Failed to allocate string value buffer");
-  }
+  auto newString = static_cast<char*>(allocateMemory(actualLength));
   *reinterpret_cast<unsigned*>(newString) = length;
   memcpy(newString + sizeof(unsigned), value, length);
   newString[actualLength - 1U] =
@@ -170,17 +210,21 @@ static inline void releasePrefixedStringValue(char* value) {
   decodePrefixedString(true, value, &length, &valueDecoded);
   size_t const size = sizeof(unsigned) + length + 1U;
   memset(value, 0, size);
-  free(value);
+  releaseMemory(value);
 }
 static inline void releaseStringValue(char* value, unsigned length) {
   // length==0 => we allocated the strings memory
   size_t size = (length == 0) ? strlen(value) : length;
   memset(value, 0, size);
-  free(value);
+  releaseMemory(value);
 }
 #else  // !JSONCPP_USING_SECURE_MEMORY
-static inline void releasePrefixedStringValue(char* value) { free(value); }
-static inline void releaseStringValue(char* value, unsigned) { free(value); }
+static inline void releasePrefixedStringValue(char* value) {
+  releaseMemory(value);
+}
+static inline void releaseStringValue(char* value, unsigned) {
+  releaseMemory(value);
+}
 #endif // JSONCPP_USING_SECURE_MEMORY
 
 } // namespace Json
@@ -211,6 +255,15 @@ JSONCPP_NORETURN void throwRuntimeError(String const& msg) {
 JSONCPP_NORETURN void throwLogicError(String const& msg) {
   throw LogicError(msg);
 }
+#elif JSONCPP_NO_IOSTREAM
+JSONCPP_NORETURN void throwRuntimeError(String const& msg) {
+  fprintf(stderr, "%s\n", msg.c_str());
+  abort();
+}
+JSONCPP_NORETURN void throwLogicError(String const& msg) {
+  fprintf(stderr, "%s\n", msg.c_str());
+  abort();
+}
 #else // !JSON_USE_EXCEPTION
 JSONCPP_NORETURN void throwRuntimeError(String const& msg) {
   std::cerr << msg << std::endl;
@@ -363,7 +416,7 @@ Value::Value(ValueType type) {
     break;
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues();
+    value_.map_ = newObjectValues();
     break;
   case booleanValue:
     value_.bool_ = false;
@@ -465,9 +518,11 @@ void Value::copyPayload(const Value& other) {
 
 void Value::swap(Value& other) {
   swapPayload(other);
+#if !JSONCPP_LEAN_VALUE
   std::swap(comments_, other.comments_);
   std::swap(start_, other.start_);
   std::swap(limit_, other.limit_);
+#endif
 }
 
 void Value::copy(const Value& other) {
@@ -891,8 +946,10 @@ void Value::clear() {
   JSON_ASSERT_MESSAGE(type() == nullValue || type() == arrayValue ||
                           type() == objectValue,
                       "in Json::Value::clear(): requires complex value");
+#if !JSONCPP_LEAN_VALUE
   start_ = 0;
   limit_ = 0;
+#endif
   switch (type()) {
   case arrayValue:
   case objectValue:
@@ -968,9 +1025,11 @@ const Value& Value::operator[](int index) const {
 void Value::initBasic(ValueType type, bool allocated) {
   setType(type);
   setIsAllocated(allocated);
+#if !JSONCPP_LEAN_VALUE
   comments_ = Comments{};
   start_ = 0;
   limit_ = 0;
+#endif
 }
 
 void Value::dupPayload(const Value& other) {
@@ -998,7 +1057,7 @@ void Value::dupPayload(const Value& other) {
     break;
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues(*other.value_.map_);
+    value_.map_ = newObjectValues(*other.value_.map_);
     break;
   default:
     JSON_ASSERT_UNREACHABLE;
@@ -1019,7 +1078,7 @@ void Value::releasePayload() {
     break;
   case arrayValue:
   case objectValue:
-    delete value_.map_;
+    deleteObjectValues(value_.map_);
     break;
   default:
     JSON_ASSERT_UNREACHABLE;
@@ -1027,9 +1086,13 @@ void Value::releasePayload() {
 }
 
 void Value::dupMeta(const Value& other) {
+#if JSONCPP_LEAN_VALUE
+  static_cast<void>(other);
+#else
   comments_ = other.comments_;
   start_ = other.start_;
   limit_ = other.limit_;
+#endif
 }
 
 // Access an object value by name, create a null member if it does not exist.
@@ -1371,6 +1434,7 @@ bool Value::isArray() const { return type() == arrayValue; }
 
 bool Value::isObject() const { return type() == objectValue; }
 
+#if !JSONCPP_LEAN_VALUE
 Value::Comments::Comments(const Comments& that)
     : ptr_{cloneUnique(that.ptr_)} {}
 
@@ -1432,6 +1496,7 @@ void Value::setOffsetLimit(ptrdiff_t limit) { limit_ = limit; }
 ptrdiff_t Value::getOffsetStart() const { return start_; }
 
 ptrdiff_t Value::getOffsetLimit() const { return limit_; }
+#endif // if !JSONCPP_LEAN_VALUE
 
 String Value::toStyledString() const {
   StreamWriterBuilder builder;
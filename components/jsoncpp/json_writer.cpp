@@ -5,18 +5,24 @@
 
 #if !defined(JSON_IS_AMALGAMATION)
 #include "json_tool.h"
+#include <bind.h>
 #include <writer.h>
 #endif // if !defined(JSON_IS_AMALGAMATION)
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cstdint>
 #include <cstring>
-#include <iomanip>
+#include <limits>
 #include <memory>
 #include <set>
-#include <sstream>
 #include <utility>
 
+#if !JSONCPP_NO_IOSTREAM
+#include <ostream>
+#include <sstream>
+#endif
+
 #if __cplusplus >= 201103L
 #include <cmath>
 #include <cstdio>
@@ -83,6 +89,10 @@
 #pragma warning(disable : 4996)
 #endif
 
+#if !defined(JSON_IS_AMALGAMATION)
+#include "json_number_format.inl"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+
 namespace Json {
 
 #if __cplusplus >= 201103L || (defined(_CPPLIB_VER) && _CPPLIB_VER >= 520)
@@ -124,18 +134,11 @@ String valueToString(UInt value) { return valueToString(LargestUInt(value)); }
 #endif // # if defined(JSON_HAS_INT64)
 
 namespace {
-String valueToString(double value, bool useSpecialFloats,
-                     unsigned int precision, PrecisionType precisionType) {
-  // Print into the buffer. We need not request the alternative representation
-  // that always has a decimal point because JSON doesn't distinguish the
-  // concepts of reals and integers.
-  if (!isfinite(value)) {
-    static const char* const reps[2][3] = {{"NaN", "-Infinity", "Infinity"},
-                                           {"null", "-1e+9999", "1e+9999"}};
-    return reps[useSpecialFloats ? 0 : 1]
-               [isnan(value) ? 0 : (value < 0) ? 1 : 2];
-  }
+// Buffer large enough for every representation produced without snprintf.
+const size_t doubleToCharsBufferSize = 64;
 
+String formatDoubleWithPrintf(double value, unsigned int precision,
+                              PrecisionType precisionType) {
   String buffer(size_t(36), '\0');
   while (true) {
     int len = jsoncpp_snprintf(
@@ -168,8 +171,85 @@ String valueToString(double value, bool useSpecialFloats,
 
   return buffer;
 }
+
+size_t copyChars(const char* begin, const char* end, char* buffer,
+                 size_t size) {
+  const auto length = static_cast<size_t>(end - begin);
+  if (size != 0) {
+    const size_t n = std::min(length, size - 1);
+    memcpy(buffer, begin, n);
+    buffer[n] = '\0';
+  }
+  return length;
+}
+
+size_t valueToChars(double value, char* buffer, size_t size,
+                    bool useSpecialFloats, unsigned int precision,
+                    PrecisionType precisionType) {
+  // Print into the buffer. We need not request the alternative representation
+  // that always has a decimal point because JSON doesn't distinguish the
+  // concepts of reals and integers.
+  if (!isfinite(value)) {
+    static const char* const reps[2][3] = {{"NaN", "-Infinity", "Infinity"},
+                                           {"null", "-1e+9999", "1e+9999"}};
+    const char* rep =
+        reps[useSpecialFloats ? 0 : 1][isnan(value) ? 0 : (value < 0) ? 1 : 2];
+    return copyChars(rep, rep + strlen(rep), buffer, size);
+  }
+
+  char local[doubleToCharsBufferSize];
+  char* end = nullptr;
+  if (precisionType == PrecisionType::significantDigits &&
+      precision == std::numeric_limits<double>::max_digits10) {
+    // "%.17g" always round-trips; the shortest string that does is the same
+    // value spelled with fewer digits.
+    end = formatShortest(local, value);
+  } else if (precisionType == PrecisionType::decimalPlaces) {
+    end = formatFixed(local, value, precision);
+  } else {
+    int len = jsoncpp_snprintf(local, sizeof(local), "%.*g", precision, value);
+    assert(len >= 0);
+    if (static_cast<size_t>(len) < sizeof(local) - 2) {
+      end = local + len;
+      fixNumericLocale(local, end);
+    }
+  }
+  if (end == nullptr) {
+    const String slow = formatDoubleWithPrintf(value, precision, precisionType);
+    return copyChars(slow.data(), slow.data() + slow.size(), buffer, size);
+  }
+
+  // try to ensure we preserve the fact that this was given to us as a double on
+  // input
+  if (std::find(local, end, '.') == end && std::find(local, end, 'e') == end) {
+    *end++ = '.';
+    *end++ = '0';
+  }
+
+  // strip the zero padding from the right
+  if (precisionType == PrecisionType::decimalPlaces) {
+    end = fixZerosInTheEnd(local, end, precision);
+  }
+
+  return copyChars(local, end, buffer, size);
+}
+
+String valueToString(double value, bool useSpecialFloats,
+                     unsigned int precision, PrecisionType precisionType) {
+  char buffer[doubleToCharsBufferSize];
+  const size_t length = valueToChars(value, buffer, sizeof(buffer),
+                                     useSpecialFloats, precision, precisionType);
+  if (length < sizeof(buffer))
+    return String(buffer, length);
+  return formatDoubleWithPrintf(value, precision, precisionType);
+}
 } // namespace
 
+size_t valueToChars(double value, char* buffer, size_t size,
+                    unsigned int precision, PrecisionType precisionType) {
+  return valueToChars(value, buffer, size, false, precision, precisionType);
+}
+
 String valueToString(double value, unsigned int precision,
                      PrecisionType precisionType) {
   return valueToString(value, false, precision, precisionType);
@@ -180,9 +260,7 @@ String valueToString(bool value) { return value ? "true" : "false"; }
 static bool doesAnyCharRequireEscaping(char const* s, size_t n) {
   assert(s || !n);
 
-  return std::any_of(s, s + n, [](unsigned char c) {
-    return c == '\\' || c == '"' || c < 0x20 || c > 0x7F;
-  });
+  return findCharRequiringEscaping(s, s + n, true) != s + n;
 }
 
 static unsigned int utf8ToCodepoint(const char*& s, const char* e) {
@@ -253,62 +331,83 @@ static const char hex2[] = "000102030405060708090a0b0c0d0e0f"
                            "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
                            "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
 
-static String toHex16Bit(unsigned int x) {
-  const unsigned int hi = (x >> 8) & 0xff;
-  const unsigned int lo = x & 0xff;
-  String result(4, ' ');
-  result[0] = hex2[2 * hi];
-  result[1] = hex2[2 * hi + 1];
-  result[2] = hex2[2 * lo];
-  result[3] = hex2[2 * lo + 1];
-  return result;
-}
+namespace {
+/// WriterSink appending to a String; backs the String returning writers.
+class StringSink : public WriterSink {
+public:
+  explicit StringSink(String& out) : out_(out) {}
+  bool write(const char* data, size_t length) override {
+    out_.append(data, length);
+    return true;
+  }
 
-static void appendRaw(String& result, unsigned ch) {
-  result += static_cast<char>(ch);
-}
+private:
+  String& out_;
+};
+
+#if !JSONCPP_NO_IOSTREAM
+/// WriterSink forwarding to an OStream; backs StreamWriter::write(OStream*).
+class OStreamSink : public WriterSink {
+public:
+  explicit OStreamSink(OStream& out) : out_(out) {}
+  bool write(const char* data, size_t length) override {
+    out_.write(data, static_cast<std::streamsize>(length));
+    return true;
+  }
 
-static void appendHex(String& result, unsigned ch) {
-  result.append("\\u").append(toHex16Bit(ch));
+private:
+  OStream& out_;
+};
+#endif
+} // namespace
+
+static bool writeHex16Bit(WriterSink& sink, unsigned int x) {
+  const unsigned int hi = (x >> 8) & 0xff;
+  const unsigned int lo = x & 0xff;
+  const char escape[6] = {'\\',          'u',
+                          hex2[2 * hi], hex2[2 * hi + 1],
+                          hex2[2 * lo], hex2[2 * lo + 1]};
+  return sink.write(escape, sizeof(escape));
 }
 
-static String valueToQuotedStringN(const char* value, size_t length,
-                                   bool emitUTF8 = false) {
+/// Emit \a value as a quoted JSON string, passing unescaped runs through in
+/// one write() each.
+static bool writeQuotedStringN(WriterSink& sink, const char* value,
+                               size_t length, bool emitUTF8 = false) {
   if (value == nullptr)
-    return "";
+    return true;
 
-  if (!doesAnyCharRequireEscaping(value, length))
-    return String("\"") + value + "\"";
-  // We have to walk value and escape any special characters.
-  // Appending to String is not efficient, but this should be rare.
-  // (Note: forward slashes are *not* rare, but I am not escaping them.)
-  String::size_type maxsize = length * 2 + 3; // allescaped+quotes+NULL
-  String result;
-  result.reserve(maxsize); // to avoid lots of mallocs
-  result += "\"";
+  if (!sink.write("\"", 1))
+    return false;
   char const* end = value + length;
-  for (const char* c = value; c != end; ++c) {
+  char const* run = value;
+  for (const char* c = findCharRequiringEscaping(value, end, !emitUTF8);
+       c != end; c = findCharRequiringEscaping(c + 1, end, !emitUTF8)) {
+    const auto ch = static_cast<unsigned char>(*c);
+    if (c != run && !sink.write(run, static_cast<size_t>(c - run)))
+      return false;
+    const char* escape = nullptr;
     switch (*c) {
     case '\"':
-      result += "\\\"";
+      escape = "\\\"";
       break;
     case '\\':
-      result += "\\\\";
+      escape = "\\\\";
       break;
     case '\b':
-      result += "\\b";
+      escape = "\\b";
       break;
     case '\f':
-      result += "\\f";
+      escape = "\\f";
       break;
     case '\n':
-      result += "\\n";
+      escape = "\\n";
       break;
     case '\r':
-      result += "\\r";
+      escape = "\\r";
       break;
     case '\t':
-      result += "\\t";
+      escape = "\\t";
       break;
     // case '/':
     // Even though \/ is considered a legal escape in JSON, a bare
@@ -318,34 +417,53 @@ static String valueToQuotedStringN(const char* value, size_t length,
     // sequence.
     // Should add a flag to allow this compatibility mode and prevent this
     // sequence from occurring.
-    default: {
-      if (emitUTF8) {
-        unsigned codepoint = static_cast<unsigned char>(*c);
-        if (codepoint < 0x20) {
-          appendHex(result, codepoint);
-        } else {
-          appendRaw(result, codepoint);
-        }
+    default:
+      break;
+    }
+    bool ok = true;
+    if (escape != nullptr) {
+      ok = sink.write(escape, 2);
+    } else if (emitUTF8 || ch < 0x80) {
+      // Only control characters get here.
+      ok = writeHex16Bit(sink, ch);
+    } else {
+      unsigned codepoint = utf8ToCodepoint(c, end); // modifies `c`
+      if (codepoint < 0x10000) {
+        // Basic Multilingual Plane
+        ok = writeHex16Bit(sink, codepoint);
       } else {
-        unsigned codepoint = utf8ToCodepoint(c, end); // modifies `c`
-        if (codepoint < 0x20) {
-          appendHex(result, codepoint);
-        } else if (codepoint < 0x80) {
-          appendRaw(result, codepoint);
-        } else if (codepoint < 0x10000) {
-          // Basic Multilingual Plane
-          appendHex(result, codepoint);
-        } else {
-          // Extended Unicode. Encode 20 bits as a surrogate pair.
-          codepoint -= 0x10000;
-          appendHex(result, 0xd800 + ((codepoint >> 10) & 0x3ff));
-          appendHex(result, 0xdc00 + (codepoint & 0x3ff));
-        }
+        // Extended Unicode. Encode 20 bits as a surrogate pair.
+        codepoint -= 0x10000;
+        ok = writeHex16Bit(sink, 0xd800 + ((codepoint >> 10) & 0x3ff)) &&
+             writeHex16Bit(sink, 0xdc00 + (codepoint & 0x3ff));
       }
-    } break;
     }
+    if (!ok)
+      return false;
+    run = c + 1;
   }
-  result += "\"";
+  if (end != run && !sink.write(run, static_cast<size_t>(end - run)))
+    return false;
+  return sink.write("\"", 1);
+}
+
+static String valueToQuotedStringN(const char* value, size_t length,
+                                   bool emitUTF8 = false) {
+  if (value == nullptr)
+    return "";
+
+  String result;
+  if (!doesAnyCharRequireEscaping(value, length)) {
+    result.reserve(length + 2);
+    result += '"';
+    result.append(value, length);
+    result += '"';
+    return result;
+  }
+  // We have to walk value and escape any special characters.
+  result.reserve(length * 2 + 3); // to avoid lots of mallocs
+  StringSink sink(result);
+  writeQuotedStringN(sink, value, length, emitUTF8);
   return result;
 }
 
@@ -353,6 +471,207 @@ String valueToQuotedString(const char* value) {
   return valueToQuotedStringN(value, strlen(value));
 }
 
+// Class WriterSink
+// //////////////////////////////////////////////////////////////////
+WriterSink::~WriterSink() = default;
+
+bool WriterSink::flush() { return true; }
+
+BufferSink::BufferSink(char* buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity) {
+  if (capacity_ != 0)
+    buffer_[0] = '\0';
+}
+
+bool BufferSink::write(const char* data, size_t length) {
+  const size_t offset = size_;
+  size_ += length;
+  if (overflowed_)
+    return false;
+  // Keep one byte for the terminating NUL.
+  if (capacity_ == 0 ? length != 0 : length > capacity_ - 1 - offset) {
+    overflowed_ = true;
+    if (capacity_ != 0) {
+      const size_t fits = capacity_ - 1 - offset;
+      memcpy(buffer_ + offset, data, fits);
+      buffer_[offset + fits] = '\0';
+    }
+    return false;
+  }
+  memcpy(buffer_ + offset, data, length);
+  buffer_[size_] = '\0';
+  return true;
+}
+
+CallbackSink::CallbackSink(Callback callback, void* context)
+    : callback_(callback), context_(context) {}
+
+bool CallbackSink::write(const char* data, size_t length) {
+  while (length != 0) {
+    if (used_ == sizeof(chunk_) && !flush())
+      return false;
+    const size_t n = std::min(length, sizeof(chunk_) - used_);
+    memcpy(chunk_ + used_, data, n);
+    used_ += n;
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+bool CallbackSink::flush() {
+  const size_t used = used_;
+  used_ = 0;
+  return used == 0 || callback_(chunk_, used, context_);
+}
+
+bool CountingSink::write(const char* /*data*/, size_t length) {
+  size_ += length;
+  return true;
+}
+
+static bool writeChars(WriterSink& sink, const String& value) {
+  return sink.write(value.data(), value.size());
+}
+
+static bool writeInteger(WriterSink& sink, LargestUInt magnitude,
+                         bool negative) {
+  UIntToStringBuffer buffer;
+  char* current = buffer + sizeof(buffer);
+  uintToString(magnitude, current);
+  if (negative)
+    *--current = '-';
+  assert(current >= buffer);
+  return sink.write(current,
+                    static_cast<size_t>(buffer + sizeof(buffer) - 1 - current));
+}
+
+static bool writeReal(WriterSink& sink, double value, bool useSpecialFloats,
+                      unsigned int precision, PrecisionType precisionType) {
+  char buffer[doubleToCharsBufferSize];
+  const size_t length = valueToChars(value, buffer, sizeof(buffer),
+                                     useSpecialFloats, precision, precisionType);
+  if (length < sizeof(buffer))
+    return sink.write(buffer, length);
+  return writeChars(sink, valueToString(value, useSpecialFloats, precision,
+                                        precisionType));
+}
+
+// Bound fields
+// //////////////////////////////////////////////////////////////////
+
+/// "%.*f" without the zero stripping of the Value writers, so that bound
+/// structs print exactly what the snprintf code they replace printed.
+static bool writeFixed(WriterSink& sink, double value, unsigned int decimals) {
+  char buffer[doubleToCharsBufferSize];
+  const char* end = formatFixed(buffer, value, decimals);
+  if (end != nullptr)
+    return sink.write(buffer, static_cast<size_t>(end - buffer));
+  const int length = jsoncpp_snprintf(nullptr, 0, "%.*f", decimals, value);
+  String slow(static_cast<size_t>(length) + 1, '\0');
+  jsoncpp_snprintf(&slow[0], slow.size(), "%.*f", decimals, value);
+  fixNumericLocale(slow.begin(), slow.end());
+  return sink.write(slow.data(), static_cast<size_t>(length));
+}
+
+template <class Int> static Int loadBound(const void* member) {
+  Int value;
+  memcpy(&value, member, sizeof(value));
+  return value;
+}
+
+static bool writeBoundValue(WriterSink& sink, const BoundField& field,
+                            const void* member) {
+  switch (field.type) {
+  case BindType::boolField:
+    return *static_cast<const bool*>(member) ? sink.write("true", 4)
+                                             : sink.write("false", 5);
+  case BindType::signedField: {
+    LargestInt value;
+    switch (field.size) {
+    case 1:
+      value = loadBound<int8_t>(member);
+      break;
+    case 2:
+      value = loadBound<int16_t>(member);
+      break;
+    case 4:
+      value = loadBound<int32_t>(member);
+      break;
+    default:
+      value = loadBound<int64_t>(member);
+      break;
+    }
+    return value < 0 ? writeInteger(sink, 0 - LargestUInt(value), true)
+                     : writeInteger(sink, LargestUInt(value), false);
+  }
+  case BindType::unsignedField: {
+    LargestUInt value;
+    switch (field.size) {
+    case 1:
+      value = loadBound<uint8_t>(member);
+      break;
+    case 2:
+      value = loadBound<uint16_t>(member);
+      break;
+    case 4:
+      value = loadBound<uint32_t>(member);
+      break;
+    default:
+      value = loadBound<uint64_t>(member);
+      break;
+    }
+    return writeInteger(sink, value, false);
+  }
+  case BindType::floatField:
+  case BindType::doubleField: {
+    const double value = field.type == BindType::floatField
+                             ? *static_cast<const float*>(member)
+                             : *static_cast<const double*>(member);
+    if (!isfinite(value))
+      return sink.write("null", 4);
+    if (field.format != bindShortest)
+      return writeFixed(sink, value, field.format);
+    return writeReal(sink, value, false, 17, PrecisionType::significantDigits);
+  }
+  case BindType::charsField: {
+    const auto* chars = static_cast<const char*>(member);
+    const void* nul = memchr(chars, '\0', field.size);
+    const size_t length =
+        nul ? static_cast<size_t>(static_cast<const char*>(nul) - chars)
+            : field.size;
+    return writeQuotedStringN(sink, chars, length, true);
+  }
+  case BindType::stringField: {
+    const auto& string = *static_cast<const String*>(member);
+    return writeQuotedStringN(sink, string.data(), string.size(), true);
+  }
+  case BindType::cStringField: {
+    const char* string = *static_cast<const char* const*>(member);
+    return writeQuotedStringN(sink, string, strlen(string), true);
+  }
+  }
+  return false;
+}
+
+bool writeBoundFields(WriterSink& sink, const BoundField* const* fields,
+                      const void* const* members, size_t count) {
+  if (!sink.write("{", 1))
+    return false;
+  size_t comma = 1; // the first key is written without its leading comma
+  for (size_t i = 0; i < count; ++i) {
+    const BoundField& field = *fields[i];
+    if (field.type == BindType::cStringField &&
+        *static_cast<const char* const*>(members[i]) == nullptr)
+      continue;
+    if (!sink.write(field.key + comma, field.keyLength - comma) ||
+        !writeBoundValue(sink, field, members[i]))
+      return false;
+    comma = 0;
+  }
+  return sink.write("}", 1) && sink.flush();
+}
+
 // Class Writer
 // //////////////////////////////////////////////////////////////////
 Writer::~Writer() = default;
@@ -372,63 +691,85 @@ void FastWriter::omitEndingLineFeed() { omitEndingLineFeed_ = true; }
 
 String FastWriter::write(const Value& root) {
   document_.clear();
-  writeValue(root);
-  if (!omitEndingLineFeed_)
-    document_ += '\n';
+  StringSink sink(document_);
+  write(root, sink);
   return document_;
 }
 
-void FastWriter::writeValue(const Value& value) {
+bool FastWriter::write(const Value& root, WriterSink& sink) {
+  if (!writeValue(root, sink))
+    return false;
+  if (!omitEndingLineFeed_ && !sink.write("\n", 1))
+    return false;
+  return sink.flush();
+}
+
+size_t FastWriter::measure(const Value& root) {
+  CountingSink sink;
+  write(root, sink);
+  return sink.size();
+}
+
+bool FastWriter::writeValue(const Value& value, WriterSink& sink) {
   switch (value.type()) {
   case nullValue:
-    if (!dropNullPlaceholders_)
-      document_ += "null";
-    break;
-  case intValue:
-    document_ += valueToString(value.asLargestInt());
-    break;
+    return dropNullPlaceholders_ || sink.write("null", 4);
+  case intValue: {
+    const LargestInt i = value.asLargestInt();
+    return writeInteger(sink,
+                        i < 0 ? LargestUInt(0) - LargestUInt(i)
+                              : LargestUInt(i),
+                        i < 0);
+  }
   case uintValue:
-    document_ += valueToString(value.asLargestUInt());
-    break;
+    return writeInteger(sink, value.asLargestUInt(), false);
   case realValue:
-    document_ += valueToString(value.asDouble());
-    break;
+    return writeReal(sink, value.asDouble(), false,
+                     Value::defaultRealPrecision,
+                     PrecisionType::significantDigits);
   case stringValue: {
     // Is NULL possible for value.string_? No.
     char const* str;
     char const* end;
     bool ok = value.getString(&str, &end);
-    if (ok)
-      document_ += valueToQuotedStringN(str, static_cast<size_t>(end - str));
-    break;
+    return !ok ||
+           writeQuotedStringN(sink, str, static_cast<size_t>(end - str));
   }
   case booleanValue:
-    document_ += valueToString(value.asBool());
-    break;
+    return value.asBool() ? sink.write("true", 4) : sink.write("false", 5);
   case arrayValue: {
-    document_ += '[';
+    if (!sink.write("[", 1))
+      return false;
     ArrayIndex size = value.size();
     for (ArrayIndex index = 0; index < size; ++index) {
-      if (index > 0)
-        document_ += ',';
-      writeValue(value[index]);
+      if (index > 0 && !sink.write(",", 1))
+        return false;
+      if (!writeValue(value[index], sink))
+        return false;
     }
-    document_ += ']';
-  } break;
+    return sink.write("]", 1);
+  }
   case objectValue: {
-    Value::Members members(value.getMemberNames());
-    document_ += '{';
-    for (auto it = members.begin(); it != members.end(); ++it) {
-      const String& name = *it;
-      if (it != members.begin())
-        document_ += ',';
-      document_ += valueToQuotedStringN(name.data(), name.length());
-      document_ += yamlCompatibilityEnabled_ ? ": " : ":";
-      writeValue(value[name]);
+    // Iterating the map visits members in the same order as getMemberNames()
+    // without copying every key.
+    if (!sink.write("{", 1))
+      return false;
+    const char* colon = yamlCompatibilityEnabled_ ? ": " : ":";
+    bool first = true;
+    for (auto it = value.begin(); it != value.end(); ++it) {
+      if (!first && !sink.write(",", 1))
+        return false;
+      first = false;
+      char const* end;
+      char const* name = it.memberName(&end);
+      if (!writeQuotedStringN(sink, name, static_cast<size_t>(end - name)) ||
+          !sink.write(colon, strlen(colon)) || !writeValue(*it, sink))
+        return false;
     }
-    document_ += '}';
-  } break;
+    return sink.write("}", 1);
+  }
   }
+  return true;
 }
 
 // Class StyledWriter
@@ -643,6 +984,7 @@ bool StyledWriter::hasCommentForValue(const Value& value) {
          value.hasComment(commentAfter);
 }
 
+#if !JSONCPP_NO_IOSTREAM
 // Class StyledStreamWriter
 // //////////////////////////////////////////////////////////////////
 
@@ -861,6 +1203,7 @@ bool StyledStreamWriter::hasCommentForValue(const Value& value) {
          value.hasComment(commentAfterOnSameLine) ||
          value.hasComment(commentAfter);
 }
+#endif // if !JSONCPP_NO_IOSTREAM
 
 //////////////////////////
 // BuiltStyledStreamWriter
@@ -881,9 +1224,16 @@ struct BuiltStyledStreamWriter : public StreamWriter {
                           String endingLineFeedSymbol, bool useSpecialFloats,
                           bool emitUTF8, unsigned int precision,
                           PrecisionType precisionType);
+#if !JSONCPP_NO_IOSTREAM
   int write(Value const& root, OStream* sout) override;
+#endif
+  int write(Value const& root, WriterSink* sink) override;
 
 private:
+  void emit(const char* data, size_t length);
+  void emit(String const& value) { emit(value.data(), value.size()); }
+  void emit(const char* value) { emit(value, strlen(value)); }
+  void emit(char c) { emit(&c, 1); }
   void writeValue(Value const& value);
   void writeArrayValue(Value const& value);
   bool isMultilineArray(Value const& value);
@@ -912,6 +1262,8 @@ private:
   bool emitUTF8_ : 1;
   unsigned int precision_;
   PrecisionType precisionType_;
+  WriterSink* sink_{nullptr};
+  bool sinkFailed_{false};
 };
 BuiltStyledStreamWriter::BuiltStyledStreamWriter(
     String indentation, CommentStyle::Enum cs, String colonSymbol,
@@ -923,8 +1275,18 @@ BuiltStyledStreamWriter::BuiltStyledStreamWriter(
       addChildValues_(false), indented_(false),
       useSpecialFloats_(useSpecialFloats), emitUTF8_(emitUTF8),
       precision_(precision), precisionType_(precisionType) {}
+#if !JSONCPP_NO_IOSTREAM
 int BuiltStyledStreamWriter::write(Value const& root, OStream* sout) {
   sout_ = sout;
+  OStreamSink sink(*sout);
+  int result = write(root, &sink);
+  sout_ = nullptr;
+  return result;
+}
+#endif
+int BuiltStyledStreamWriter::write(Value const& root, WriterSink* sink) {
+  sink_ = sink;
+  sinkFailed_ = false;
   addChildValues_ = false;
   indented_ = true;
   indentString_.clear();
@@ -934,9 +1296,16 @@ int BuiltStyledStreamWriter::write(Value const& root, OStream* sout) {
   indented_ = true;
   writeValue(root);
   writeCommentAfterValueOnSameLine(root);
-  *sout_ << endingLineFeedSymbol_;
-  sout_ = nullptr;
-  return 0;
+  emit(endingLineFeedSymbol_);
+  if (!sinkFailed_ && !sink_->flush())
+    sinkFailed_ = true;
+  sink_ = nullptr;
+  return sinkFailed_ ? -1 : 0;
+}
+void BuiltStyledStreamWriter::emit(const char* data, size_t length) {
+  // Once the sink refuses data the rest of the document is dropped.
+  if (!sinkFailed_ && !sink_->write(data, length))
+    sinkFailed_ = true;
 }
 void BuiltStyledStreamWriter::writeValue(Value const& value) {
   switch (value.type()) {
@@ -985,13 +1354,13 @@ void BuiltStyledStreamWriter::writeValue(Value const& value) {
         writeCommentBeforeValue(childValue);
         writeWithIndent(
             valueToQuotedStringN(name.data(), name.length(), emitUTF8_));
-        *sout_ << colonSymbol_;
+        emit(colonSymbol_);
         writeValue(childValue);
         if (++it == members.end()) {
           writeCommentAfterValueOnSameLine(childValue);
           break;
         }
-        *sout_ << ",";
+        emit(",");
         writeCommentAfterValueOnSameLine(childValue);
       }
       unindent();
@@ -1028,7 +1397,7 @@ void BuiltStyledStreamWriter::writeArrayValue(Value const& value) {
           writeCommentAfterValueOnSameLine(childValue);
           break;
         }
-        *sout_ << ",";
+        emit(",");
         writeCommentAfterValueOnSameLine(childValue);
       }
       unindent();
@@ -1036,17 +1405,17 @@ void BuiltStyledStreamWriter::writeArrayValue(Value const& value) {
     } else // output on a single line
     {
       assert(childValues_.size() == size);
-      *sout_ << "[";
+      emit("[");
       if (!indentation_.empty())
-        *sout_ << " ";
+        emit(" ");
       for (unsigned index = 0; index < size; ++index) {
         if (index > 0)
-          *sout_ << ((!indentation_.empty()) ? ", " : ",");
-        *sout_ << childValues_[index];
+          emit((!indentation_.empty()) ? ", " : ",");
+        emit(childValues_[index]);
       }
       if (!indentation_.empty())
-        *sout_ << " ";
-      *sout_ << "]";
+        emit(" ");
+      emit("]");
     }
   }
 }
@@ -1082,7 +1451,7 @@ void BuiltStyledStreamWriter::pushValue(String const& value) {
   if (addChildValues_)
     childValues_.push_back(value);
   else
-    *sout_ << value;
+    emit(value);
 }
 
 void BuiltStyledStreamWriter::writeIndent() {
@@ -1093,14 +1462,15 @@ void BuiltStyledStreamWriter::writeIndent() {
 
   if (!indentation_.empty()) {
     // In this case, drop newlines too.
-    *sout_ << '\n' << indentString_;
+    emit('\n');
+    emit(indentString_);
   }
 }
 
 void BuiltStyledStreamWriter::writeWithIndent(String const& value) {
   if (!indented_)
     writeIndent();
-  *sout_ << value;
+  emit(value);
   indented_ = false;
 }
 
@@ -1122,10 +1492,10 @@ void BuiltStyledStreamWriter::writeCommentBeforeValue(Value const& root) {
   const String& comment = root.getComment(commentBefore);
   String::const_iterator iter = comment.begin();
   while (iter != comment.end()) {
-    *sout_ << *iter;
+    emit(*iter);
     if (*iter == '\n' && ((iter + 1) != comment.end() && *(iter + 1) == '/'))
       // writeIndent();  // would write extra newline
-      *sout_ << indentString_;
+      emit(indentString_);
     ++iter;
   }
   indented_ = false;
@@ -1135,12 +1505,14 @@ void BuiltStyledStreamWriter::writeCommentAfterValueOnSameLine(
     Value const& root) {
   if (cs_ == CommentStyle::None)
     return;
-  if (root.hasComment(commentAfterOnSameLine))
-    *sout_ << " " + root.getComment(commentAfterOnSameLine);
+  if (root.hasComment(commentAfterOnSameLine)) {
+    emit(' ');
+    emit(root.getComment(commentAfterOnSameLine));
+  }
 
   if (root.hasComment(commentAfter)) {
     writeIndent();
-    *sout_ << root.getComment(commentAfter);
+    emit(root.getComment(commentAfter));
   }
 }
 
@@ -1154,8 +1526,25 @@ bool BuiltStyledStreamWriter::hasCommentForValue(const Value& value) {
 ///////////////
 // StreamWriter
 
+#if JSONCPP_NO_IOSTREAM
+StreamWriter::StreamWriter() = default;
+#else
 StreamWriter::StreamWriter() : sout_(nullptr) {}
+#endif
 StreamWriter::~StreamWriter() = default;
+#if !JSONCPP_NO_IOSTREAM
+int StreamWriter::write(Value const& root, WriterSink* sink) {
+  OStringStream sout;
+  write(root, &sout);
+  const String document = sout.str();
+  return writeChars(*sink, document) && sink->flush() ? 0 : -1;
+}
+#endif
+size_t StreamWriter::measure(Value const& root) {
+  CountingSink sink;
+  write(root, &sink);
+  return sink.size();
+}
 StreamWriter::Factory::~Factory() = default;
 StreamWriterBuilder::StreamWriterBuilder() { setDefaults(&settings_); }
 StreamWriterBuilder::~StreamWriterBuilder() = default;
@@ -1243,17 +1632,20 @@ void StreamWriterBuilder::setDefaults(Json::Value* settings) {
 }
 
 String writeString(StreamWriter::Factory const& factory, Value const& root) {
-  OStringStream sout;
+  String document;
+  StringSink sink(document);
   StreamWriterPtr const writer(factory.newStreamWriter());
-  writer->write(root, &sout);
-  return sout.str();
+  writer->write(root, &sink);
+  return document;
 }
 
+#if !JSONCPP_NO_IOSTREAM
 OStream& operator<<(OStream& sout, Value const& root) {
   StreamWriterBuilder builder;
   StreamWriterPtr const writer(builder.newStreamWriter());
   writer->write(root, &sout);
   return sout;
 }
+#endif
 
 } // namespace Json
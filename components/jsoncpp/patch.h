@@ -0,0 +1,43 @@
+// Copyright 2007-2010 Baptiste Lepilleur and The JsonCpp Authors
+// Distributed under MIT license, or public domain if desired and
+// recognized in your jurisdiction.
+// See file LICENSE for detail or copy at http://jsoncpp.sourceforge.net/LICENSE
+
+#ifndef JSON_PATCH_H_INCLUDED
+#define JSON_PATCH_H_INCLUDED
+
+#if !defined(JSON_IS_AMALGAMATION)
+#include "value.h"
+#endif // if !defined(JSON_IS_AMALGAMATION)
+
+#pragma pack(push)
+#pragma pack()
+
+namespace Json {
+
+/** \brief Compute the smallest RFC 7396 merge patch turning \a from into
+ * \a to.
+ *
+ * Members equal on both sides are left out, removed members become null and
+ * nested objects are diffed member by member. Anything that is not an object
+ * on both sides is replaced whole, so the patch is then \a to itself. Equal
+ * documents give an empty object.
+ *
+ * Merge patch cannot express a null member value: a member of \a to that is
+ * null reads as "remove" when the patch is applied.
+ */
+Value JSON_API mergePatch(const Value& from, const Value& to);
+
+/** \brief Apply an RFC 7396 merge patch to \a target in place.
+ *
+ * An object patch merges member by member (null removes the member, and a
+ * target that is not an object is first replaced by an empty one); any other
+ * patch replaces \a target.
+ */
+void JSON_API applyMergePatch(Value& target, const Value& patch);
+
+} // namespace Json
+
+#pragma pack(pop)
+
+#endif // JSON_PATCH_H_INCLUDED
@@ -11,10 +11,13 @@
 #include "value.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
 #include <deque>
+#if !JSONCPP_NO_IOSTREAM
 #include <iosfwd>
 #include <istream>
-#include <stack>
+#endif
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 // Disable warning C4251: <data member>: <type> needs to have dll-interface to
 // be used by...
@@ -28,6 +31,29 @@
 
 namespace Json {
 
+/** \brief Shared storage for object member names, see Reader::setKeyPool().
+ *
+ * Each distinct name is stored once. Values built with a pool keep raw
+ * pointers into it (StaticString keys), so the pool must outlive them and
+ * every copy made of them.
+ */
+class JSON_API KeyPool {
+public:
+  /// Stable, NUL terminated storage equal to \a key.
+  const char* intern(const String& key);
+  /// Number of distinct names stored.
+  size_t size() const { return keys_.size(); }
+
+private:
+  struct Hash {
+    size_t operator()(const String& key) const;
+  };
+  // Node based: elements never move, so their data() stays valid.
+  std::unordered_set<String, Hash, std::equal_to<String>,
+                     HookAllocator<String>>
+      keys_;
+};
+
 /** \brief Unserialize a <a HREF="http://www.json.org">JSON</a> document into a
  * Value.
  *
@@ -60,6 +86,14 @@ public:
    */
   Reader(const Features& features);
 
+  /** \brief Store object member names in \a pool instead of giving each
+   * member its own copy. Pays off for documents that repeat the same names,
+   * e.g. arrays of records. Names containing NUL are still copied.
+   * \param pool must outlive every Value parsed with it; NULL turns interning
+   *        off again.
+   */
+  void setKeyPool(KeyPool* pool) { keyPool_ = pool; }
+
   /** \brief Read a Value from a <a HREF="http://www.json.org">JSON</a>
    * document.
    *
@@ -96,9 +130,11 @@ public:
   bool parse(const char* beginDoc, const char* endDoc, Value& root,
              bool collectComments = true);
 
+#if !JSONCPP_NO_IOSTREAM
   /// \brief Parse from input stream.
   /// \see Json::operator>>(std::istream&, Json::Value&).
   bool parse(IStream& is, Value& root, bool collectComments = true);
+#endif
 
   /** \brief Returns a user friendly string that list errors in the parsed
    * document.
@@ -187,7 +223,7 @@ private:
     Location extra_;
   };
 
-  using Errors = std::deque<ErrorInfo>;
+  using Errors = std::deque<ErrorInfo, HookAllocator<ErrorInfo>>;
 
   bool readToken(Token& token);
   void skipSpaces();
@@ -198,8 +234,17 @@ private:
   bool readString();
   void readNumber();
   bool readValue();
-  bool readObject(Token& token);
-  bool readArray(Token& token);
+  // Steps of readValue(). Each returns true after pushing the member to read
+  // next onto nodes_; otherwise the value is complete and \a successful
+  // holds its result.
+  bool beginValue(bool& successful);
+  bool beginObject(Token& token, bool& successful);
+  bool nextObjectMember(bool& successful);
+  bool endObjectMember(bool& successful);
+  bool beginArray(Token& token);
+  bool endArrayElement(bool& successful);
+  void pushArrayElement();
+  void endContainer();
   bool decodeNumber(Token& token);
   bool decodeNumber(Token& token, Value& decoded);
   bool decodeString(Token& token);
@@ -226,8 +271,16 @@ private:
   static bool containsNewLine(Location begin, Location end);
   static String normalizeEOL(Location begin, Location end);
 
-  using Nodes = std::stack<Value*>;
+  // One per nesting level: the value being read and, for a container, where
+  // it is up to. readValue() keeps these instead of recursing.
+  struct Frame {
+    Value* value;
+    ArrayIndex index; // next element of an array
+    bool nameEmpty;   // last member name of an object was ""
+  };
+  using Nodes = std::vector<Frame, HookAllocator<Frame>>;
   Nodes nodes_;
+  String name_; // member name being decoded
   Errors errors_;
   String document_;
   Location begin_{};
@@ -237,6 +290,7 @@ private:
   Value* lastValue_{};
   String commentsBefore_;
   Features features_;
+  KeyPool* keyPool_{};
   bool collectComments_{};
 }; // Reader
 
@@ -311,8 +365,8 @@ public:
    * - `"allowSingleQuotes": false or true`
    *   - true if '' are allowed for strings (both keys and values)
    * - `"stackLimit": integer`
-   *   - Exceeding stackLimit (recursive depth of `readValue()`) will cause an
-   *     exception.
+   *   - Exceeding stackLimit (nesting depth of arrays and objects) will cause
+   *     an exception, or a parse error when exceptions are disabled.
    *   - This is a security issue (seg-faults caused by deeply nested JSON), so
    *     the default is low.
    * - `"failIfExtra": false or true`
@@ -362,6 +416,7 @@ public:
   static void strictMode(Json::Value* settings);
 };
 
+#if !JSONCPP_NO_IOSTREAM
 /** Consume entire stream and use its begin/end.
  * Someday we might have a real StreamReader, but for now this
  * is convenient.
@@ -394,6 +449,7 @@ bool JSON_API parseFromStream(CharReader::Factory const&, IStream&, Value* root,
  * \see Json::operator<<()
  */
 JSON_API IStream& operator>>(IStream&, Value&);
+#endif // if !JSONCPP_NO_IOSTREAM
 
 } // namespace Json
 
@@ -293,7 +293,9 @@ private:
   };
 
 public:
-  typedef std::map<CZString, Value> ObjectValues;
+  typedef std::map<CZString, Value, std::less<CZString>,
+                   HookAllocator<std::pair<const CZString, Value>>>
+      ObjectValues;
 #endif // ifndef JSONCPP_DOC_EXCLUDE_IMPLEMENTATION
 
 public:
@@ -562,6 +564,15 @@ public:
   /// \post if type() was nullValue, it remains nullValue
   Members getMemberNames() const;
 
+#if JSONCPP_LEAN_VALUE
+  // Lean profile: comments are discarded and never reported.
+  JSONCPP_DEPRECATED("Use setComment(String const&) instead.")
+  void setComment(const char*, CommentPlacement) {}
+  void setComment(const char*, size_t, CommentPlacement) {}
+  void setComment(String, CommentPlacement) {}
+  bool hasComment(CommentPlacement) const { return false; }
+  String getComment(CommentPlacement) const { return String(); }
+#else
   /// \deprecated Always pass len.
   JSONCPP_DEPRECATED("Use setComment(String const&) instead.")
   void setComment(const char* comment, CommentPlacement placement) {
@@ -576,6 +587,7 @@ public:
   bool hasComment(CommentPlacement placement) const;
   /// Include delimiters and embedded newlines.
   String getComment(CommentPlacement placement) const;
+#endif
 
   String toStyledString() const;
 
@@ -587,10 +599,18 @@ public:
 
   // Accessors for the [start, limit) range of bytes within the JSON text from
   // which this value was parsed, if any.
+#if JSONCPP_LEAN_VALUE
+  // Lean profile: offsets are not tracked and always read as 0.
+  void setOffsetStart(ptrdiff_t) {}
+  void setOffsetLimit(ptrdiff_t) {}
+  ptrdiff_t getOffsetStart() const { return 0; }
+  ptrdiff_t getOffsetLimit() const { return 0; }
+#else
   void setOffsetStart(ptrdiff_t start);
   void setOffsetLimit(ptrdiff_t limit);
   ptrdiff_t getOffsetStart() const;
   ptrdiff_t getOffsetLimit() const;
+#endif
 
 private:
   void setType(ValueType v) {
@@ -632,6 +652,7 @@ private:
     unsigned int allocated_ : 1;
   } bits_;
 
+#if !JSONCPP_LEAN_VALUE
   class Comments {
   public:
     Comments() = default;
@@ -653,6 +674,7 @@ private:
   // was extracted.
   ptrdiff_t start_;
   ptrdiff_t limit_;
+#endif // if !JSONCPP_LEAN_VALUE
 };
 
 template <> inline bool Value::as<bool>() const { return asBool(); }
@@ -9,7 +9,9 @@
 #if !defined(JSON_IS_AMALGAMATION)
 #include "value.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
+#if !JSONCPP_NO_IOSTREAM
 #include <ostream>
+#endif
 #include <string>
 #include <vector>
 
@@ -27,6 +29,78 @@ namespace Json {
 
 class Value;
 
+/** \brief Destination for serialized JSON.
+ *
+ * Lets the writers emit straight into a fixed buffer or a chunk callback
+ * instead of building a String or going through an OStream.
+ */
+class JSON_API WriterSink {
+public:
+  virtual ~WriterSink();
+  /** Append \a length bytes.
+   * \return false if the sink cannot take the data; the writer then stops.
+   */
+  virtual bool write(const char* data, size_t length) = 0;
+  /// Called once the document is complete.
+  virtual bool flush();
+};
+
+/** \brief WriterSink over a fixed caller-provided buffer. Never allocates.
+ *
+ * On overflow the buffer keeps the longest prefix that fits, further writes
+ * are refused and overflowed() becomes true. size() still counts every byte
+ * offered, so it tells how large the buffer needed to be. The content is
+ * NUL terminated whenever \a capacity is not zero.
+ */
+class JSON_API BufferSink : public WriterSink {
+public:
+  BufferSink(char* buffer, size_t capacity);
+  bool write(const char* data, size_t length) override;
+
+  const char* data() const { return buffer_; }
+  size_t size() const { return size_; }
+  bool overflowed() const { return overflowed_; }
+
+private:
+  char* buffer_;
+  size_t capacity_;
+  size_t size_{0};
+  bool overflowed_{false};
+};
+
+#if !defined(JSONCPP_CALLBACK_SINK_CHUNK_SIZE)
+#define JSONCPP_CALLBACK_SINK_CHUNK_SIZE 256
+#endif
+
+/** \brief WriterSink handing the document to a callback in chunks of up to
+ * JSONCPP_CALLBACK_SINK_CHUNK_SIZE bytes, e.g. for a chunked HTTP body.
+ * The callback returns false to abort the writer.
+ */
+class JSON_API CallbackSink : public WriterSink {
+public:
+  using Callback = bool (*)(const char* data, size_t length, void* context);
+
+  CallbackSink(Callback callback, void* context);
+  bool write(const char* data, size_t length) override;
+  bool flush() override;
+
+private:
+  Callback callback_;
+  void* context_;
+  size_t used_{0};
+  char chunk_[JSONCPP_CALLBACK_SINK_CHUNK_SIZE];
+};
+
+/// WriterSink that only counts bytes. Used by measure().
+class JSON_API CountingSink : public WriterSink {
+public:
+  bool write(const char* data, size_t length) override;
+  size_t size() const { return size_; }
+
+private:
+  size_t size_{0};
+};
+
 /**
  *
  * Usage:
@@ -40,11 +114,20 @@ class Value;
  *  \endcode
  */
 class JSON_API StreamWriter {
+#if !JSONCPP_NO_IOSTREAM
 protected:
   OStream* sout_; // not owned; will not delete
+#endif
 public:
   StreamWriter();
   virtual ~StreamWriter();
+#if JSONCPP_NO_IOSTREAM
+  /** Write Value into \a sink as configured in sub-class.
+   *   \pre sink != NULL
+   *   \return zero on success, non-zero if the sink refused data.
+   */
+  virtual int write(Value const& root, WriterSink* sink) = 0;
+#else
   /** Write Value into document as configured in sub-class.
    *   Do not take ownership of sout, but maintain a reference during function.
    *   \pre sout != NULL
@@ -54,6 +137,18 @@ public:
    */
   virtual int write(Value const& root, OStream* sout) = 0;
 
+  /** Write Value into \a sink as configured in sub-class.
+   *   The default implementation formats into a String first; the writers
+   *   made by StreamWriterBuilder emit directly into the sink.
+   *   \pre sink != NULL
+   *   \return zero on success, non-zero if the sink refused data.
+   */
+  virtual int write(Value const& root, WriterSink* sink);
+#endif
+
+  /// Number of bytes write() produces for \a root, e.g. to size a buffer.
+  size_t measure(Value const& root);
+
   /** \brief A simple abstract factory.
    */
   class JSON_API Factory {
@@ -66,7 +161,7 @@ public:
   }; // Factory
 };   // StreamWriter
 
-/** \brief Write into stringstream, then return string, for convenience.
+/** \brief Write into a String, then return it, for convenience.
  * A StreamWriter will be created from the factory, used, and then deleted.
  */
 String JSON_API writeString(StreamWriter::Factory const& factory,
@@ -188,8 +283,16 @@ public:
 public: // overridden from Writer
   String write(const Value& root) override;
 
+  /** Serialize \a root into \a sink without building a String.
+   * \return false if the sink refused data (e.g. BufferSink overflow).
+   */
+  bool write(const Value& root, WriterSink& sink);
+
+  /// Number of bytes write() produces for \a root, e.g. to size a buffer.
+  size_t measure(const Value& root);
+
 private:
-  void writeValue(const Value& value);
+  bool writeValue(const Value& value, WriterSink& sink);
 
   String document_;
   bool yamlCompatibilityEnabled_{false};
@@ -268,6 +371,7 @@ private:
 #pragma warning(pop)
 #endif
 
+#if !JSONCPP_NO_IOSTREAM
 /** \brief Writes a Value in <a HREF="http://www.json.org">JSON</a> format in a
  human friendly way,
      to a stream rather than to a string.
@@ -342,6 +446,7 @@ private:
 #if defined(_MSC_VER)
 #pragma warning(pop)
 #endif
+#endif // if !JSONCPP_NO_IOSTREAM
 
 #if defined(JSON_HAS_INT64)
 String JSON_API valueToString(Int value);
@@ -352,12 +457,25 @@ String JSON_API valueToString(LargestUInt value);
 String JSON_API valueToString(
     double value, unsigned int precision = Value::defaultRealPrecision,
     PrecisionType precisionType = PrecisionType::significantDigits);
+/** Format a double like valueToString() into a caller supplied buffer.
+ *
+ * Nothing is allocated for the default precision or for decimalPlaces up to
+ * 19. At most \a size bytes are written, including the terminating NUL.
+ * \return the length of the full representation, excluding the NUL, as
+ *         snprintf() does; the output was truncated if it is >= \a size.
+ */
+size_t JSON_API valueToChars(
+    double value, char* buffer, size_t size,
+    unsigned int precision = Value::defaultRealPrecision,
+    PrecisionType precisionType = PrecisionType::significantDigits);
 String JSON_API valueToString(bool value);
 String JSON_API valueToQuotedString(const char* value);
 
+#if !JSONCPP_NO_IOSTREAM
 /// \brief Output using the StyledStreamWriter.
 /// \see Json::operator>>()
 JSON_API OStream& operator<<(OStream&, const Value& root);
+#endif
 
 } // namespace Json
 
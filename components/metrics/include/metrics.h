@@ -0,0 +1,75 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Registro de métricas en formato Prometheus (GET /metrics en el servidor STA).
+//
+// Cada componente crea sus métricas una vez al iniciar y guarda el puntero;
+// actualizarlas es una operación atómica relajada, sin locks ni reservas, apta
+// para rutas calientes, eventos y callbacks de esp_timer. Varias métricas con el
+// mismo nombre y distintas etiquetas forman una familia.
+// Las funciones de actualización aceptan NULL (métrica no creada): no hacen nada.
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+} metric_type_t;
+
+typedef struct metric {
+    const char *name;
+    const char *help;
+    const char *labels;        // p. ej. "method=\"GET\"" o NULL
+    metric_type_t type;
+    uint32_t value;            // contador (sin signo) o gauge (int32_t)
+    uint32_t sum_ms;           // histograma: suma de observaciones
+    const uint32_t *bounds_us; // histograma: límites superiores, ascendentes
+    uint32_t *buckets;         // histograma: nbounds + 1 (el último es +Inf)
+    int nbounds;
+    struct metric *next;
+} metric_t;
+
+// Alta (idempotente por nombre + etiquetas); name y las cadenas deben ser
+// estáticas. Devuelven NULL sin memoria.
+metric_t *metrics_counter(const char *name, const char *help, const char *labels);
+metric_t *metrics_gauge(const char *name, const char *help, const char *labels);
+metric_t *metrics_histogram(const char *name, const char *help, const char *labels,
+                            const uint32_t *bounds_us, int nbounds);
+
+// Se llama al armar cada respuesta de /metrics, en la tarea de httpd: para
+// gauges que se leen al momento (colas, RSSI...). Hasta METRICS_MAX_COLLECTORS.
+#define METRICS_MAX_COLLECTORS 8
+esp_err_t metrics_add_collector(void (*collect)(void));
+
+// Mínimo de pila libre de la tarea (por nombre, se busca en cada consulta)
+// como task_stack_free_min_bytes{task="..."}; -1 si la tarea no existe
+esp_err_t metrics_watch_task(const char *task_name);
+
+// Heap y pila de httpd; antes de registrar el resto
+esp_err_t metrics_init(void);
+
+// Handler de GET /metrics (text/plain; version=0.0.4)
+esp_err_t metrics_http_get(httpd_req_t *r);
+
+static inline void metrics_add(metric_t *m, uint32_t n) {
+    if (m) __atomic_fetch_add(&m->value, n, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_inc(metric_t *m) {
+    metrics_add(m, 1);
+}
+
+static inline void metrics_set(metric_t *m, int32_t v) {
+    if (m) __atomic_store_n(&m->value, (uint32_t)v, __ATOMIC_RELAXED);
+}
+
+void metrics_observe_us(metric_t *m, uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,255 @@
+#include "metrics.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "metrics";
+
+// Listas de solo alta: se inserta al frente con CAS y nunca se quita, así
+// /metrics las recorre sin lock mientras otro componente registra
+static metric_t *s_head = NULL;
+
+typedef struct watched_task {
+    const char *name;
+    metric_t *m;
+    struct watched_task *next;
+} watched_task_t;
+static watched_task_t *s_tasks = NULL;
+
+static void (*s_collectors[METRICS_MAX_COLLECTORS])(void);
+static uint32_t s_ncollectors = 0;
+
+static metric_t *s_heap_free, *s_heap_min_free, *s_heap_largest;
+
+#define LIST_PUSH(head, node)                                                             \
+    do {                                                                                  \
+        __typeof__(node) _old = __atomic_load_n(&(head), __ATOMIC_RELAXED);              \
+        do {                                                                              \
+            (node)->next = _old;                                                          \
+        } while (!__atomic_compare_exchange_n(&(head), &_old, (node), true,              \
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));       \
+    } while (0)
+
+static bool same_labels(const char *a, const char *b) {
+    return strcmp(a ? a : "", b ? b : "") == 0;
+}
+
+static metric_t *create(const char *name, const char *help, const char *labels,
+                        metric_type_t type, const uint32_t *bounds_us, int nbounds) {
+    if (!name) return NULL;
+    for (metric_t *m = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE); m; m = m->next) {
+        if (strcmp(m->name, name) == 0 && same_labels(m->labels, labels)) return m;
+    }
+    // Los buckets van en la misma reserva, detrás de la métrica
+    size_t extra = type == METRIC_HISTOGRAM ? (nbounds + 1) * sizeof(uint32_t) : 0;
+    metric_t *m = calloc(1, sizeof(metric_t) + extra);
+    if (!m) {
+        ESP_LOGE(TAG, "OOM registrando %s", name);
+        return NULL;
+    }
+    m->name = name;
+    m->help = help;
+    m->labels = labels;
+    m->type = type;
+    if (type == METRIC_HISTOGRAM) {
+        m->bounds_us = bounds_us;
+        m->nbounds = nbounds;
+        m->buckets = (uint32_t *)(m + 1);
+    }
+    LIST_PUSH(s_head, m);
+    return m;
+}
+
+metric_t *metrics_counter(const char *name, const char *help, const char *labels) {
+    return create(name, help, labels, METRIC_COUNTER, NULL, 0);
+}
+
+metric_t *metrics_gauge(const char *name, const char *help, const char *labels) {
+    return create(name, help, labels, METRIC_GAUGE, NULL, 0);
+}
+
+metric_t *metrics_histogram(const char *name, const char *help, const char *labels,
+                            const uint32_t *bounds_us, int nbounds) {
+    if (!bounds_us || nbounds <= 0) return NULL;
+    return create(name, help, labels, METRIC_HISTOGRAM, bounds_us, nbounds);
+}
+
+void metrics_observe_us(metric_t *m, uint32_t us) {
+    if (!m || m->type != METRIC_HISTOGRAM) return;
+    int b = 0;
+    while (b < m->nbounds && us > m->bounds_us[b]) b++;
+    __atomic_fetch_add(&m->buckets[b], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->sum_ms, (us + 500) / 1000, __ATOMIC_RELAXED);
+}
+
+esp_err_t metrics_add_collector(void (*collect)(void)) {
+    if (!collect) return ESP_ERR_INVALID_ARG;
+    uint32_t i = __atomic_fetch_add(&s_ncollectors, 1, __ATOMIC_RELAXED);
+    if (i >= METRICS_MAX_COLLECTORS) return ESP_ERR_NO_MEM;
+    __atomic_store_n(&s_collectors[i], collect, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+esp_err_t metrics_watch_task(const char *task_name) {
+    if (!task_name) return ESP_ERR_INVALID_ARG;
+    // La etiqueta vive con la métrica: se arma una vez y no se libera
+    size_t len = strlen(task_name) + sizeof("task=\"\"");
+    watched_task_t *t = calloc(1, sizeof(watched_task_t) + len);
+    if (!t) return ESP_ERR_NO_MEM;
+    char *labels = (char *)(t + 1);
+    snprintf(labels, len, "task=\"%s\"", task_name);
+    t->name = task_name;
+    t->m = metrics_gauge("task_stack_free_min_bytes",
+                         "Mínimo de pila libre desde que arrancó la tarea", labels);
+    if (!t->m) {
+        free(t);
+        return ESP_ERR_NO_MEM;
+    }
+    metrics_set(t->m, -1);
+    LIST_PUSH(s_tasks, t);
+    return ESP_OK;
+}
+
+// Lo que se lee al momento de cada consulta
+static void collect_builtin(void) {
+    metrics_set(s_heap_free, (int32_t)heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+    metrics_set(s_heap_min_free, (int32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+    metrics_set(s_heap_largest, (int32_t)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+    // Por nombre y no por handle: una tarea que terminó no deja un puntero colgado
+    for (watched_task_t *t = __atomic_load_n(&s_tasks, __ATOMIC_ACQUIRE); t; t = t->next) {
+        TaskHandle_t h = xTaskGetHandle(t->name);
+        metrics_set(t->m, h ? (int32_t)uxTaskGetStackHighWaterMark(h) : -1);
+    }
+}
+
+esp_err_t metrics_init(void) {
+    if (s_heap_free) return ESP_OK;
+    s_heap_free = metrics_gauge("heap_free_bytes", "Heap libre", NULL);
+    s_heap_min_free = metrics_gauge("heap_min_free_bytes", "Mínimo de heap libre desde el arranque", NULL);
+    s_heap_largest = metrics_gauge("heap_largest_free_block_bytes",
+                                   "Mayor bloque libre (fragmentación)", NULL);
+    if (!s_heap_free || !s_heap_min_free || !s_heap_largest) return ESP_ERR_NO_MEM;
+    esp_err_t err = metrics_add_collector(collect_builtin);
+    if (err == ESP_OK) err = metrics_watch_task("httpd");
+    return err;
+}
+
+// ---- Exposición ----
+
+// Salida en chunks: las líneas se juntan en buf y se envían al llenarse
+typedef struct {
+    httpd_req_t *r;
+    esp_err_t err;
+    int used;
+    char buf[512];
+} out_t;
+
+static void out_flush(out_t *o) {
+    if (o->err == ESP_OK && o->used) o->err = httpd_resp_send_chunk(o->r, o->buf, o->used);
+    o->used = 0;
+}
+
+static void out_printf(out_t *o, const char *fmt, ...) {
+    for (int pass = 0; pass < 2 && o->err == ESP_OK; pass++) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(o->buf + o->used, sizeof(o->buf) - o->used, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && n < (int)sizeof(o->buf) - o->used) {
+            o->used += n;
+            return;
+        }
+        out_flush(o); // no entró: se envía lo anterior y se reintenta con el buffer vacío
+    }
+}
+
+// Segundos desde un entero con la escala dada (1000 = ms, 1000000 = us), sin float
+static const char *fmt_seconds(char *s, size_t len, uint32_t v, uint32_t scale) {
+    int digits = scale == 1000 ? 3 : 6;
+    int n = snprintf(s, len, "%lu.%0*lu", (unsigned long)(v / scale), digits, (unsigned long)(v % scale));
+    while (n > 0 && s[n - 1] == '0') s[--n] = 0;
+    if (n > 0 && s[n - 1] == '.') s[--n] = 0;
+    return s;
+}
+
+static void render_metric(out_t *o, const metric_t *m) {
+    const char *lb = m->labels ? m->labels : "";
+    const char *open = m->labels ? "{" : "";
+    const char *close = m->labels ? "}" : "";
+    uint32_t v = __atomic_load_n(&m->value, __ATOMIC_RELAXED);
+    char num[24];
+    switch (m->type) {
+        case METRIC_COUNTER:
+            out_printf(o, "%s%s%s%s %lu\n", m->name, open, lb, close, (unsigned long)v);
+            break;
+        case METRIC_GAUGE:
+            out_printf(o, "%s%s%s%s %ld\n", m->name, open, lb, close, (long)(int32_t)v);
+            break;
+        case METRIC_HISTOGRAM: {
+            // La cuenta sale de los mismos buckets: +Inf y _count siempre coinciden
+            uint32_t cum = 0;
+            const char *sep = m->labels ? "," : "";
+            for (int b = 0; b <= m->nbounds; b++) {
+                cum += __atomic_load_n(&m->buckets[b], __ATOMIC_RELAXED);
+                const char *le = b < m->nbounds ? fmt_seconds(num, sizeof(num), m->bounds_us[b], 1000000) : "+Inf";
+                out_printf(o, "%s_bucket{%s%sle=\"%s\"} %lu\n", m->name, lb, sep, le, (unsigned long)cum);
+            }
+            uint32_t sum = __atomic_load_n(&m->sum_ms, __ATOMIC_RELAXED);
+            out_printf(o, "%s_sum%s%s%s %s\n", m->name, open, lb, close, fmt_seconds(num, sizeof(num), sum, 1000));
+            out_printf(o, "%s_count%s%s%s %lu\n", m->name, open, lb, close, (unsigned long)cum);
+            break;
+        }
+    }
+}
+
+static const char *type_str(metric_type_t t) {
+    switch (t) {
+        case METRIC_COUNTER: return "counter";
+        case METRIC_GAUGE: return "gauge";
+        default: return "histogram";
+    }
+}
+
+esp_err_t metrics_http_get(httpd_req_t *r) {
+    uint32_t n = __atomic_load_n(&s_ncollectors, __ATOMIC_RELAXED);
+    for (uint32_t i = 0; i < n && i < METRICS_MAX_COLLECTORS; i++) {
+        void (*collect)(void) = __atomic_load_n(&s_collectors[i], __ATOMIC_ACQUIRE);
+        if (collect) collect();
+    }
+
+    httpd_resp_set_type(r, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(r, "Cache-Control", "no-cache");
+    out_t *o = malloc(sizeof(out_t)); // fuera de la pila de httpd
+    if (!o) return httpd_resp_send_err(r, HTTPD_500_INTERNAL_SERVER_ERROR, "sin memoria");
+    o->r = r;
+    o->err = ESP_OK;
+    o->used = 0;
+
+    // Una familia por nombre: HELP/TYPE una vez y luego todas sus etiquetas
+    metric_t *head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    for (metric_t *m = head; m && o->err == ESP_OK; m = m->next) {
+        bool first = true;
+        for (metric_t *p = head; p != m; p = p->next) {
+            if (strcmp(p->name, m->name) == 0) {
+                first = false;
+                break;
+            }
+        }
+        if (!first) continue;
+        out_printf(o, "# HELP %s %s\n# TYPE %s %s\n", m->name, m->help ? m->help : "", m->name, type_str(m->type));
+        for (metric_t *f = m; f; f = f->next) {
+            if (strcmp(f->name, m->name) == 0) render_metric(o, f);
+        }
+    }
+    out_flush(o);
+    esp_err_t err = o->err;
+    free(o);
+    if (err != ESP_OK) return ESP_FAIL; // cliente se fue
+    return httpd_resp_send_chunk(r, NULL, 0);
+}
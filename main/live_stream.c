@@ -0,0 +1,238 @@
+#include "live_stream.h"
+#include "local_api.h"
+#include "captive_manager.h"
+#include "metrics.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "live_stream";
+
+#define STREAM_CLIENTS   CONFIG_LIVE_STREAM_MAX_CLIENTS
+#define STREAM_QUEUE_LEN CONFIG_LIVE_STREAM_QUEUE_LEN
+#define STREAM_MSG_MAX   (LOCAL_API_SAMPLE_JSON_MAX + 48) // "id: N\nevent: sample\ndata: {...}\n\n"
+
+// Eventos ya armados; la cola de cada cliente es su cursor sobre este anillo,
+// así publicar cuesta lo mismo con uno o con varios clientes
+typedef struct {
+    uint16_t len;
+    char text[STREAM_MSG_MAX];
+} stream_msg_t;
+
+// Solo la tarea de httpd abre, envía y cierra; s_lock cubre cursor frente a publish
+typedef struct {
+    int fd;           // -1 = libre
+    uint32_t cursor;  // próximo evento a enviar
+    uint16_t off;     // bytes ya enviados de ese evento (envío parcial)
+    bool closing;     // cortado, falta que httpd cierre la sesión
+} stream_client_t;
+
+static stream_msg_t *s_ring = NULL;
+static uint32_t s_next_id = 0; // id del próximo evento; en el anillo están los últimos QUEUE_LEN
+static stream_client_t s_clients[STREAM_CLIENTS];
+static live_stream_stats_t s_stats;
+static httpd_handle_t s_hd = NULL;
+static esp_timer_handle_t s_ping_timer = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static metric_t *s_m_clients, *s_m_backlog, *s_m_dropped;
+
+static void drop_client(stream_client_t *c, const char *why) {
+    if (c->closing) return;
+    c->closing = true;
+    s_stats.dropped_slow++;
+    ESP_LOGW(TAG, "Cliente fd=%d desconectado (%s)", c->fd, why);
+    httpd_sess_trigger_close(s_hd, c->fd);
+}
+
+// Envía lo pendiente sin bloquear (con s_lock tomado). Si el socket no acepta
+// más, sigue en la próxima muestra o el próximo ping; si el cliente quedó más
+// atrás que el anillo, se corta y EventSource reconecta solo.
+static void flush_client(stream_client_t *c) {
+    while (!c->closing && c->cursor < s_next_id) {
+        if (s_next_id - c->cursor > STREAM_QUEUE_LEN) {
+            drop_client(c, "atrasado");
+            return;
+        }
+        const stream_msg_t *m = &s_ring[c->cursor % STREAM_QUEUE_LEN];
+        int ret = httpd_socket_send(s_hd, c->fd, m->text + c->off, m->len - c->off, MSG_DONTWAIT);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT || ret == 0) return; // buffer de envío lleno
+        if (ret < 0) {
+            drop_client(c, "error de envío");
+            return;
+        }
+        c->off += ret;
+        if (c->off < m->len) return;
+        c->off = 0;
+        c->cursor++;
+    }
+}
+
+static void flush_work(void *arg) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < STREAM_CLIENTS; i++) {
+        if (s_clients[i].fd >= 0) flush_client(&s_clients[i]);
+    }
+    xSemaphoreGive(s_lock);
+}
+
+// Entre muestras: comentario SSE para que proxies y NAT no cierren la conexión
+// y para notar clientes que ya no leen
+static void ping_work(void *arg) {
+    static const char ping[] = ": ping\n\n";
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < STREAM_CLIENTS; i++) {
+        stream_client_t *c = &s_clients[i];
+        if (c->fd < 0 || c->closing) continue;
+        if (c->cursor < s_next_id) {
+            flush_client(c);
+            continue;
+        }
+        // Un ping a medias dejaría el stream corrupto: cortado también cuenta como lento
+        int ret = httpd_socket_send(s_hd, c->fd, ping, sizeof(ping) - 1, MSG_DONTWAIT);
+        if (ret != (int)sizeof(ping) - 1) drop_client(c, "no lee");
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void ping_timer_cb(void *arg) {
+    if (s_stats.clients && s_hd) httpd_queue_work(s_hd, ping_work, NULL);
+}
+
+// free_ctx de la sesión: httpd la llama al cerrar el socket, sea quien sea que lo cierre
+static void on_client_closed(void *ctx) {
+    stream_client_t *c = (stream_client_t *)ctx;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    ESP_LOGI(TAG, "Cliente fd=%d cerrado", c->fd);
+    c->fd = -1;
+    c->closing = false;
+    s_stats.clients--;
+    xSemaphoreGive(s_lock);
+}
+
+static esp_err_t stream_get(httpd_req_t *r) {
+    stream_client_t *c = NULL;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < STREAM_CLIENTS && !c; i++) {
+        if (s_clients[i].fd < 0) c = &s_clients[i];
+    }
+    if (!c) s_stats.rejected++;
+    xSemaphoreGive(s_lock);
+    if (!c) {
+        httpd_resp_set_status(r, "503 Service Unavailable");
+        httpd_resp_set_hdr(r, "Retry-After", "10");
+        return httpd_resp_sendstr(r, "máx. clientes de stream");
+    }
+
+    // Cabecera a mano: sin Content-Length ni chunked, el cuerpo dura lo que la conexión
+    static const char hdr[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "\r\n"
+        "retry: 3000\n\n";
+    if (httpd_send(r, hdr, sizeof(hdr) - 1) != (int)sizeof(hdr) - 1) return ESP_FAIL;
+
+    bool resume = false;
+    unsigned long last_id = 0;
+    char last[16];
+    if (httpd_req_get_hdr_value_str(r, "Last-Event-ID", last, sizeof(last)) == ESP_OK) {
+        char *end;
+        last_id = strtoul(last, &end, 10);
+        resume = end != last && !*end;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_hd = r->handle;
+    c->fd = httpd_req_to_sockfd(r);
+    c->off = 0;
+    c->closing = false;
+    // Al reconectar sigue desde lo que recibió si aún está en el anillo; si no
+    // (o tras un reinicio, que vuelve los id a 0) arranca con la última muestra
+    uint32_t oldest = s_next_id > STREAM_QUEUE_LEN ? s_next_id - STREAM_QUEUE_LEN : 0;
+    if (resume && last_id + 1 >= oldest && last_id < s_next_id) c->cursor = last_id + 1;
+    else c->cursor = s_next_id ? s_next_id - 1 : 0;
+    s_stats.clients++;
+    flush_client(c);
+    xSemaphoreGive(s_lock);
+
+    r->sess_ctx = c;
+    r->free_ctx = on_client_closed;
+    ESP_LOGI(TAG, "Cliente fd=%d conectado (desde id %lu)", c->fd, (unsigned long)c->cursor);
+    return ESP_OK;
+}
+
+static const httpd_uri_t uri_stream = { .uri="/api/stream", .method=HTTP_GET, .handler=stream_get };
+
+void live_stream_publish(const SensorData *d, time_t t) {
+    if (!s_ring || !d) return;
+    char json[LOCAL_API_SAMPLE_JSON_MAX];
+    int jl = local_api_format_sample(d, t, json, sizeof(json));
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    stream_msg_t *m = &s_ring[s_next_id % STREAM_QUEUE_LEN];
+    m->len = snprintf(m->text, sizeof(m->text), "id: %lu\nevent: sample\ndata: %.*s\n\n",
+                      (unsigned long)s_next_id, jl, json);
+    s_next_id++;
+    s_stats.published++;
+    httpd_handle_t hd = s_stats.clients ? s_hd : NULL;
+    xSemaphoreGive(s_lock);
+
+    // Los sockets son de la tarea de httpd: ahí se envía, no en la de sensores
+    if (hd && httpd_queue_work(hd, flush_work, NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo encolar el envío");
+    }
+}
+
+// /metrics, en la tarea de httpd: la cola de cada cliente es lo que le falta enviar
+static void collect_metrics(void) {
+    uint32_t backlog = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < STREAM_CLIENTS; i++) {
+        const stream_client_t *c = &s_clients[i];
+        if (c->fd >= 0 && !c->closing && s_next_id - c->cursor > backlog) backlog = s_next_id - c->cursor;
+    }
+    metrics_set(s_m_clients, s_stats.clients);
+    metrics_set(s_m_dropped, s_stats.dropped_slow);
+    xSemaphoreGive(s_lock);
+    metrics_set(s_m_backlog, backlog);
+}
+
+void live_stream_get_stats(live_stream_stats_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!s_lock) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t live_stream_init(void) {
+    if (s_ring) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    s_ring = calloc(STREAM_QUEUE_LEN, sizeof(stream_msg_t));
+    if (!s_lock || !s_ring) return ESP_ERR_NO_MEM;
+    for (int i = 0; i < STREAM_CLIENTS; i++) s_clients[i].fd = -1;
+    s_m_clients = metrics_gauge("live_stream_clients", "Clientes conectados a /api/stream", NULL);
+    s_m_backlog = metrics_gauge("live_stream_backlog_max", "Eventos pendientes del cliente más atrasado", NULL);
+    s_m_dropped = metrics_counter("live_stream_dropped_total", "Clientes de /api/stream cortados por lentos", NULL);
+    metrics_add_collector(collect_metrics);
+
+    const esp_timer_create_args_t ta = { .callback = ping_timer_cb, .name = "live_ping" };
+    esp_err_t err = esp_timer_create(&ta, &s_ping_timer);
+    if (err == ESP_OK) err = esp_timer_start_periodic(s_ping_timer, (uint64_t)CONFIG_LIVE_STREAM_PING_MS * 1000);
+    if (err == ESP_OK) err = captive_manager_add_sta_handler(&uri_stream);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Stream local: /api/stream (%d clientes, %d eventos en cola)",
+                 STREAM_CLIENTS, STREAM_QUEUE_LEN);
+    }
+    return err;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "esp_err.h"
+#include "sensors.h"
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Muestras en vivo por Server-Sent Events en el servidor STA:
+//   GET /api/stream   text/event-stream, un evento "sample" por lectura
+// Cada evento lleva id (número de muestra); al reconectar con Last-Event-ID se
+// reenvía lo que siga en la cola. Los clientes que se atrasan más que
+// CONFIG_LIVE_STREAM_QUEUE_LEN eventos se desconectan.
+
+typedef struct {
+    uint32_t clients;       // conectados ahora
+    uint32_t published;     // muestras publicadas
+    uint32_t dropped_slow;  // clientes cortados por atrasarse o fallar el envío
+    uint32_t rejected;      // 503 por cupo lleno
+} live_stream_stats_t;
+
+// Registra /api/stream; antes de captive_manager_start()
+esp_err_t live_stream_init(void);
+
+// Desde la tarea de sensores: formatea y encola el envío (no bloquea en la red)
+void live_stream_publish(const SensorData *d, time_t t);
+
+void live_stream_get_stats(live_stream_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
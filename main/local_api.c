@@ -0,0 +1,206 @@
+#include "local_api.h"
+#include "captive_manager.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "local_api";
+
+// Lo que se sirve de cada lectura (mismas claves que en Firebase)
+typedef struct {
+    uint32_t t;
+    float pm1p0, pm2p5, pm4p0, pm10p0, voc, nox, temp, hum;
+    uint16_t co2;
+} local_sample_t;
+
+static local_sample_t *s_ring = NULL;
+static uint32_t s_next_seq = 0; // número de la próxima muestra; en el anillo están las últimas LEN
+static SemaphoreHandle_t s_lock = NULL;
+
+static local_sample_t to_sample(const SensorData *d, time_t t) {
+    local_sample_t smp = {
+        .t = (uint32_t)t,
+        .pm1p0 = d->pm1p0, .pm2p5 = d->pm2p5, .pm4p0 = d->pm4p0, .pm10p0 = d->pm10p0,
+        .voc = d->voc, .nox = d->nox, .temp = d->avg_temp, .hum = d->avg_hum,
+        .co2 = d->co2,
+    };
+    return smp;
+}
+
+void local_api_add_sample(const SensorData *d, time_t t) {
+    if (!s_ring || !d) return;
+    local_sample_t smp = to_sample(d, t);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_ring[s_next_seq % LOCAL_API_HISTORY_LEN] = smp;
+    s_next_seq++;
+    xSemaphoreGive(s_lock);
+}
+
+static uint32_t oldest_seq(uint32_t next) {
+    return next > LOCAL_API_HISTORY_LEN ? next - LOCAL_API_HISTORY_LEN : 0;
+}
+
+// Copia hasta max muestras a partir de *seq (si ya se pisaron, avanza *seq a la
+// más vieja que queda). El lock solo se toma para copiar, nunca mientras se envía.
+static int ring_copy(uint32_t *seq, uint32_t end, local_sample_t *out, int max) {
+    int n = 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t oldest = oldest_seq(s_next_seq);
+    if (*seq < oldest) *seq = oldest;
+    for (uint32_t q = *seq; q < end && q < s_next_seq && n < max; q++) {
+        out[n++] = s_ring[q % LOCAL_API_HISTORY_LEN];
+    }
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+// Fuera de rango (lectura corrupta) se escribe null: así cada campo tiene largo acotado
+static int put_float(char *buf, size_t len, const char *key, float v, int decimals) {
+    if (!isfinite(v) || fabsf(v) > 1e6f) return snprintf(buf, len, ",\"%s\":null", key);
+    return snprintf(buf, len, ",\"%s\":%.*f", key, decimals, (double)v);
+}
+
+static int format_sample(char *buf, size_t len, const local_sample_t *s) {
+    if (len < LOCAL_API_SAMPLE_JSON_MAX) return 0;
+    int o = snprintf(buf, len, "{\"t\":%lu", (unsigned long)s->t);
+    o += put_float(buf + o, len - o, "pm1p0", s->pm1p0, 2);
+    o += put_float(buf + o, len - o, "pm2p5", s->pm2p5, 2);
+    o += put_float(buf + o, len - o, "pm4p0", s->pm4p0, 2);
+    o += put_float(buf + o, len - o, "pm10p0", s->pm10p0, 2);
+    o += put_float(buf + o, len - o, "voc", s->voc, 1);
+    o += put_float(buf + o, len - o, "nox", s->nox, 1);
+    o += put_float(buf + o, len - o, "cTe", s->temp, 2);
+    o += put_float(buf + o, len - o, "cHu", s->hum, 2);
+    o += snprintf(buf + o, len - o, ",\"co2\":%u}", (unsigned)s->co2);
+    return o;
+}
+
+int local_api_format_sample(const SensorData *d, time_t t, char *buf, size_t len) {
+    local_sample_t smp = to_sample(d, t);
+    return format_sample(buf, len, &smp);
+}
+
+// Pone ETag y, si el cliente ya tiene esa versión, contesta 304 y devuelve true.
+// etag debe seguir vivo hasta enviar la respuesta (httpd guarda el puntero).
+static bool not_modified(httpd_req_t *r, const char *etag) {
+    httpd_resp_set_hdr(r, "ETag", etag);
+    httpd_resp_set_hdr(r, "Cache-Control", "no-cache");
+    char inm[32];
+    if (httpd_req_get_hdr_value_str(r, "If-None-Match", inm, sizeof(inm)) != ESP_OK ||
+        strcmp(inm, etag) != 0) {
+        return false;
+    }
+    httpd_resp_set_status(r, "304 Not Modified");
+    httpd_resp_send(r, NULL, 0);
+    return true;
+}
+
+static esp_err_t latest_get(httpd_req_t *r) {
+    local_sample_t s;
+    uint32_t next;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    next = s_next_seq;
+    if (next) s = s_ring[(next - 1) % LOCAL_API_HISTORY_LEN];
+    xSemaphoreGive(s_lock);
+    if (!next) return httpd_resp_send_err(r, HTTPD_404_NOT_FOUND, "sin muestras");
+
+    // La muestra se identifica por su número: cambia con cada lectura
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"%lu\"", (unsigned long)(next - 1));
+    if (not_modified(r, etag)) return ESP_OK;
+    char buf[LOCAL_API_SAMPLE_JSON_MAX];
+    int len = format_sample(buf, sizeof(buf), &s);
+    httpd_resp_set_type(r, "application/json");
+    return httpd_resp_send(r, buf, len);
+}
+
+static bool query_epoch(const char *query, const char *key, int64_t *out) {
+    char val[16];
+    esp_err_t err = httpd_query_key_value(query, key, val, sizeof(val));
+    if (err == ESP_ERR_NOT_FOUND) return true; // opcional
+    if (err != ESP_OK) return false;           // truncado: no es un epoch válido
+    char *end;
+    long long v = strtoll(val, &end, 10);
+    if (end == val || *end) return false;
+    *out = v;
+    return true;
+}
+
+static esp_err_t history_get(httpd_req_t *r) {
+    int64_t from = 0, to = INT64_MAX;
+    char query[96];
+    esp_err_t err = httpd_req_get_url_query_str(r, query, sizeof(query));
+    // Una query truncada o ilegible no puede tomarse como "sin filtro"
+    if (err == ESP_ERR_HTTPD_RESULT_TRUNC) {
+        return httpd_resp_send_err(r, HTTPD_414_URI_TOO_LONG, "query demasiado larga");
+    }
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        return httpd_resp_send_err(r, HTTPD_400_BAD_REQUEST, "query inválida");
+    }
+    if (err == ESP_OK &&
+        (!query_epoch(query, "from", &from) || !query_epoch(query, "to", &to))) {
+        return httpd_resp_send_err(r, HTTPD_400_BAD_REQUEST, "from/to: segundos epoch");
+    }
+    if (from > to) return httpd_resp_send_err(r, HTTPD_400_BAD_REQUEST, "from > to");
+
+    // Lo que hay en el anillo al empezar: lo que llegue mientras se envía va en
+    // la próxima consulta. El ETag cambia con cada lectura nueva o pisada.
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t end = s_next_seq;
+    xSemaphoreGive(s_lock);
+    uint32_t seq = oldest_seq(end);
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%lu-%lu\"", (unsigned long)seq, (unsigned long)end);
+    if (not_modified(r, etag)) return ESP_OK;
+
+    // Sin armar el documento entero: cada chunk lleva las muestras que caben en buf
+    httpd_resp_set_type(r, "application/json");
+    char buf[768];
+    int used = snprintf(buf, sizeof(buf), "{\"samples\":[");
+    int count = 0;
+    local_sample_t batch[4];
+    for (;;) {
+        int n = ring_copy(&seq, end, batch, sizeof(batch) / sizeof(batch[0]));
+        if (n <= 0) break;
+        for (int i = 0; i < n; i++) {
+            if (batch[i].t < from || batch[i].t > to) continue;
+            if (sizeof(buf) - used < LOCAL_API_SAMPLE_JSON_MAX + 1) {
+                if (httpd_resp_send_chunk(r, buf, used) != ESP_OK) return ESP_FAIL; // cliente se fue
+                used = 0;
+            }
+            if (count++) buf[used++] = ',';
+            used += format_sample(buf + used, sizeof(buf) - used, &batch[i]);
+        }
+        seq += n;
+    }
+    if (sizeof(buf) - used < 32) {
+        if (httpd_resp_send_chunk(r, buf, used) != ESP_OK) return ESP_FAIL;
+        used = 0;
+    }
+    used += snprintf(buf + used, sizeof(buf) - used, "],\"count\":%d}", count);
+    httpd_resp_send_chunk(r, buf, used);
+    return httpd_resp_send_chunk(r, NULL, 0);
+}
+
+static const httpd_uri_t uri_latest  = { .uri="/api/latest",  .method=HTTP_GET, .handler=latest_get };
+static const httpd_uri_t uri_history = { .uri="/api/history", .method=HTTP_GET, .handler=history_get };
+
+esp_err_t local_api_init(void) {
+    if (s_ring) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    s_ring = calloc(LOCAL_API_HISTORY_LEN, sizeof(local_sample_t));
+    if (!s_lock || !s_ring) return ESP_ERR_NO_MEM;
+    esp_err_t err = captive_manager_add_sta_handler(&uri_latest);
+    if (err == ESP_OK) err = captive_manager_add_sta_handler(&uri_history);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "API local: /api/latest y /api/history (%d muestras, %u B)",
+                 LOCAL_API_HISTORY_LEN, (unsigned)(LOCAL_API_HISTORY_LEN * sizeof(local_sample_t)));
+    }
+    return err;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "esp_err.h"
+#include "sensors.h"
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Muestras recientes en RAM (una por lectura, las más viejas se pisan)
+#define LOCAL_API_HISTORY_LEN 240
+
+// API local de solo lectura en el servidor STA, para leer sin pasar por Firebase:
+//   GET /api/latest               última muestra
+//   GET /api/history?from=&to=    muestras con from <= t <= to (epoch s, ambos opcionales)
+// Las respuestas llevan ETag; con If-None-Match igual se contesta 304 sin cuerpo.
+
+// Reserva el anillo y registra los endpoints; antes de captive_manager_start()
+esp_err_t local_api_init(void);
+
+// Desde la tarea de sensores, con la hora ya sincronizada
+void local_api_add_sample(const SensorData *d, time_t t);
+
+// Objeto JSON de una muestra tal como lo sirve la API (sin NUL, como mucho
+// LOCAL_API_SAMPLE_JSON_MAX bytes); devuelve el largo escrito
+#define LOCAL_API_SAMPLE_JSON_MAX 256
+int local_api_format_sample(const SensorData *d, time_t t, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,6 +25,9 @@
 #include "firebase.h"
 #include "Privado.h"
 #include "captive_manager.h"
+#include "local_api.h"
+#include "live_stream.h"
+#include "metrics.h"
 
 void geoapify_fetch_once_wifi_unwired(void);
 
@@ -35,6 +38,10 @@ static inline int64_t minutes_to_us(int m) { return (int64_t)m * 60 * 1000000; }
 
 static const char *TAG = "ESP-WROVER-FB";
 
+// /metrics: duración y fallos de sensors_read()
+static const uint32_t SENSOR_READ_BOUNDS_US[] = {10000, 50000, 100000, 250000, 500000, 1000000, 2500000};
+static metric_t *s_m_read_time, *s_m_read_fail;
+
 static void init_sntp_and_time(void) {
     esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
     esp_sntp_setservername(0, "pool.ntp.org");
@@ -50,6 +57,11 @@ static void init_sntp_and_time(void) {
     }
 }
 
+// Firebase falla al momento (FIREBASE_ERR_OFFLINE) mientras no haya internet
+static bool link_online(void) {
+    return captive_manager_get_link() == CAPTIVE_LINK_ONLINE;
+}
+
 // ------------ SENSOR TASK ------------
 void sensor_task(void *pv) {
     SensorData data;
@@ -65,10 +77,15 @@ void sensor_task(void *pv) {
 
     geoapify_fetch_once_wifi_unwired();
 
-    if (firebase_init() != 0) {
-        ESP_LOGE(TAG, "Error inicializando Firebase");
-        vTaskDelete(NULL);
-        return;
+    // El enlace pudo caerse desde que el portal dio OPERATIONAL, o el login
+    // agotar el timeout: se reintenta con espera creciente, nunca se abandona
+    captive_manager_wait_online(-1);
+    int init_backoff_ms = 5000;
+    while (firebase_init() != 0) {
+        ESP_LOGW(TAG, "Error inicializando Firebase; reintento en %d s", init_backoff_ms / 1000);
+        vTaskDelay(pdMS_TO_TICKS(init_backoff_ms));
+        if (init_backoff_ms < 5 * 60000) init_backoff_ms *= 2;
+        captive_manager_wait_online(-1);
     }
     
     vTaskDelay(pdMS_TO_TICKS(1000));
@@ -88,7 +105,13 @@ void sensor_task(void *pv) {
     int64_t next_refresh_us = esp_timer_get_time() + REFRESH_US;
 
     while (1) {
-        if (sensors_read(&data) == ESP_OK) {
+        int64_t read_start_us = esp_timer_get_time();
+        esp_err_t read_err = sensors_read(&data);
+        metrics_observe_us(s_m_read_time, (uint32_t)(esp_timer_get_time() - read_start_us));
+        if (read_err == ESP_OK) {
+            time_t now = time(NULL);
+            local_api_add_sample(&data, now);
+            live_stream_publish(&data, now);
             sample_count++;
             sum_pm1p0 += data.pm1p0;
             sum_pm2p5 += data.pm2p5;
@@ -106,6 +129,7 @@ void sensor_task(void *pv) {
                 data.voc, data.nox, data.co2, data.avg_temp, data.avg_hum);
 #endif
         } else {
+            metrics_inc(s_m_read_fail);
             ESP_LOGW(TAG, "Error leyendo sensores (batch %d)", sample_count);
         }
 
@@ -139,30 +163,14 @@ void sensor_task(void *pv) {
             char json[384];
             if (first_send) {
                 sensors_format_json(&avg, hora_envio, fecha_actual, inicio_str, json, sizeof(json));
-                strncpy(last_fecha_str, fecha_actual, sizeof(last_fecha_str)-1);
-                last_fecha_str[sizeof(last_fecha_str)-1] = '\0';
                 first_send = false;
+            } else if (strncmp(last_fecha_str, fecha_actual, sizeof(last_fecha_str)) != 0) {
+                sensors_format_json(&avg, hora_envio, fecha_actual, NULL, json, sizeof(json));
             } else {
-                if (strncmp(last_fecha_str, fecha_actual, sizeof(last_fecha_str)) != 0) {
-                    snprintf(json, sizeof(json),
-                        "{\"pm1p0\":%.2f,\"pm2p5\":%.2f,\"pm4p0\":%.2f,\"pm10p0\":%.2f,"
-                        "\"voc\":%.1f,\"nox\":%.1f,\"cTe\":%.2f,\"cHu\":%.2f,\"co2\":%u,"
-                        "\"fecha\":\"%s\",\"hora\":\"%s\"}",
-                        avg.pm1p0, avg.pm2p5, avg.pm4p0, avg.pm10p0,
-                        avg.voc, avg.nox, avg.avg_temp, avg.avg_hum,
-                        avg.co2, fecha_actual, hora_envio);
-                    strncpy(last_fecha_str, fecha_actual, sizeof(last_fecha_str)-1);
-                    last_fecha_str[sizeof(last_fecha_str)-1] = '\0';
-                } else {
-                    snprintf(json, sizeof(json),
-                        "{\"pm1p0\":%.2f,\"pm2p5\":%.2f,\"pm4p0\":%.2f,\"pm10p0\":%.2f,"
-                        "\"voc\":%.1f,\"nox\":%.1f,\"cTe\":%.2f,\"cHu\":%.2f,\"co2\":%u,"
-                        "\"hora\":\"%s\"}",
-                        avg.pm1p0, avg.pm2p5, avg.pm4p0, avg.pm10p0,
-                        avg.voc, avg.nox, avg.avg_temp, avg.avg_hum,
-                        avg.co2, hora_envio);
-                }
+                sensors_format_json(&avg, hora_envio, NULL, NULL, json, sizeof(json));
             }
+            strncpy(last_fecha_str, fecha_actual, sizeof(last_fecha_str)-1);
+            last_fecha_str[sizeof(last_fecha_str)-1] = '\0';
             // Log dinámico indicando cada cuántos minutos se está enviando
             int batch_minutes = SAMPLES_PER_BATCH * SAMPLE_EVERY_MIN;
             ESP_LOGI(TAG, "JSON promedio %dm: %s", batch_minutes, json);
@@ -175,8 +183,12 @@ void sensor_task(void *pv) {
             snprintf(path_put, sizeof(path_put), "/historial_mediciones/%s", clave_min);
 
             ESP_LOGI(TAG, "Path: %s", path_put);
-            firebase_putData(path_put, json);
+            int put = firebase_putData(path_put, json);
             //firebase_push("/historial_mediciones", json);
+            if (put == FIREBASE_ERR_OFFLINE) {
+                ESP_LOGW(TAG, "Sin enlace (%s): envío omitido",
+                         captive_manager_link_str(captive_manager_get_link()));
+            }
 
             // Retención aproximada por tamaño total (~10 MB)
             const size_t MAX_BYTES = 10 * 1024 * 1024;
@@ -184,10 +196,10 @@ void sensor_task(void *pv) {
             static uint32_t approx_count = 0;
             size_t item_len = strlen(json);
             avg_size = (avg_size * 0.9) + (0.1 * (double)item_len);
-            approx_count++;
+            if (put == 0) approx_count++;
             uint32_t max_items = (uint32_t)(MAX_BYTES / (avg_size > 1.0 ? avg_size : 1.0));
             uint32_t high_water = max_items + 50;
-            if (approx_count > high_water) {
+            if (put == 0 && approx_count > high_water) {
                 int deleted = firebase_trim_oldest_batch("/historial_mediciones", 50);
                 if (deleted > 0) {
                     approx_count = (approx_count > (uint32_t)deleted) ? (approx_count - (uint32_t)deleted) : 0;
@@ -208,8 +220,9 @@ void sensor_task(void *pv) {
             ESP_LOGI(TAG, "Refrescando token (50m) [monotónico]...");
             int r = firebase_refresh_token();
             if (r == 0) ESP_LOGI(TAG, "Token refresh OK"); else ESP_LOGW(TAG, "Fallo refresh token (%d)", r);
-            // agenda el próximo exactamente 50 min después DEL AHORA (evita drift):
-            next_refresh_us = now_us + REFRESH_US;
+            // agenda el próximo exactamente 50 min después DEL AHORA (evita drift);
+            // sin enlace se reintenta en la próxima vuelta
+            if (r != FIREBASE_ERR_OFFLINE) next_refresh_us = now_us + REFRESH_US;
         }
 
         vTaskDelay(SAMPLE_DELAY_TICKS);
@@ -244,34 +257,51 @@ void app_main(void) {
         .ap_ssid = CONFIG_CAPTIVE_MANAGER_AP_SSID,
         .ap_pass = CONFIG_CAPTIVE_MANAGER_AP_PASS,
         .connectivity_url = CONFIG_CAPTIVE_MANAGER_CONNECTIVITY_URL,
+#ifdef CONFIG_CAPTIVE_MANAGER_PROBE_FIREBASE
+        .probe_host = DATABASE_URL,
+#endif
+        .probe_timeout_ms = CONFIG_CAPTIVE_MANAGER_PROBE_TIMEOUT_MS,
         .check_interval_ms = CONFIG_CAPTIVE_MANAGER_CHECK_INTERVAL_MS,
+        .probe_interval_max_ms = CONFIG_CAPTIVE_MANAGER_PROBE_INTERVAL_MAX_MS,
         .verify_success_needed = CONFIG_CAPTIVE_MANAGER_VERIFY_SUCCESS_N,
         .max_scan_aps = CONFIG_CAPTIVE_MANAGER_MAX_SCAN_APS,
+        .scan_max_age_ms = CONFIG_CAPTIVE_MANAGER_SCAN_MAX_AGE_MS,
         .conn_max_attempts = CONFIG_CAPTIVE_MANAGER_CONN_MAX_ATTEMPTS,
         .conn_retry_delay_ms = CONFIG_CAPTIVE_MANAGER_CONN_RETRY_DELAY_MS,
-        .startup_check_delay_ms = CONFIG_CAPTIVE_MANAGER_STARTUP_CHECK_DELAY_MS
+        .startup_check_delay_ms = CONFIG_CAPTIVE_MANAGER_STARTUP_CHECK_DELAY_MS,
+        .fast_connect_attempts = CONFIG_CAPTIVE_MANAGER_FAST_CONNECT_ATTEMPTS,
+#ifdef CONFIG_CAPTIVE_MANAGER_REUSE_IP_LEASE
+        .reuse_ip_lease = true,
+#endif
+        .recover_backoff_min_ms = CONFIG_CAPTIVE_MANAGER_RECOVER_BACKOFF_MIN_MS,
+        .recover_backoff_max_ms = CONFIG_CAPTIVE_MANAGER_RECOVER_BACKOFF_MAX_MS,
+        .recover_budget_ms = CONFIG_CAPTIVE_MANAGER_RECOVER_BUDGET_MS,
+        // Navegador / API local + una conexión fija por cliente de /api/stream
+        .sta_max_sockets = 2 + CONFIG_LIVE_STREAM_MAX_CLIENTS,
     };
 
+    ESP_ERROR_CHECK(metrics_init());
+    s_m_read_time = metrics_histogram("sensor_read_seconds", "Duración de sensors_read()", NULL,
+                                      SENSOR_READ_BOUNDS_US, sizeof(SENSOR_READ_BOUNDS_US) / sizeof(SENSOR_READ_BOUNDS_US[0]));
+    s_m_read_fail = metrics_counter("sensor_read_failures_total", "Lecturas de sensores fallidas", NULL);
+    metrics_watch_task("sensor_task");
     ESP_ERROR_CHECK(captive_manager_init(&cfg));
+    ESP_ERROR_CHECK(local_api_init());
+    ESP_ERROR_CHECK(live_stream_init());
+    firebase_set_link_check(link_online);
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &wifi_event_handler, NULL));
     ESP_ERROR_CHECK(captive_manager_start());
 
-    bool operational_started = false;
-
-    // Sensores y Firebase solo se inicializan cuando el portal ya no está activo
-    while (true) {
-        if (!operational_started && captive_manager_get_state() == CAP_STATE_OPERATIONAL) {
-            operational_started = true;
-            ESP_LOGI(TAG,"Red lista con internet. Iniciando SNTP, sensores y Firebase...");
-            init_sntp_and_time();
-            esp_err_t ret = sensors_init_all();
-            if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "Fallo al inicializar sensores: %s", esp_err_to_name(ret));
-            } else {
-                xTaskCreate(sensor_task, "sensor_task", SENSOR_TASK_STACK, NULL, 5, NULL);
-            }
-        }
-        vTaskDelay(pdMS_TO_TICKS(1000));
+    // Sensores y Firebase solo se inicializan cuando el portal ya no está activo:
+    // el enlace pasa a ONLINE al llegar a OPERATIONAL (se espera, sin sondear el estado)
+    captive_manager_wait_online(-1);
+    ESP_LOGI(TAG,"Red lista con internet. Iniciando SNTP, sensores y Firebase...");
+    init_sntp_and_time();
+    esp_err_t ret = sensors_init_all();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Fallo al inicializar sensores: %s", esp_err_to_name(ret));
+    } else {
+        xTaskCreate(sensor_task, "sensor_task", SENSOR_TASK_STACK, NULL, 5, NULL);
     }
 }
@@ -194,16 +194,6 @@ esp_err_t sensors_read(SensorData *out) {
     return ESP_OK;
 }
 
-void sensors_format_json(const SensorData *d, const char *time_str, const char *fecha_str, const char *inicio_str, char *buf, size_t buf_size) {
-    if (!buf || buf_size == 0) return;
-    int written = snprintf(buf, buf_size,
-        "{\"pm1p0\":%.2f,\"pm2p5\":%.2f,\"pm4p0\":%.2f,\"pm10p0\":%.2f,\"voc\":%.1f,\"nox\":%.1f,\"cTe\":%.2f,\"cHu\":%.2f,\"co2\":%u,\"fecha\":\"%s\",\"inicio\":\"%s\",\"ciudad\":\"%s\",\"hora\":\"%s\",\"id\":\"%s\"}",
-        d->pm1p0, d->pm2p5, d->pm4p0, d->pm10p0, d->voc, d->nox, d->avg_temp, d->avg_hum, d->co2, fecha_str, inicio_str, g_city_state, time_str, DEVICE_ID);
-    if (written < 0 || (size_t)written >= buf_size) {
-        if (buf_size) buf[buf_size-1] = '\0';
-    }
-}
-
 void sensors_set_city_state(const char *city_state) {
     if (!city_state) return;
     size_t len = strlen(city_state);
@@ -212,3 +202,6 @@ void sensors_set_city_state(const char *city_state) {
     g_city_state[len] = '\0';
 }
 
+const char *sensors_get_city_state(void) {
+    return g_city_state;
+}
@@ -1,7 +1,12 @@
 #pragma once
 #include "esp_err.h"
+#include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct {
     // SCD4x
     uint16_t co2;
@@ -27,8 +32,10 @@ esp_err_t sensors_init_all(void);
 // Lee datos de ambos sensores y calcula promedios. Devuelve ESP_OK si todo OK.
 esp_err_t sensors_read(SensorData *out);
 
-// Formatea JSON con claves personalizadas.
+// Formatea JSON con claves personalizadas (sensors_json.cpp).
 // time_str debe ser HH:MM:SS, fecha_str e inicio_str en formato "YYYY-MM-DD HH:MM:SS".
+// fecha_str e inicio_str pueden ser NULL para omitirlos; ciudad e id solo se
+// escriben junto con inicio.
 void sensors_format_json(const SensorData *d,
                          const char *time_str,
                          const char *fecha_str,
@@ -38,3 +45,10 @@ void sensors_format_json(const SensorData *d,
 
 // Establece ciudad (city-state) obtenida externamente (Geoapify)
 void sensors_set_city_state(const char *city_state);
+
+// Ciudad (city-state) actual, "----" si aún no se conoce
+const char *sensors_get_city_state(void);
+
+#ifdef __cplusplus
+}
+#endif
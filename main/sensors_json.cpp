@@ -0,0 +1,60 @@
+#include "sensors.h"
+#include "privado.h"
+#include "bind.h"
+
+#include <cstdint>
+
+namespace {
+
+// Registro tal como se sube a Firebase; las cadenas NULL no se escriben.
+struct SensorRecord {
+    float pm1p0;
+    float pm2p5;
+    float pm4p0;
+    float pm10p0;
+    float voc;
+    float nox;
+    float cTe;
+    float cHu;
+    uint16_t co2;
+    const char *fecha;
+    const char *inicio;
+    const char *ciudad;
+    const char *hora;
+    const char *id;
+};
+
+// Mismas claves, orden y decimales que el antiguo formato con snprintf.
+const Json::FieldBinding<SensorRecord> kSensorFields[] = {
+    JSONCPP_BIND_FIXED(SensorRecord, pm1p0, "pm1p0", 2),
+    JSONCPP_BIND_FIXED(SensorRecord, pm2p5, "pm2p5", 2),
+    JSONCPP_BIND_FIXED(SensorRecord, pm4p0, "pm4p0", 2),
+    JSONCPP_BIND_FIXED(SensorRecord, pm10p0, "pm10p0", 2),
+    JSONCPP_BIND_FIXED(SensorRecord, voc, "voc", 1),
+    JSONCPP_BIND_FIXED(SensorRecord, nox, "nox", 1),
+    JSONCPP_BIND_FIXED(SensorRecord, cTe, "cTe", 2),
+    JSONCPP_BIND_FIXED(SensorRecord, cHu, "cHu", 2),
+    JSONCPP_BIND(SensorRecord, co2, "co2"),
+    JSONCPP_BIND(SensorRecord, fecha, "fecha"),
+    JSONCPP_BIND(SensorRecord, inicio, "inicio"),
+    JSONCPP_BIND(SensorRecord, ciudad, "ciudad"),
+    JSONCPP_BIND(SensorRecord, hora, "hora"),
+    JSONCPP_BIND(SensorRecord, id, "id"),
+};
+
+} // namespace
+
+extern "C" void sensors_format_json(const SensorData *d, const char *time_str,
+                                    const char *fecha_str,
+                                    const char *inicio_str, char *buf,
+                                    size_t buf_size) {
+    if (!buf || buf_size == 0) return;
+    // ciudad e id describen la sesión: solo acompañan a inicio
+    const SensorRecord record = {
+        d->pm1p0, d->pm2p5, d->pm4p0, d->pm10p0, d->voc, d->nox,
+        d->avg_temp, d->avg_hum, d->co2, fecha_str, inicio_str,
+        inicio_str ? sensors_get_city_state() : nullptr, time_str,
+        inicio_str ? DEVICE_ID : nullptr};
+    // Sin escritura directa al buffer: BufferSink trunca y termina en NUL
+    Json::writeFields(record, kSensorFields, buf, buf_size);
+}